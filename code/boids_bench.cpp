@@ -0,0 +1,746 @@
+
+#include "boids_sim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+
+/*
+
+  NOTE: Headless benchmark for the sim. Seeds the flock deterministically, runs some warmup steps and then records the cycle
+        count of every SIM_TIMED_BLOCK for each measured step. The output uses the same columns as data/temp.csv followed by
+        min/median/p99 rows so two builds can be compared run for run. Without -grid the cell count follows the radii (up to
+        256 cells per axis), -grid N fixes it to NxN. -rules keeps the weights of the listed rules (c = cohesion, a = alignment,
+        s = separation) and zeroes the rest, e.g. -rules s for separation only. -fov N gives the birds an N degree field of
+        view with a blind spot behind them. -species N splits the flock into N species (up to SIM_MAX_SPECIES) with their
+        own radii, speeds and weights that only flock with their own kind. -sdf loads static obstacles from an SDF file (see
+        sim_sdf_file_header), -obstacles N generates a field of N round obstacles inside the walls instead and -sdfout
+        saves it so it can be loaded later. -predators N adds N predators that the birds flee from and -attractors N adds N
+        fixed points that they seek, e.g. -birds 1000000 -predators 1000 for the predator query at scale.
+
+        Usage: boids_bench [-birds N] [-warmup N] [-steps N] [-seed N] [-threads N] [-dt N] [-radiussq N] [-grid N] [-lanes 4|8|16] [-serialgrid] [-blockgrid] [-noreorder] [-incremental] [-tiled] [-notiled] [-nocull] [-halfstencil] [-neighbourlists] [-skin N] [-quantised] [-farfield] [-adaptive] [-morton] [-hashed] [-unbounded] [-3d] [-steering] [-rules cas] [-fov N] [-species N] [-sdf file.sdf] [-obstacles N] [-sdfout file.sdf] [-predators N] [-attractors N] [-o file.csv]
+  
+ */
+
+struct bench_args
+{
+    u32 NumBirds;
+    u32 NumWarmupSteps;
+    u32 NumMeasuredSteps;
+    u32 Seed;
+    u32 NumThreads;
+    f32 FrameTime;
+    f32 BirdRadiusSq;
+    u32 CellCountForAxis;
+    b32 FixedGridSize;
+    u32 LaneWidth;
+    b32 SerialGridBuild;
+    b32 BlockArenaGrid;
+    b32 NoReorder;
+    b32 IncrementalGrid;
+    b32 TiledNeighbours;
+    b32 NoTiledNeighbours;
+    b32 NoCellCulling;
+    b32 HalfStencil;
+    b32 NeighbourLists;
+    f32 NeighbourSkin;
+    b32 QuantisedSearch;
+    b32 FarField;
+    b32 AdaptiveGrid;
+    b32 MortonCellOrder;
+    b32 HashedCellOrder;
+    b32 UnboundedWorld;
+    b32 Flock3d;
+    b32 SteeringRules;
+    // NOTE: sim_rule flags of the rules that keep their weight
+    u32 Rules;
+    f32 FieldOfView;
+    u32 NumSpecies;
+    const char* SdfPath;
+    u32 NumObstacles;
+    const char* SdfOutputPath;
+    u32 NumPredators;
+    u32 NumAttractors;
+    const char* OutputPath;
+};
+
+inline int BenchCompareU64(const void* A, const void* B)
+{
+    u64 ValueA = *(u64*)A;
+    u64 ValueB = *(u64*)B;
+    int Result = ValueA < ValueB ? -1 : (ValueA > ValueB ? 1 : 0);
+    return Result;
+}
+
+inline u64 BenchPercentile(u64* SortedSamples, u32 NumSamples, f32 Percentile)
+{
+    u32 Index = u32(Percentile * f32(NumSamples - 1) + 0.5f);
+    u64 Result = SortedSamples[Min(Index, NumSamples - 1)];
+    return Result;
+}
+
+// NOTE: Samples per axis of the generated obstacle fields, about 3 per TerrainAvoidRadius at the default TerrainRadius
+#define BENCH_OBSTACLE_SDF_RESOLUTION 256
+
+inline u64 BenchGetObstacleSdfSize()
+{
+    u64 Result = sizeof(sim_sdf_file_header) + u64(BENCH_OBSTACLE_SDF_RESOLUTION) * BENCH_OBSTACLE_SDF_RESOLUTION * sizeof(f32);
+    return Result;
+}
+
+inline void BenchBuildObstacleSdf(void* FileData, u32 NumObstacles, u32 Seed, f32 TerrainRadius)
+{
+    // NOTE: The walls at TerrainRadius plus NumObstacles circles, written in the SDF file format. The field is the minimum of
+    //       the distances to every shape, which is exact outside the shapes and close enough inside them
+    sim_sdf_file_header* Header = (sim_sdf_file_header*)FileData;
+    Header->Magic = SIM_SDF_FILE_MAGIC;
+    Header->Width = BENCH_OBSTACLE_SDF_RESOLUTION;
+    Header->Height = BENCH_OBSTACLE_SDF_RESOLUTION;
+    Header->MinX = -TerrainRadius;
+    Header->MinY = -TerrainRadius;
+    Header->MaxX = TerrainRadius;
+    Header->MaxY = TerrainRadius;
+
+    v2* Centers = (v2*)malloc(sizeof(v2) * Max(NumObstacles, 1u));
+    f32* Radii = (f32*)malloc(sizeof(f32) * Max(NumObstacles, 1u));
+    u32 RandomState = Seed * 747796405u + 2891336453u;
+    for (u32 ObstacleId = 0; ObstacleId < NumObstacles; ++ObstacleId)
+    {
+        f32 Rand[3];
+        for (u32 RandId = 0; RandId < ArrayCount(Rand); ++RandId)
+        {
+            RandomState ^= RandomState << 13;
+            RandomState ^= RandomState >> 17;
+            RandomState ^= RandomState << 5;
+            Rand[RandId] = f32(RandomState >> 8) / f32(1 << 24);
+        }
+        Centers[ObstacleId] = 0.8f * TerrainRadius * V2(2.0f * Rand[0] - 1.0f, 2.0f * Rand[1] - 1.0f);
+        Radii[ObstacleId] = 0.2f + 0.6f * Rand[2];
+    }
+
+    f32* Distances = (f32*)(Header + 1);
+    f32 SampleDim = 2.0f * TerrainRadius / f32(BENCH_OBSTACLE_SDF_RESOLUTION - 1);
+    for (u32 Y = 0; Y < BENCH_OBSTACLE_SDF_RESOLUTION; ++Y)
+    {
+        for (u32 X = 0; X < BENCH_OBSTACLE_SDF_RESOLUTION; ++X)
+        {
+            v2 Pos = V2(-TerrainRadius) + SampleDim * V2(f32(X), f32(Y));
+            f32 Distance = TerrainRadius - Max(Abs(Pos.x), Abs(Pos.y));
+            for (u32 ObstacleId = 0; ObstacleId < NumObstacles; ++ObstacleId)
+            {
+                Distance = Min(Distance, Length(Pos - Centers[ObstacleId]) - Radii[ObstacleId]);
+            }
+            Distances[Y * BENCH_OBSTACLE_SDF_RESOLUTION + X] = Distance;
+        }
+    }
+
+    free(Centers);
+    free(Radii);
+}
+
+inline void BenchPrintUsage()
+{
+    fprintf(stderr, "Usage: boids_bench [-birds N] [-warmup N] [-steps N] [-seed N] [-threads N] [-dt N] [-radiussq N] [-grid N] [-lanes 4|8|16] [-serialgrid] [-blockgrid] [-noreorder] [-incremental] [-tiled] [-notiled] [-nocull] [-halfstencil] [-neighbourlists] [-skin N] [-quantised] [-farfield] [-adaptive] [-morton] [-hashed] [-unbounded] [-3d] [-steering] [-rules cas] [-fov N] [-species N] [-sdf file.sdf] [-obstacles N] [-sdfout file.sdf] [-predators N] [-attractors N] [-o file.csv]\n");
+}
+
+int main(int ArgCount, char** Args)
+{
+    bench_args BenchArgs = {};
+    BenchArgs.NumBirds = 10000;
+    BenchArgs.NumWarmupSteps = 60;
+    BenchArgs.NumMeasuredSteps = 600;
+    BenchArgs.Seed = 1;
+    BenchArgs.NumThreads = 1;
+    BenchArgs.FrameTime = 1.0f / 60.0f;
+    BenchArgs.CellCountForAxis = 256;
+    BenchArgs.Rules = SimRule_All;
+    BenchArgs.FieldOfView = 360.0f;
+
+    for (int ArgId = 1; ArgId < ArgCount; ++ArgId)
+    {
+        const char* Arg = Args[ArgId];
+
+        // NOTE: Flags without a value
+        if (strcmp(Arg, "-serialgrid") == 0)
+        {
+            BenchArgs.SerialGridBuild = true;
+            continue;
+        }
+        else if (strcmp(Arg, "-blockgrid") == 0)
+        {
+            BenchArgs.BlockArenaGrid = true;
+            continue;
+        }
+        else if (strcmp(Arg, "-noreorder") == 0)
+        {
+            BenchArgs.NoReorder = true;
+            continue;
+        }
+        else if (strcmp(Arg, "-incremental") == 0)
+        {
+            BenchArgs.IncrementalGrid = true;
+            continue;
+        }
+        else if (strcmp(Arg, "-tiled") == 0)
+        {
+            BenchArgs.TiledNeighbours = true;
+            continue;
+        }
+        else if (strcmp(Arg, "-notiled") == 0)
+        {
+            BenchArgs.NoTiledNeighbours = true;
+            continue;
+        }
+        else if (strcmp(Arg, "-nocull") == 0)
+        {
+            BenchArgs.NoCellCulling = true;
+            continue;
+        }
+        else if (strcmp(Arg, "-halfstencil") == 0)
+        {
+            BenchArgs.HalfStencil = true;
+            continue;
+        }
+        else if (strcmp(Arg, "-neighbourlists") == 0)
+        {
+            BenchArgs.NeighbourLists = true;
+            continue;
+        }
+        else if (strcmp(Arg, "-quantised") == 0)
+        {
+            BenchArgs.QuantisedSearch = true;
+            continue;
+        }
+        else if (strcmp(Arg, "-farfield") == 0)
+        {
+            BenchArgs.FarField = true;
+            continue;
+        }
+        else if (strcmp(Arg, "-adaptive") == 0)
+        {
+            BenchArgs.AdaptiveGrid = true;
+            continue;
+        }
+        else if (strcmp(Arg, "-morton") == 0)
+        {
+            BenchArgs.MortonCellOrder = true;
+            continue;
+        }
+        else if (strcmp(Arg, "-hashed") == 0)
+        {
+            BenchArgs.HashedCellOrder = true;
+            continue;
+        }
+        else if (strcmp(Arg, "-unbounded") == 0)
+        {
+            BenchArgs.UnboundedWorld = true;
+            continue;
+        }
+        else if (strcmp(Arg, "-3d") == 0)
+        {
+            BenchArgs.Flock3d = true;
+            continue;
+        }
+        else if (strcmp(Arg, "-steering") == 0)
+        {
+            BenchArgs.SteeringRules = true;
+            continue;
+        }
+        
+        const char* Value = ArgId + 1 < ArgCount ? Args[ArgId + 1] : 0;
+        if (!Value)
+        {
+            BenchPrintUsage();
+            return 1;
+        }
+
+        if (strcmp(Arg, "-birds") == 0)
+        {
+            BenchArgs.NumBirds = u32(strtoul(Value, 0, 10));
+        }
+        else if (strcmp(Arg, "-warmup") == 0)
+        {
+            BenchArgs.NumWarmupSteps = u32(strtoul(Value, 0, 10));
+        }
+        else if (strcmp(Arg, "-steps") == 0)
+        {
+            BenchArgs.NumMeasuredSteps = u32(strtoul(Value, 0, 10));
+        }
+        else if (strcmp(Arg, "-seed") == 0)
+        {
+            BenchArgs.Seed = u32(strtoul(Value, 0, 10));
+        }
+        else if (strcmp(Arg, "-threads") == 0)
+        {
+            BenchArgs.NumThreads = Clamp(u32(strtoul(Value, 0, 10)), 1u, u32(JOB_MAX_THREADS));
+        }
+        else if (strcmp(Arg, "-dt") == 0)
+        {
+            BenchArgs.FrameTime = f32(atof(Value));
+        }
+        else if (strcmp(Arg, "-radiussq") == 0)
+        {
+            BenchArgs.BirdRadiusSq = f32(atof(Value));
+        }
+        else if (strcmp(Arg, "-skin") == 0)
+        {
+            BenchArgs.NeighbourSkin = f32(atof(Value));
+        }
+        else if (strcmp(Arg, "-grid") == 0)
+        {
+            BenchArgs.CellCountForAxis = Max(u32(strtoul(Value, 0, 10)), 1u);
+            BenchArgs.FixedGridSize = true;
+        }
+        else if (strcmp(Arg, "-lanes") == 0)
+        {
+            BenchArgs.LaneWidth = u32(strtoul(Value, 0, 10));
+        }
+        else if (strcmp(Arg, "-rules") == 0)
+        {
+            BenchArgs.Rules = 0;
+            BenchArgs.Rules |= strchr(Value, 'c') ? SimRule_MoveToFlock : 0;
+            BenchArgs.Rules |= strchr(Value, 'a') ? SimRule_AlignFlock : 0;
+            BenchArgs.Rules |= strchr(Value, 's') ? SimRule_AvoidBirds : 0;
+        }
+        else if (strcmp(Arg, "-fov") == 0)
+        {
+            BenchArgs.FieldOfView = Clamp(f32(atof(Value)), 0.0f, 360.0f);
+        }
+        else if (strcmp(Arg, "-species") == 0)
+        {
+            BenchArgs.NumSpecies = u32(strtoul(Value, 0, 10));
+            if (BenchArgs.NumSpecies < 1 || BenchArgs.NumSpecies > SIM_MAX_SPECIES)
+            {
+                fprintf(stderr, "-species takes 1 to %u species\n", SIM_MAX_SPECIES);
+                return 1;
+            }
+        }
+        else if (strcmp(Arg, "-sdf") == 0)
+        {
+            BenchArgs.SdfPath = Value;
+        }
+        else if (strcmp(Arg, "-obstacles") == 0)
+        {
+            BenchArgs.NumObstacles = u32(strtoul(Value, 0, 10));
+        }
+        else if (strcmp(Arg, "-sdfout") == 0)
+        {
+            BenchArgs.SdfOutputPath = Value;
+        }
+        else if (strcmp(Arg, "-predators") == 0)
+        {
+            BenchArgs.NumPredators = u32(strtoul(Value, 0, 10));
+        }
+        else if (strcmp(Arg, "-attractors") == 0)
+        {
+            BenchArgs.NumAttractors = u32(strtoul(Value, 0, 10));
+        }
+        else if (strcmp(Arg, "-o") == 0)
+        {
+            BenchArgs.OutputPath = Value;
+        }
+        else
+        {
+            BenchPrintUsage();
+            return 1;
+        }
+
+        ArgId += 1;
+    }
+
+    if (BenchArgs.NumMeasuredSteps == 0)
+    {
+        BenchPrintUsage();
+        return 1;
+    }
+    if ((BenchArgs.SdfPath || BenchArgs.NumObstacles) && BenchArgs.Flock3d)
+    {
+        fprintf(stderr, "-sdf and -obstacles only work for 2D flocks\n");
+        return 1;
+    }
+    if ((BenchArgs.NumPredators || BenchArgs.NumAttractors) && BenchArgs.Flock3d)
+    {
+        fprintf(stderr, "-predators and -attractors only work for 2D flocks\n");
+        return 1;
+    }
+    if ((BenchArgs.NumPredators || BenchArgs.NumAttractors) && (BenchArgs.UnboundedWorld || BenchArgs.HashedCellOrder))
+    {
+        fprintf(stderr, "-predators and -attractors only work inside the walls and can't be combined with -unbounded or -hashed\n");
+        return 1;
+    }
+    if (BenchArgs.SdfPath && BenchArgs.NumObstacles)
+    {
+        fprintf(stderr, "-sdf and -obstacles can't be combined, use -sdfout to save the generated obstacles\n");
+        return 1;
+    }
+
+    // NOTE: Load SDF
+    void* SdfData = 0;
+    u64 SdfSize = 0;
+    if (BenchArgs.SdfPath)
+    {
+        FILE* SdfFile = fopen(BenchArgs.SdfPath, "rb");
+        if (!SdfFile)
+        {
+            fprintf(stderr, "Failed to open %s\n", BenchArgs.SdfPath);
+            return 1;
+        }
+        fseek(SdfFile, 0, SEEK_END);
+        SdfSize = u64(ftell(SdfFile));
+        fseek(SdfFile, 0, SEEK_SET);
+        SdfData = malloc(SdfSize);
+        b32 ReadAll = fread(SdfData, 1, SdfSize, SdfFile) == SdfSize;
+        fclose(SdfFile);
+        if (!ReadAll)
+        {
+            fprintf(stderr, "Failed to read %s\n", BenchArgs.SdfPath);
+            return 1;
+        }
+    }
+    else if (BenchArgs.NumObstacles)
+    {
+        // NOTE: Built once the sim knows its TerrainRadius
+        SdfSize = BenchGetObstacleSdfSize();
+        SdfData = malloc(SdfSize);
+    }
+
+    // NOTE: Init Memory
+    u64 NumCells = u64(BenchArgs.CellCountForAxis) * u64(BenchArgs.CellCountForAxis);
+    u64 ProgramMemorySize = MegaBytes(64) + u64(BenchArgs.NumBirds) * 256 + NumCells * (144 + 4 * BenchArgs.NumThreads);
+    if (BenchArgs.HalfStencil)
+    {
+        // NOTE: 7 floats per bird per thread
+        ProgramMemorySize += u64(BenchArgs.NumBirds) * 28 * BenchArgs.NumThreads;
+    }
+    if (BenchArgs.NeighbourLists)
+    {
+        // NOTE: 64 list entries plus the build positions and the packet offsets per bird
+        ProgramMemorySize += u64(BenchArgs.NumBirds) * 288;
+    }
+    if (BenchArgs.NumSpecies)
+    {
+        // NOTE: A species id per bird in both bird arrays
+        ProgramMemorySize += u64(BenchArgs.NumBirds) * 8;
+    }
+    if (BenchArgs.NumPredators || BenchArgs.NumAttractors)
+    {
+        // NOTE: The SoA, the coarse grid's indices and its cells
+        ProgramMemorySize += u64(BenchArgs.NumPredators + BenchArgs.NumAttractors) * 64 + MegaBytes(1);
+    }
+    if (SdfSize)
+    {
+        // NOTE: The distances and the 2 gradient arrays
+        ProgramMemorySize += SdfSize * 3;
+    }
+    void* ProgramMemory = malloc(ProgramMemorySize);
+    linear_arena Arena = LinearArenaCreate(ProgramMemory, ProgramMemorySize);
+
+    sim_state* Sim = PushStruct(&Arena, sim_state);
+    SimInit(Sim, &Arena, BenchArgs.NumBirds, BenchArgs.Seed, BenchArgs.NumThreads, BenchArgs.CellCountForAxis);
+    Sim->ParallelGridBuild = !BenchArgs.SerialGridBuild;
+    Sim->AutoGridSize = !BenchArgs.FixedGridSize;
+    Sim->Grid.Layout = BenchArgs.BlockArenaGrid ? GridLayout_BlockArena : GridLayout_Compact;
+    Sim->ReorderBirds = !BenchArgs.NoReorder;
+    Sim->IncrementalGrid = BenchArgs.IncrementalGrid;
+    Sim->CellCulling = !BenchArgs.NoCellCulling;
+    Sim->QuantisedSearch = BenchArgs.QuantisedSearch;
+    if (BenchArgs.SteeringRules)
+    {
+        SimSetRuleSet(Sim, SimRuleSet_Steering);
+    }
+    // NOTE: SimStep picks the neighbour loops of the rules that still have a weight
+    Sim->MoveToFlockWeight = (BenchArgs.Rules & SimRule_MoveToFlock) ? Sim->MoveToFlockWeight : 0.0f;
+    Sim->AlignFlockWeight = (BenchArgs.Rules & SimRule_AlignFlock) ? Sim->AlignFlockWeight : 0.0f;
+    Sim->AvoidBirdWeight = (BenchArgs.Rules & SimRule_AvoidBirds) ? Sim->AvoidBirdWeight : 0.0f;
+    if (BenchArgs.FieldOfView < 360.0f)
+    {
+        Sim->FovCosHalfAngle = cosf(0.5f * BenchArgs.FieldOfView * (3.14159265f / 180.0f));
+    }
+    Sim->FarField = BenchArgs.FarField;
+    Sim->AdaptiveGrid = BenchArgs.AdaptiveGrid;
+    if (BenchArgs.HalfStencil)
+    {
+        SimEnableHalfStencil(Sim, &Arena);
+    }
+    if (BenchArgs.NeighbourLists)
+    {
+        SimEnableNeighbourLists(Sim, &Arena);
+    }
+    if (BenchArgs.NeighbourSkin > 0.0f)
+    {
+        Sim->NeighbourSkin = BenchArgs.NeighbourSkin;
+    }
+    if (BenchArgs.BirdRadiusSq > 0.0f)
+    {
+        Sim->BirdRadiusSq = BenchArgs.BirdRadiusSq;
+    }
+    if (BenchArgs.LaneWidth)
+    {
+        b32 ValidWidth = BenchArgs.LaneWidth == 4 || BenchArgs.LaneWidth == 8 || BenchArgs.LaneWidth == 16;
+        if (!ValidWidth || BenchArgs.LaneWidth > Sim->LaneWidth)
+        {
+            fprintf(stderr, "-lanes %u isn't supported, this CPU runs up to %u lanes\n", BenchArgs.LaneWidth, Sim->LaneWidth);
+            return 1;
+        }
+        SimSetLaneWidth(Sim, BenchArgs.LaneWidth);
+    }
+    if (BenchArgs.TiledNeighbours || BenchArgs.NoTiledNeighbours)
+    {
+        Sim->TiledNeighbours = BenchArgs.TiledNeighbours;
+    }
+    if (BenchArgs.MortonCellOrder || BenchArgs.FarField)
+    {
+        if (!GridSupportsMorton(&Sim->Grid))
+        {
+            fprintf(stderr, "-morton and -farfield need a power of 2 grid, got %u\n", BenchArgs.CellCountForAxis);
+            return 1;
+        }
+        Sim->Grid.CellOrder = GridCellOrder_Morton;
+    }
+    if (BenchArgs.HashedCellOrder)
+    {
+        if (BenchArgs.MortonCellOrder || BenchArgs.FarField || BenchArgs.BlockArenaGrid || !GridSupportsHashed(&Sim->Grid))
+        {
+            fprintf(stderr, "-hashed needs a power of 2 compact grid and can't be combined with -morton or -farfield\n");
+            return 1;
+        }
+        Sim->Grid.CellOrder = GridCellOrder_Hashed;
+    }
+    Sim->UnboundedWorld = BenchArgs.UnboundedWorld;
+    if (BenchArgs.Flock3d)
+    {
+        b32 UsesOtherModes = (BenchArgs.BlockArenaGrid || BenchArgs.NoReorder || BenchArgs.IncrementalGrid || BenchArgs.HalfStencil ||
+                              BenchArgs.NeighbourLists || BenchArgs.QuantisedSearch || BenchArgs.FarField || BenchArgs.AdaptiveGrid ||
+                              BenchArgs.MortonCellOrder || BenchArgs.HashedCellOrder || BenchArgs.UnboundedWorld);
+        if (UsesOtherModes)
+        {
+            fprintf(stderr, "-3d always runs a row major compact grid in cell order and can't be combined with other grid modes\n");
+            return 1;
+        }
+        SimEnable3d(Sim, &Arena);
+    }
+    if (BenchArgs.NumSpecies)
+    {
+        // NOTE: The species table starts from the globals, so this has to come after the rules and the radius
+        SimEnableSpecies(Sim, &Arena, BenchArgs.NumSpecies);
+    }
+    if (BenchArgs.NumPredators || BenchArgs.NumAttractors)
+    {
+        SimEnableInfluencers(Sim, &Arena, BenchArgs.NumPredators, BenchArgs.NumAttractors);
+    }
+    if (BenchArgs.NumObstacles)
+    {
+        BenchBuildObstacleSdf(SdfData, BenchArgs.NumObstacles, BenchArgs.Seed, Sim->TerrainRadius);
+        if (BenchArgs.SdfOutputPath)
+        {
+            FILE* SdfFile = fopen(BenchArgs.SdfOutputPath, "wb");
+            if (!SdfFile || fwrite(SdfData, 1, SdfSize, SdfFile) != SdfSize)
+            {
+                fprintf(stderr, "Failed to write %s\n", BenchArgs.SdfOutputPath);
+                return 1;
+            }
+            fclose(SdfFile);
+        }
+    }
+    if (BenchArgs.SdfPath || BenchArgs.NumObstacles)
+    {
+        if (!SimLoadSdf(Sim, &Arena, SdfData, SdfSize))
+        {
+            fprintf(stderr, "%s isn't a valid SDF file\n", BenchArgs.SdfPath ? BenchArgs.SdfPath : "generated obstacle field");
+            return 1;
+        }
+        free(SdfData);
+    }
+
+    for (u32 StepId = 0; StepId < BenchArgs.NumWarmupSteps; ++StepId)
+    {
+        SimStep(Sim, BenchArgs.FrameTime);
+    }
+
+    // NOTE: The last column is the whole step, similar to MainLoop in temp.csv
+    u32 NumColumns = SIM_MAX_TIMED_BLOCKS + 1;
+    u64* Samples = (u64*)calloc(u64(BenchArgs.NumMeasuredSteps) * NumColumns, sizeof(u64));
+    u32 SearchPaths = 0;
+    auto StartTime = std::chrono::high_resolution_clock::now();
+    for (u32 StepId = 0; StepId < BenchArgs.NumMeasuredSteps; ++StepId)
+    {
+        SimProfilerReset();
+        u64 StartCycles = __rdtsc();
+        SimStep(Sim, BenchArgs.FrameTime);
+        u64 EndCycles = __rdtsc();
+        SearchPaths |= Sim->StepSearchPaths;
+
+        u64* StepSamples = Samples + StepId * NumColumns;
+        for (u32 BlockId = 0; BlockId < SimProfiler.NumBlocks; ++BlockId)
+        {
+            StepSamples[BlockId] = SimProfilerGetCycles(BlockId);
+        }
+        StepSamples[SIM_MAX_TIMED_BLOCKS] = EndCycles - StartCycles;
+    }
+    auto EndTime = std::chrono::high_resolution_clock::now();
+    f64 Seconds = std::chrono::duration<f64>(EndTime - StartTime).count();
+
+    FILE* OutputFile = stdout;
+    if (BenchArgs.OutputPath)
+    {
+        OutputFile = fopen(BenchArgs.OutputPath, "wb");
+        if (!OutputFile)
+        {
+            fprintf(stderr, "Failed to open %s\n", BenchArgs.OutputPath);
+            return 1;
+        }
+    }
+
+    // NOTE: Per step rows
+    for (u32 BlockId = 0; BlockId < SimProfiler.NumBlocks; ++BlockId)
+    {
+        fprintf(OutputFile, "%s,", SimProfiler.BlockNames[BlockId]);
+    }
+    fprintf(OutputFile, "SimStep,\n");
+    for (u32 StepId = 0; StepId < BenchArgs.NumMeasuredSteps; ++StepId)
+    {
+        u64* StepSamples = Samples + StepId * NumColumns;
+        for (u32 BlockId = 0; BlockId < SimProfiler.NumBlocks; ++BlockId)
+        {
+            fprintf(OutputFile, "%llu,", (unsigned long long)StepSamples[BlockId]);
+        }
+        fprintf(OutputFile, "%llu,\n", (unsigned long long)StepSamples[SIM_MAX_TIMED_BLOCKS]);
+    }
+
+    // NOTE: Summary rows
+    {
+        u32 NumSamples = BenchArgs.NumMeasuredSteps;
+        u64* Sorted = (u64*)calloc(NumSamples, sizeof(u64));
+
+        u64 Stats[SIM_MAX_TIMED_BLOCKS + 1][3] = {};
+        for (u32 ColumnId = 0; ColumnId < NumColumns; ++ColumnId)
+        {
+            if (ColumnId >= SimProfiler.NumBlocks && ColumnId != SIM_MAX_TIMED_BLOCKS)
+            {
+                continue;
+            }
+
+            for (u32 StepId = 0; StepId < NumSamples; ++StepId)
+            {
+                Sorted[StepId] = Samples[StepId * NumColumns + ColumnId];
+            }
+            qsort(Sorted, NumSamples, sizeof(u64), BenchCompareU64);
+
+            Stats[ColumnId][0] = Sorted[0];
+            Stats[ColumnId][1] = BenchPercentile(Sorted, NumSamples, 0.5f);
+            Stats[ColumnId][2] = BenchPercentile(Sorted, NumSamples, 0.99f);
+        }
+
+        const char* StatNames[] = { "Min", "Median", "P99" };
+        fprintf(OutputFile, "\nStat,");
+        for (u32 BlockId = 0; BlockId < SimProfiler.NumBlocks; ++BlockId)
+        {
+            fprintf(OutputFile, "%s,", SimProfiler.BlockNames[BlockId]);
+        }
+        fprintf(OutputFile, "SimStep,\n");
+        for (u32 StatId = 0; StatId < ArrayCount(StatNames); ++StatId)
+        {
+            fprintf(OutputFile, "%s,", StatNames[StatId]);
+            for (u32 BlockId = 0; BlockId < SimProfiler.NumBlocks; ++BlockId)
+            {
+                fprintf(OutputFile, "%llu,", (unsigned long long)Stats[BlockId][StatId]);
+            }
+            fprintf(OutputFile, "%llu,\n", (unsigned long long)Stats[SIM_MAX_TIMED_BLOCKS][StatId]);
+        }
+
+        free(Sorted);
+    }
+
+    if (OutputFile != stdout)
+    {
+        fclose(OutputFile);
+    }
+
+    // NOTE: Cheap checksum of the final state so runs with the same seed can be checked for matching results
+    f64 Checksum = 0.0;
+    for (u32 BirdId = 0; BirdId < Sim->NumBirds; ++BirdId)
+    {
+        Checksum += f64(Sim->CurrBirds.PosX[BirdId]) + f64(Sim->CurrBirds.PosY[BirdId]);
+        if (Sim->Flock3d)
+        {
+            Checksum += f64(Sim->CurrBirds.PosZ[BirdId]);
+        }
+    }
+
+    char RulesName[16] = {};
+    if ((Sim->ActiveRules & SimRule_All) != SimRule_All)
+    {
+        snprintf(RulesName, sizeof(RulesName), " rules %s%s%s", (Sim->ActiveRules & SimRule_MoveToFlock) ? "c" : "",
+                 (Sim->ActiveRules & SimRule_AlignFlock) ? "a" : "", (Sim->ActiveRules & SimRule_AvoidBirds) ? "s" : "");
+    }
+
+    char FovName[32] = {};
+    if (Sim->ActiveRules & SimRule_FieldOfView)
+    {
+        snprintf(FovName, sizeof(FovName), " fov %.0f", BenchArgs.FieldOfView);
+    }
+
+    char SpeciesName[32] = {};
+    if (Sim->ActiveRules & SimRule_Species)
+    {
+        snprintf(SpeciesName, sizeof(SpeciesName), " %u species", Sim->SpeciesTable.NumSpecies);
+    }
+
+    char SdfName[32] = {};
+    if (BenchArgs.NumObstacles)
+    {
+        snprintf(SdfName, sizeof(SdfName), " %u obstacles", BenchArgs.NumObstacles);
+    }
+    else if (BenchArgs.SdfPath)
+    {
+        snprintf(SdfName, sizeof(SdfName), " sdf");
+    }
+
+    char InfluencerName[64] = {};
+    if (Sim->Influencers.PosX)
+    {
+        snprintf(InfluencerName, sizeof(InfluencerName), " %u predators %u attractors", Sim->NumPredators, Sim->NumAttractors);
+    }
+
+    // NOTE: Lists every search path that ran in any measured step, the requested modes that SimStep turned off don't show up
+    char ModeName[96] = {};
+    {
+        u32 Paths[] = { SimSearchPath_NeighbourLists, SimSearchPath_HalfStencil, SimSearchPath_FarField, SimSearchPath_AdaptiveGrid,
+                        SimSearchPath_Quantised };
+        const char* PathNames[] = { " neighbour lists", " half stencil", " far field", " adaptive grid", " quantised" };
+        for (u32 PathId = 0; PathId < ArrayCount(Paths); ++PathId)
+        {
+            if (SearchPaths & Paths[PathId])
+            {
+                strcat(ModeName, PathNames[PathId]);
+            }
+        }
+    }
+
+    const char* CellOrderName = "row major";
+    if (Sim->Grid.CellOrder == GridCellOrder_Morton)
+    {
+        CellOrderName = "morton";
+    }
+    else if (Sim->Grid.CellOrder == GridCellOrder_Hashed)
+    {
+        CellOrderName = "hashed";
+    }
+
+    char GridDim[64];
+    snprintf(GridDim, sizeof(GridDim), Sim->Flock3d ? "%ux%ux%u" : "%ux%u", Sim->Grid.NumCellsX, Sim->Grid.NumCellsY, Sim->Grid.NumCellsZ);
+    
+    fprintf(stderr, "%u birds, %u threads, %u lanes%s%s%s%s%s%s%s%s, %s %s%s grid, %u steps in %.3fs (%.1f steps/s), checksum %f\n",
+            BenchArgs.NumBirds, BenchArgs.NumThreads, Sim->LaneWidth, Sim->Flock3d ? " 3d" : "", Sim->RuleSet == SimRuleSet_Steering ? " steering" : "",
+            RulesName, FovName, SpeciesName, SdfName, InfluencerName, ModeName, GridDim, Sim->AutoGridSize ? "auto " : "", CellOrderName,
+            BenchArgs.NumMeasuredSteps, Seconds,
+            f64(BenchArgs.NumMeasuredSteps) / Seconds, Checksum);
+
+    SimDestroy(Sim);
+    free(Samples);
+    free(ProgramMemory);
+
+    return 0;
+}
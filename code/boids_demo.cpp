@@ -1,5 +1,9 @@
 
 #include "boids_demo.h"
+#include "boids_sim.cpp"
+
+#include <stdio.h>
+#include <stdlib.h>
 
 /*
 
@@ -12,194 +16,6 @@
   
  */
 
-// NOTE: This will only help for larger avoid/boid radii
-#if 0
-            v2 CellDim = AabbGetDim(Grid->WorldBounds) / V2(Grid->NumCellsX, Grid->NumCellsY);
-            v2 CellMin = Grid->WorldBounds.Min + V2(GridX, GridY) * CellDim;
-            v2 CellMax = CellMin + CellDim;
-
-            v2 MaxCellDistanceVec = Max(Abs(CellMin - NewBirdPosition), Abs(CellMax - NewBirdPosition));
-            f32 MaxCellDistance = LengthSquared(MaxCellDistanceVec);
-
-            if (MaxCellDistance < DemoState->BirdRadiusSq && MaxCellDistance < DemoState->AvoidRadiusSq)
-            {
-                // NOTE: Fast path, we don't have to compute distances for each bird
-                u32 GlobalIndexId = 0;
-                for (block* CurrBlock = CurrCell->IndexArena.Next; CurrBlock; CurrBlock = CurrBlock->Next)
-                {
-                    u32* BlockIndices = BlockGetData(CurrBlock, u32);
-                    u32 NumIndicesInBlock = Min(CurrCell->NumIndices - GlobalIndexId, Grid->MaxNumIndicesPerBlock);
-                    for (u32 IndexId = 0; IndexId < NumIndicesInBlock; ++IndexId, ++GlobalIndexId)
-                    {
-                        u32 NearbyBirdId = BlockIndices[IndexId];
-                                    
-                        if (NearbyBirdId != CurrBirdId)
-                        {
-                            bird* NearbyBird = PrevBirdArray + NearbyBirdId;
-                            v2 DistanceVec = NearbyBird->Position - NewBirdPosition;
-
-                            // TODO: Add a proper FOV
-                            NumBirdsInRadius += 1;
-                                
-                            // NOTE: Velocity Matching
-                            AvgFlockDir += NearbyBird->Velocity;
-                            // NOTE: Bird Flocking
-                            AvgFlockPos += NearbyBird->Position;
-                            // NOTE: Avoidance
-                            AvgFlockAvoidance += -DistanceVec;
-                        }
-                    }
-                }
-            }
-            else
-#endif
-
-inline f32 RandFloat()
-{
-    f32 Result = f32(rand()) / f32(RAND_MAX);
-    return Result;
-}
-
-//
-// NOTE: Spatial Partition
-//
-
-inline grid GridCreate(linear_arena* Arena, platform_block_arena* BlockArena, aabb2 WorldBounds, u32 NumCellsX, u32 NumCellsY)
-{
-    grid Result = {};
-    Result.WorldBounds = WorldBounds;
-    Result.NumCellsX = NumCellsX;
-    Result.NumCellsY = NumCellsY;
-    Result.Cells = PushArray(Arena, grid_cell, NumCellsX * NumCellsY);
-    
-    for (u32 CellId = 0; CellId < NumCellsX * NumCellsY; ++CellId)
-    {
-        grid_cell* CurrCell = Result.Cells + CellId;
-        *CurrCell = {};
-        CurrCell->IndexArena = BlockArenaCreate(BlockArena, sizeof(v1u_x4));
-    }
-    
-    Result.MaxNumIndicesPerBlock = u32(BlockArenaGetBlockSize(&Result.Cells[0].IndexArena) / sizeof(v1u_x4));
-    Result.MaxNumIndicesPerBlock *= 4;
-
-    return Result;
-}
-
-inline u32 GridAddEntity(grid* Grid, v2 Position, u32 EntityId)
-{
-    u32 Result = 0;
-
-    v2 ReMappedPos = (Position - Grid->WorldBounds.Min) / AabbGetDim(Grid->WorldBounds);
-    i32 GridCellX = FloorU32(ReMappedPos.x * u32(Grid->NumCellsX));
-    i32 GridCellY = FloorU32(ReMappedPos.y * u32(Grid->NumCellsY));
-
-    Assert(GridCellX >= 0 && GridCellX < i32(Grid->NumCellsX));
-    Assert(GridCellY >= 0 && GridCellY < i32(Grid->NumCellsY));
-
-    grid_cell* GridCell = Grid->Cells + GridCellY * Grid->NumCellsX + GridCellX;
-    u32* StoredIndex = PushStruct(&GridCell->IndexArena, u32);
-    *StoredIndex = EntityId;
-
-    Result = GridCell->NumIndices++;
-    
-    return Result;
-}
-
-inline grid_range GridGetRange(grid* Grid, v2_x4 Pos, v1_x4 Radius, v1u_x4 IgnoreMask)
-{
-    grid_range Result = {};
-
-    v2_x4 MinPos = Pos - V2X4(Radius, Radius);
-    v2_x4 MaxPos = Pos + V2X4(Radius, Radius);
-
-    v2_x4 ReMappedMin = (MinPos - Grid->WorldBounds.Min) / AabbGetDim(Grid->WorldBounds);
-    v2_x4 ReMappedMax = (MaxPos - Grid->WorldBounds.Min) / AabbGetDim(Grid->WorldBounds);
-
-    // TODO: Does the floor work correctly??
-    v1u_x4 StartX = Clamp(FloorV1UX4(ReMappedMin.x * f32(Grid->NumCellsX)), V1UX4(0), V1UX4(Grid->NumCellsX - 1));
-    v1u_x4 StartY = Clamp(FloorV1UX4(ReMappedMin.y * f32(Grid->NumCellsY)), V1UX4(0), V1UX4(Grid->NumCellsY - 1));
-    v1u_x4 EndX = Clamp(FloorV1UX4(ReMappedMax.x * f32(Grid->NumCellsX)), V1UX4(0), V1UX4(Grid->NumCellsX - 1));
-    v1u_x4 EndY = Clamp(FloorV1UX4(ReMappedMax.y * f32(Grid->NumCellsY)), V1UX4(0), V1UX4(Grid->NumCellsY - 1));
-
-    // NOTE: Apply ignore mask to not change output
-    v1u_x4 IgnoreMaskMin = ~IgnoreMask;
-    v1u_x4 IgnoreMaskMax = IgnoreMask;
-
-    StartX = StartX | IgnoreMaskMin;
-    StartY = StartY | IgnoreMaskMin;
-    EndX = EndX & IgnoreMaskMax;
-    EndY = EndY & IgnoreMaskMax;
-
-    // NOTE: Compute horizontal min/maxes
-    Result.StartX = HorizontalMin(StartX);
-    Result.StartY = HorizontalMin(StartY);
-    Result.EndX = HorizontalMax(EndX);
-    Result.EndY = HorizontalMax(EndY);
-    
-    return Result;
-}
-
-inline void GridClear(grid* Grid)
-{
-    for (u32 CellId = 0; CellId < Grid->NumCellsX * Grid->NumCellsY; ++CellId)
-    {
-        grid_cell* Cell = Grid->Cells + CellId;
-        Cell->NumIndices = 0;
-        ArenaClear(&Cell->IndexArena);
-    }
-}
-
-inline bird_average_data GridGetAverageData(grid* Grid, bird_array BirdArray, v2_x4 BirdPosition, v1u_x4 CurrBirdId, v1u_x4 ValidMask)
-{
-    bird_average_data Result = {};
-
-    v1_x4 BirdRadiusSq = V1X4(DemoState->BirdRadiusSq);
-    v1_x4 AvoidRadiusSq = V1X4(DemoState->AvoidRadiusSq);
-    grid_range Range = GridGetRange(Grid, BirdPosition, V1X4(Max(DemoState->BirdRadiusSq, DemoState->AvoidRadiusSq)), ValidMask);
-    for (u32 GridY = Range.StartY; GridY <= Range.EndY; ++GridY)
-    {
-        for (u32 GridX = Range.StartX; GridX <= Range.EndX; ++GridX)
-        {
-            grid_cell* CurrCell = Grid->Cells + GridY * Grid->NumCellsX + GridX;
-
-            // NOTE: Loop over all birds in the grid
-            u32 GlobalIndexId = 0;
-            for (block* CurrBlock = CurrCell->IndexArena.Next; CurrBlock; CurrBlock = CurrBlock->Next)
-            {
-                u32* BlockIndices = BlockGetData(CurrBlock, u32);
-                u32 NumIndicesInBlock = Min(CurrCell->NumIndices - GlobalIndexId, Grid->MaxNumIndicesPerBlock);
-                for (u32 IndexId = 0; IndexId < NumIndicesInBlock; ++IndexId, ++GlobalIndexId)
-                {
-                    u32 NearbyBirdId = BlockIndices[IndexId];
-                    v1u_x4 SameBirdMask = V1UX4(NearbyBirdId) != CurrBirdId;
-                        
-                    v2_x4 NearbyBirdPos = V2X4(BirdArray.PosX[NearbyBirdId], BirdArray.PosY[NearbyBirdId]);
-                    v2_x4 DistanceVec = NearbyBirdPos - BirdPosition;
-                    v1_x4 DistanceSq = LengthSquared(DistanceVec);
-
-                    // TODO: Add a proper FOV
-                    v1u_x4 BirdRadiusMask = SameBirdMask & V1UX4Cast(DistanceSq < BirdRadiusSq) & V1UX4(0x1);
-                    v1_x4 BirdRadiusMaskFloat = V1X4(BirdRadiusMask);
-                    Result.NumBirdsInRadius += BirdRadiusMask;
-                                
-                    // NOTE: Velocity Matching
-                    Result.AvgFlockDir += BirdRadiusMaskFloat * V2X4(BirdArray.VelX[NearbyBirdId], BirdArray.VelY[NearbyBirdId]);
-
-                    // NOTE: Bird Flocking
-                    Result.AvgFlockPos += BirdRadiusMaskFloat * NearbyBirdPos;
-
-                    // NOTE: Avoidance
-                    v1u_x4 AvoidRadiusMask = SameBirdMask & V1UX4Cast(DistanceSq < AvoidRadiusSq) & V1UX4(0x1);
-                    v1_x4 AvoidRadiusMaskFloat = V1X4(AvoidRadiusMask);
-                    Result.AvgFlockAvoidance += AvoidRadiusMaskFloat * (-DistanceVec);
-                }
-            }
-        }
-    }
-    
-    return Result;
-}
-
 //
 // NOTE: Asset Storage System
 //
@@ -454,48 +270,25 @@ DEMO_INIT(Init)
     
     // NOTE: Init Boids
     {
-        DemoState->MinSpeed = 1.088f;
-        DemoState->MaxSpeed = 1.55f;
-
-        DemoState->BirdRadiusSq = 0.138f;
-        DemoState->AvoidRadiusSq=  0.02598f;
-        DemoState->TerrainAvoidRadius = 0.25292f;
-
-        DemoState->TerrainRadius = 10.5f; //10.55f;
-        DemoState->PlatformBlockArena = PlatformBlockArenaCreate(KiloBytes(256), 64);
-        u32 CellCountForAxis = 64;
-        f32 CellSize = DemoState->TerrainRadius * 2.0f / f32(CellCountForAxis);
-        DemoState->Grid = GridCreate(&DemoState->Arena, &DemoState->PlatformBlockArena, AabbCenterRadius(V2(0), V2(DemoState->TerrainRadius)),
-                                     CellCountForAxis, CellCountForAxis);
-        
-        DemoState->AvoidTerrainWeight = 0.14117f;
-        DemoState->AvoidBirdWeight = 0.07352f;
-        DemoState->AlignFlockWeight = 0.09117f;
-        DemoState->MoveToFlockWeight = 0.22352f;
-                
         DemoState->BirdRadius = V3(0.05f);
-        DemoState->NumBirds = 10000;
-        u32 PaddedNumBirds = DemoState->NumBirds + 4;
-        DemoState->CurrBirds.PosX = PushArray(&DemoState->Arena, f32, PaddedNumBirds);
-        DemoState->CurrBirds.PosY = PushArray(&DemoState->Arena, f32, PaddedNumBirds);
-        DemoState->CurrBirds.VelX = PushArray(&DemoState->Arena, f32, PaddedNumBirds);
-        DemoState->CurrBirds.VelY = PushArray(&DemoState->Arena, f32, PaddedNumBirds);
-        DemoState->PrevBirds.PosX = PushArray(&DemoState->Arena, f32, PaddedNumBirds);
-        DemoState->PrevBirds.PosY = PushArray(&DemoState->Arena, f32, PaddedNumBirds);
-        DemoState->PrevBirds.VelX = PushArray(&DemoState->Arena, f32, PaddedNumBirds);
-        DemoState->PrevBirds.VelY = PushArray(&DemoState->Arena, f32, PaddedNumBirds);
-        
-        for (u32 BirdId = 0; BirdId < DemoState->NumBirds; ++BirdId)
+        // NOTE: Worker threads would be left running old code after a hot reload, so the demo steps the sim on one thread
+        SimInit(&DemoState->Sim, &DemoState->Arena, 10000, 1, 1, 256);
+
+        // NOTE: Obstacles made with boids_bench -obstacles 8 -seed 1 -sdfout boids_obstacles.sdf, the birds keep the plain
+        //       walls if the file is missing
+        FILE* SdfFile = fopen("boids_obstacles.sdf", "rb");
+        if (SdfFile)
         {
-            f32 RandVel = Lerp(DemoState->MinSpeed, DemoState->MaxSpeed, RandFloat());
-            v2 Pos = 2.0f * V2(RandFloat(), RandFloat()) - V2(1);
-            Pos *= 0.9f * DemoState->TerrainRadius;
-            v2 Vel = 0.5f * RandVel * Normalize(2.0f * V2(RandFloat(), RandFloat()) - V2(1));
-
-            DemoState->PrevBirds.PosX[BirdId] = Pos.x;
-            DemoState->PrevBirds.PosY[BirdId] = Pos.y;
-            DemoState->PrevBirds.VelX[BirdId] = Vel.x;
-            DemoState->PrevBirds.VelY[BirdId] = Vel.y;
+            fseek(SdfFile, 0, SEEK_END);
+            u64 SdfSize = u64(ftell(SdfFile));
+            fseek(SdfFile, 0, SEEK_SET);
+            void* SdfData = malloc(SdfSize);
+            if (fread(SdfData, 1, SdfSize, SdfFile) == SdfSize)
+            {
+                SimLoadSdf(&DemoState->Sim, &DemoState->Arena, SdfData, SdfSize);
+            }
+            free(SdfData);
+            fclose(SdfFile);
         }
     }
     
@@ -559,6 +352,7 @@ DEMO_DESTROY(Destroy)
 {
     // TODO: Remove if we can verify that this is auto destroyed (check recompiling if it calls the destructor)
     ProfilerStateDestroy();
+    SimDestroy(&DemoState->Sim);
 }
 
 DEMO_SWAPCHAIN_CHANGE(SwapChainChange)
@@ -627,62 +421,68 @@ DEMO_MAIN_LOOP(MainLoop)
             
                 UiPanelNextRowIndent(&Panel);
                 UiPanelText(&Panel, "Min Speed:");
-                UiPanelHorizontalSlider(&Panel, 0.0f, 10.0f, &DemoState->MinSpeed);
-                UiPanelNumberBox(&Panel, 0.0f, 10.0f, &DemoState->MinSpeed);
+                UiPanelHorizontalSlider(&Panel, 0.0f, 10.0f, &DemoState->Sim.MinSpeed);
+                UiPanelNumberBox(&Panel, 0.0f, 10.0f, &DemoState->Sim.MinSpeed);
                 UiPanelNextRow(&Panel);
             
                 UiPanelNextRowIndent(&Panel);
                 UiPanelText(&Panel, "Max Speed:");
-                UiPanelHorizontalSlider(&Panel, 0.0f, 10.0f, &DemoState->MaxSpeed);
-                UiPanelNumberBox(&Panel, 0.0f, 10.0f, &DemoState->MaxSpeed);
+                UiPanelHorizontalSlider(&Panel, 0.0f, 10.0f, &DemoState->Sim.MaxSpeed);
+                UiPanelNumberBox(&Panel, 0.0f, 10.0f, &DemoState->Sim.MaxSpeed);
                 UiPanelNextRow(&Panel);
             
                 UiPanelNextRowIndent(&Panel);
                 UiPanelText(&Panel, "Bird Radius Sq:");
-                UiPanelHorizontalSlider(&Panel, 0.0f, 1.0f, &DemoState->BirdRadiusSq);
-                UiPanelNumberBox(&Panel, 0.0f, 1.0f, &DemoState->BirdRadiusSq);
+                UiPanelHorizontalSlider(&Panel, 0.0f, 1.0f, &DemoState->Sim.BirdRadiusSq);
+                UiPanelNumberBox(&Panel, 0.0f, 1.0f, &DemoState->Sim.BirdRadiusSq);
                 UiPanelNextRow(&Panel);
             
                 UiPanelNextRowIndent(&Panel);
                 UiPanelText(&Panel, "Avoid Radius Sq:");
-                UiPanelHorizontalSlider(&Panel, 0.0f, 1.0f, &DemoState->AvoidRadiusSq);
-                UiPanelNumberBox(&Panel, 0.0f, 1.0f, &DemoState->AvoidRadiusSq);
+                UiPanelHorizontalSlider(&Panel, 0.0f, 1.0f, &DemoState->Sim.AvoidRadiusSq);
+                UiPanelNumberBox(&Panel, 0.0f, 1.0f, &DemoState->Sim.AvoidRadiusSq);
                 UiPanelNextRow(&Panel);
             
                 UiPanelNextRowIndent(&Panel);
                 UiPanelText(&Panel, "Terrain Avoid Radius:");
-                UiPanelHorizontalSlider(&Panel, 0.0f, 1.0f, &DemoState->TerrainAvoidRadius);
-                UiPanelNumberBox(&Panel, 0.0f, 1.0f, &DemoState->TerrainAvoidRadius);
+                UiPanelHorizontalSlider(&Panel, 0.0f, 1.0f, &DemoState->Sim.TerrainAvoidRadius);
+                UiPanelNumberBox(&Panel, 0.0f, 1.0f, &DemoState->Sim.TerrainAvoidRadius);
                 UiPanelNextRow(&Panel);
             
                 UiPanelNextRowIndent(&Panel);
                 UiPanelText(&Panel, "Terrain Radius:");
-                UiPanelHorizontalSlider(&Panel, 0.0f, 50.0f, &DemoState->TerrainRadius);
-                UiPanelNumberBox(&Panel, 0.0f, 50.0f, &DemoState->TerrainRadius);
+                UiPanelHorizontalSlider(&Panel, 0.0f, 50.0f, &DemoState->Sim.TerrainRadius);
+                UiPanelNumberBox(&Panel, 0.0f, 50.0f, &DemoState->Sim.TerrainRadius);
                 UiPanelNextRow(&Panel);
             
                 UiPanelNextRowIndent(&Panel);
                 UiPanelText(&Panel, "Avoid Terrain Weight:");
-                UiPanelHorizontalSlider(&Panel, 0.0f, 1.0f, &DemoState->AvoidTerrainWeight);
-                UiPanelNumberBox(&Panel, 0.0f, 1.0f, &DemoState->AvoidTerrainWeight);
+                UiPanelHorizontalSlider(&Panel, 0.0f, 1.0f, &DemoState->Sim.AvoidTerrainWeight);
+                UiPanelNumberBox(&Panel, 0.0f, 1.0f, &DemoState->Sim.AvoidTerrainWeight);
                 UiPanelNextRow(&Panel);
             
                 UiPanelNextRowIndent(&Panel);
                 UiPanelText(&Panel, "Avoid Bird Weight:");
-                UiPanelHorizontalSlider(&Panel, 0.0f, 1.0f, &DemoState->AvoidBirdWeight);
-                UiPanelNumberBox(&Panel, 0.0f, 1.0f, &DemoState->AvoidBirdWeight);
+                UiPanelHorizontalSlider(&Panel, 0.0f, 1.0f, &DemoState->Sim.AvoidBirdWeight);
+                UiPanelNumberBox(&Panel, 0.0f, 1.0f, &DemoState->Sim.AvoidBirdWeight);
                 UiPanelNextRow(&Panel);
             
                 UiPanelNextRowIndent(&Panel);
                 UiPanelText(&Panel, "Align Flock Weight:");
-                UiPanelHorizontalSlider(&Panel, 0.0f, 1.0f, &DemoState->AlignFlockWeight);
-                UiPanelNumberBox(&Panel, 0.0f, 1.0f, &DemoState->AlignFlockWeight);
+                UiPanelHorizontalSlider(&Panel, 0.0f, 1.0f, &DemoState->Sim.AlignFlockWeight);
+                UiPanelNumberBox(&Panel, 0.0f, 1.0f, &DemoState->Sim.AlignFlockWeight);
                 UiPanelNextRow(&Panel);
             
                 UiPanelNextRowIndent(&Panel);
                 UiPanelText(&Panel, "Move To Flock Weight:");
-                UiPanelHorizontalSlider(&Panel, 0.0f, 1.0f, &DemoState->MoveToFlockWeight);
-                UiPanelNumberBox(&Panel, 0.0f, 1.0f, &DemoState->MoveToFlockWeight);
+                UiPanelHorizontalSlider(&Panel, 0.0f, 1.0f, &DemoState->Sim.MoveToFlockWeight);
+                UiPanelNumberBox(&Panel, 0.0f, 1.0f, &DemoState->Sim.MoveToFlockWeight);
+                UiPanelNextRow(&Panel);
+
+                UiPanelNextRowIndent(&Panel);
+                UiPanelText(&Panel, "FOV Cos Half Angle:");
+                UiPanelHorizontalSlider(&Panel, -1.0f, 1.0f, &DemoState->Sim.FovCosHalfAngle);
+                UiPanelNumberBox(&Panel, -1.0f, 1.0f, &DemoState->Sim.FovCosHalfAngle);
                 UiPanelNextRow(&Panel);
             
             }
@@ -721,158 +521,18 @@ DEMO_MAIN_LOOP(MainLoop)
                 {
                     CPU_TIMED_BLOCK("Add Instances");
                 
-                    grid* Grid = &DemoState->Grid;
-                    temp_mem TempMem = BeginTempMem(&DemoState->TempArena);
-                
-                    // NOTE: Terrain
-                    SceneOpaqueInstanceAdd(Scene, DemoState->Quad, M4Pos(V3(0.0f, 0.0f, 0.0f)) * M4Scale(V3(2.0f*DemoState->TerrainRadius)), V4(0.7f, 0.4f, 0.4f, 1.0f));
-
-                    local_global b32 EvenFrame = true;
-
-                    bird_array PrevBirdArray = EvenFrame ? DemoState->PrevBirds : DemoState->CurrBirds;
-                    bird_array CurrBirdArray = EvenFrame ? DemoState->CurrBirds : DemoState->PrevBirds;
-                    EvenFrame = !EvenFrame;
-                
-                    // NOTE: Add all birds to grid data structure
-                    u32* BirdGridIds = PushArray(&DemoState->TempArena, u32, DemoState->NumBirds);
-                    {
-                        CPU_TIMED_BLOCK("Generate Grid");
-                        for (u32 BirdId = 0; BirdId < DemoState->NumBirds; ++BirdId)
-                        {
-                            v2 Pos = V2(PrevBirdArray.PosX[BirdId], PrevBirdArray.PosY[BirdId]);
-                            BirdGridIds[BirdId] = GridAddEntity(&DemoState->Grid, Pos, BirdId);
-                        }
-                    }
-                
-                    // NOTE: Update birds
-                    {
-                        CPU_TIMED_BLOCK("Update Birds");
-
-                        // NOTE: Loop over all grids and all entities in the grids
-                        v1_x4 TerrainAvoidRadius = V1X4(DemoState->TerrainAvoidRadius);
-                        v1_x4 TerrainRadius = V1X4(DemoState->TerrainRadius);
-                        u32 GlobalIndexId = 0;
-                        for (u32 GridY = 0; GridY < Grid->NumCellsY; ++GridY)
-                        {
-                            for (u32 GridX = 0; GridX < Grid->NumCellsX; ++GridX)
-                            {
-                                grid_cell* CurrCell = Grid->Cells + GridY * Grid->NumCellsX + GridX;
-
-                                u32 BirdBlockIndexId = 0;
-                                for (block* CurrBlock = CurrCell->IndexArena.Next; CurrBlock; CurrBlock = CurrBlock->Next)
-                                {
-                                    u32* BlockIndices = BlockGetData(CurrBlock, u32);
-                                    u32 NumIndicesInBlock = Min(CurrCell->NumIndices - BirdBlockIndexId, Grid->MaxNumIndicesPerBlock);
-                                    for (u32 IndexId = 0; IndexId < NumIndicesInBlock; IndexId += 4)
-                                    {
-                                        v1u_x4 CurrBirdId = V1UX4LoadUnAligned(BlockIndices + IndexId);
-                                        u32 FirstBirdId = CurrBirdId.e[0];
-
-                                        // TODO: Add scalar comparison ops
-                                        // NOTE: Check if we can do a load or if we have to gather
-                                        v1u_x4 BirdValidMask = (V1UX4(IndexId) + V1UX4(0, 1, 2, 3)) < V1UX4(NumIndicesInBlock);
-                                        v1u_x4 AlignedMask = {};
-                                        {
-                                            v1u_x4 FirstBirdVec = V1UX4(FirstBirdId);
-                                            AlignedMask = (CurrBirdId - FirstBirdVec) == V1UX4(1);
-                                        }
-
-                                        // NOTE: Load bird data
-                                        v2_x4 NewBirdPosition = {};
-                                        v2_x4 NewBirdVelocity = {};
-                                        {
-                                            if (MoveMask(BirdValidMask) == 0xF && MoveMask(AlignedMask) == 0xF)
-                                            {
-                                                // NOTE: We can do aligned loads here
-                                                NewBirdPosition = V2X4LoadUnAligned(PrevBirdArray.PosX + FirstBirdId, PrevBirdArray.PosY + FirstBirdId);
-                                                NewBirdVelocity = V2X4LoadUnAligned(PrevBirdArray.VelX + FirstBirdId, PrevBirdArray.VelY + FirstBirdId);
-                                            }
-                                            else
-                                            {
-                                                // NOTE: We have to do a masked gather here
-                                                NewBirdPosition = V2X4Gather(PrevBirdArray.PosX, PrevBirdArray.PosY, CurrBirdId, BirdValidMask);
-                                                NewBirdVelocity = V2X4Gather(PrevBirdArray.VelX, PrevBirdArray.VelY, CurrBirdId, BirdValidMask);
-                                            }
-                                        }
-                                                                                
-                                        bird_average_data AverageData = GridGetAverageData(Grid, PrevBirdArray, NewBirdPosition,
-                                                                                           CurrBirdId, BirdValidMask);
-                                        
-                                        // NOTE: Apply rules
-                                        {
-                                            CPU_TIMED_BLOCK("Apply Rules");
-                                            
-                                            // NOTE: Only the flock pos has to be averaged
-                                            {
-                                                v1_x4 DivideFactor = V1X4(Max(V1UX4(1), AverageData.NumBirdsInRadius));
-                                                AverageData.AvgFlockDir /= DivideFactor;
-                                                AverageData.AvgFlockPos /= DivideFactor;
-                                            }
-                    
-                                            // NOTE: Avoid Wall Vel
-                                            // IMPORTANT: DOnt add float type to the 1 and 0 or MSVC barfs
-                                            v2_x4 AvoidWallDir = {};
-                                            AvoidWallDir.x += (NewBirdPosition.x - TerrainAvoidRadius <= -TerrainRadius) & V1X4(0x1);
-                                            AvoidWallDir.x -= (NewBirdPosition.x + TerrainAvoidRadius >= TerrainRadius) & V1X4(0x1);
-                                            AvoidWallDir.y += (NewBirdPosition.y - TerrainAvoidRadius <= -TerrainRadius) & V1X4(0x1);
-                                            AvoidWallDir.y -= (NewBirdPosition.y + TerrainAvoidRadius >= TerrainRadius) & V1X4(0x1);
-
-                                            // NOTE: Fly towards center
-                                            {
-                                                v1_x4 Mask = V1X4(AverageData.NumBirdsInRadius > V1UX4(0)) & V1X4(0x1);
-                                                NewBirdVelocity += Mask * DemoState->MoveToFlockWeight * (AverageData.AvgFlockPos - NewBirdPosition);
-                                            }
-                                            
-                                            // NOTE: Avoid Others
-                                            NewBirdVelocity += DemoState->AvoidBirdWeight * AverageData.AvgFlockAvoidance;
-
-                                            // NOTE: Align Velocities
-                                            {
-                                                v1_x4 Mask = V1X4(AverageData.NumBirdsInRadius > V1UX4(0)) & V1X4(0x1);
-                                                NewBirdVelocity += Mask * DemoState->AlignFlockWeight * (AverageData.AvgFlockDir - NewBirdVelocity);
-                                            }
-                        
-                                            // NOTE: Clamp Velocity
-                                            v1_x4 BirdSpeed = Clamp(Length(NewBirdVelocity), V1X4(DemoState->MinSpeed), V1X4(DemoState->MaxSpeed));
-                                            NewBirdVelocity = BirdSpeed * Normalize(NewBirdVelocity);
-
-                                            // NOTE: Avoid Terrain
-                                            NewBirdVelocity += DemoState->AvoidTerrainWeight * AvoidWallDir;
+                    sim_state* Sim = &DemoState->Sim;
+                    SimStep(Sim, ModifiedFrameTime);
                     
-                                            NewBirdPosition += NewBirdVelocity * ModifiedFrameTime;
-
-                                            // NOTE: Clamp to be in bounds (a bit hacky since sometimes they can escape)
-                                            NewBirdPosition = Clamp(NewBirdPosition, V2X4(-TerrainRadius + 0.01f), V2X4(TerrainRadius - 0.01f));
-                                            
-                                            // NOTE: Write into next bird array (we do unaligned store since sometimes we store <4
-                                            // elements and then next write won't be aligned)
-
-                                            if (GlobalIndexId >= 2990)
-                                            {
-                                                int i = 0;
-                                            }
-                                            
-                                            StoreUnAligned(NewBirdVelocity.x, CurrBirdArray.VelX + GlobalIndexId + IndexId);
-                                            StoreUnAligned(NewBirdVelocity.y, CurrBirdArray.VelY + GlobalIndexId + IndexId);
-                                            StoreUnAligned(NewBirdPosition.x, CurrBirdArray.PosX + GlobalIndexId + IndexId);
-                                            StoreUnAligned(NewBirdPosition.y, CurrBirdArray.PosY + GlobalIndexId + IndexId);
-                                        }
-                                    }
-
-                                    BirdBlockIndexId += NumIndicesInBlock;
-                                    GlobalIndexId += NumIndicesInBlock;
-                                }
-                            }
-                        }
-                    }
-                
-                    EndTempMem(TempMem);
+                    // NOTE: Terrain
+                    SceneOpaqueInstanceAdd(Scene, DemoState->Quad, M4Pos(V3(0.0f, 0.0f, 0.0f)) * M4Scale(V3(2.0f*Sim->TerrainRadius)), V4(0.7f, 0.4f, 0.4f, 1.0f));
 
                     // NOTE: Generate rendering instances
                     {
                         CPU_TIMED_BLOCK("Gen Render Instances");
                         
-                        for (u32 BirdId = 0; BirdId < DemoState->NumBirds; ++BirdId)
+                        bird_array CurrBirdArray = Sim->CurrBirds;
+                        for (u32 BirdId = 0; BirdId < Sim->NumBirds; ++BirdId)
                         {
                             v2 Position = V2(CurrBirdArray.PosX[BirdId], CurrBirdArray.PosY[BirdId]);
                             v2 Velocity = V2(CurrBirdArray.VelX[BirdId], CurrBirdArray.VelY[BirdId]);
@@ -881,12 +541,6 @@ DEMO_MAIN_LOOP(MainLoop)
                             SceneOpaqueInstanceAdd(Scene, DemoState->Cube, Transform, V4(0.4f, 0.3f, 0.6f, 1.0f));
                         }
                     }
-                    
-                    // NOTE: Clear the grid
-                    {
-                        CPU_TIMED_BLOCK("Clear Grid");
-                        GridClear(Grid);
-                    }
                 }
 
                 {
@@ -9,49 +9,8 @@
 //#define X86_PROFILING
 #include "profiling\profiling.h"
 
-//
-// NOTE: Sim handling
-//
-
-struct grid_range
-{
-    u32 StartX;
-    u32 StartY;
-    u32 EndX;
-    u32 EndY;
-};
-
-struct grid_cell
-{
-    u32 NumIndices;
-    block_arena IndexArena;
-};
-
-struct grid
-{
-    aabb2 WorldBounds;
-    u32 NumCellsX;
-    u32 NumCellsY;
-    u32 MaxNumIndicesPerBlock;
-    grid_cell* Cells;
-};
-
-struct bird_array
-{
-    // TODO: Handle multiple grid cells for one entity
-    f32* PosX;
-    f32* PosY;
-    f32* VelX;
-    f32* VelY;
-};
-
-struct bird_average_data
-{
-    v1u_x4 NumBirdsInRadius;
-    v2_x4 AvgFlockDir;
-    v2_x4 AvgFlockPos;
-    v2_x4 AvgFlockAvoidance;
-};
+#define SIM_TIMED_BLOCK(Name) CPU_TIMED_BLOCK(Name)
+#include "boids_sim.h"
 
 //
 // NOTE: Render Data
@@ -140,7 +99,6 @@ struct render_scene
 
 struct demo_state
 {
-    platform_block_arena PlatformBlockArena;
     linear_arena Arena;
     linear_arena TempArena;
 
@@ -166,26 +124,9 @@ struct demo_state
     u32 Cube;
     u32 Sphere;
 
-    // NOTE: Boid Globals
-    f32 MinSpeed;
-    f32 MaxSpeed;
-    f32 BirdRadiusSq;
-    f32 AvoidRadiusSq;
-    f32 TerrainAvoidRadius;
-    f32 TerrainRadius;
-
-    f32 AvoidTerrainWeight;
-    f32 AvoidBirdWeight;
-    f32 AlignFlockWeight;
-    f32 MoveToFlockWeight;
-    
-    // NOTE: Bird Data
+    // NOTE: Boid Data
     v3 BirdRadius;
-    u32 NumBirds;
-    bird_array CurrBirds;
-    bird_array PrevBirds;
-
-    grid Grid;
+    sim_state Sim;
 };
 
 global demo_state* DemoState;
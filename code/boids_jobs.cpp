@@ -0,0 +1,164 @@
+
+#include "boids_jobs.h"
+
+#include <new>
+
+inline u64 JobRangePack(u32 Begin, u32 End)
+{
+    u64 Result = (u64(End) << 32) | u64(Begin);
+    return Result;
+}
+
+inline b32 JobQueuePopFront(job_queue* Queue, u32* JobId)
+{
+    u64 Range = Queue->Range.load(std::memory_order_relaxed);
+    while (true)
+    {
+        u32 Begin = u32(Range);
+        u32 End = u32(Range >> 32);
+        if (Begin >= End)
+        {
+            return false;
+        }
+
+        if (Queue->Range.compare_exchange_weak(Range, JobRangePack(Begin + 1, End), std::memory_order_acquire))
+        {
+            *JobId = Begin;
+            return true;
+        }
+    }
+}
+
+inline b32 JobQueueStealBack(job_queue* Queue, u32* JobId)
+{
+    u64 Range = Queue->Range.load(std::memory_order_relaxed);
+    while (true)
+    {
+        u32 Begin = u32(Range);
+        u32 End = u32(Range >> 32);
+        if (Begin >= End)
+        {
+            return false;
+        }
+
+        if (Queue->Range.compare_exchange_weak(Range, JobRangePack(Begin, End - 1), std::memory_order_acquire))
+        {
+            *JobId = End - 1;
+            return true;
+        }
+    }
+}
+
+inline void JobSystemDoWork(job_system* JobSystem, u32 ThreadId)
+{
+    job_callback* Callback = JobSystem->Callback;
+    void* Data = JobSystem->CallbackData;
+
+    // NOTE: Drain our own range first
+    u32 JobId = 0;
+    while (JobQueuePopFront(JobSystem->Queues + ThreadId, &JobId))
+    {
+        Callback(Data, ThreadId, JobId);
+    }
+
+    // NOTE: Steal from everyone else until there is nothing left
+    for (u32 Offset = 1; Offset < JobSystem->NumThreads; ++Offset)
+    {
+        job_queue* Victim = JobSystem->Queues + (ThreadId + Offset) % JobSystem->NumThreads;
+        while (JobQueueStealBack(Victim, &JobId))
+        {
+            Callback(Data, ThreadId, JobId);
+        }
+    }
+}
+
+inline void JobSystemWorkerMain(job_system* JobSystem, u32 ThreadId)
+{
+    SimProfilerThreadId = ThreadId;
+    
+    u64 SeenGeneration = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> Lock(JobSystem->Mutex);
+            JobSystem->WorkCondition.wait(Lock, [&] { return JobSystem->Quit || JobSystem->Generation != SeenGeneration; });
+            if (JobSystem->Quit)
+            {
+                break;
+            }
+            SeenGeneration = JobSystem->Generation;
+        }
+
+        JobSystemDoWork(JobSystem, ThreadId);
+
+        {
+            std::lock_guard<std::mutex> Lock(JobSystem->Mutex);
+            JobSystem->NumWorkersRunning -= 1;
+        }
+        JobSystem->DoneCondition.notify_one();
+    }
+}
+
+job_system* JobSystemCreate(linear_arena* Arena, u32 NumThreads)
+{
+    Assert(NumThreads > 0 && NumThreads <= JOB_MAX_THREADS);
+
+    job_system* Result = new (PushStruct(Arena, job_system)) job_system();
+    Result->NumThreads = NumThreads;
+    for (u32 ThreadId = 1; ThreadId < NumThreads; ++ThreadId)
+    {
+        Result->Workers[ThreadId] = std::thread(JobSystemWorkerMain, Result, ThreadId);
+    }
+
+    return Result;
+}
+
+void JobSystemDestroy(job_system* JobSystem)
+{
+    {
+        std::lock_guard<std::mutex> Lock(JobSystem->Mutex);
+        JobSystem->Quit = true;
+    }
+    JobSystem->WorkCondition.notify_all();
+
+    for (u32 ThreadId = 1; ThreadId < JobSystem->NumThreads; ++ThreadId)
+    {
+        JobSystem->Workers[ThreadId].join();
+    }
+    JobSystem->~job_system();
+}
+
+void JobSystemParallelFor(job_system* JobSystem, u32 NumJobs, job_callback* Callback, void* Data)
+{
+    if (JobSystem->NumThreads == 1 || NumJobs == 1)
+    {
+        for (u32 JobId = 0; JobId < NumJobs; ++JobId)
+        {
+            Callback(Data, 0, JobId);
+        }
+        return;
+    }
+
+    // NOTE: Split jobs evenly so that stealing only has to fix up imbalance
+    u32 NumThreads = JobSystem->NumThreads;
+    for (u32 ThreadId = 0; ThreadId < NumThreads; ++ThreadId)
+    {
+        u32 Begin = u32(u64(NumJobs) * ThreadId / NumThreads);
+        u32 End = u32(u64(NumJobs) * (ThreadId + 1) / NumThreads);
+        JobSystem->Queues[ThreadId].Range.store(JobRangePack(Begin, End), std::memory_order_relaxed);
+    }
+
+    {
+        std::lock_guard<std::mutex> Lock(JobSystem->Mutex);
+        JobSystem->Callback = Callback;
+        JobSystem->CallbackData = Data;
+        JobSystem->NumWorkersRunning = NumThreads - 1;
+        JobSystem->Generation += 1;
+    }
+    JobSystem->WorkCondition.notify_all();
+
+    JobSystemDoWork(JobSystem, 0);
+
+    std::unique_lock<std::mutex> Lock(JobSystem->Mutex);
+    JobSystem->DoneCondition.wait(Lock, [&] { return JobSystem->NumWorkersRunning == 0; });
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+/*
+
+  NOTE: Small fork/join job system for the sim. Every parallel for splits its jobs into one contiguous range per thread.
+        Owners pop jobs from the front of their range and idle threads steal from the back of other ranges, both through a
+        CAS on a packed (Begin, End) pair so a job can never run twice. The calling thread always works as thread 0.
+
+ */
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#define JOB_MAX_THREADS 64
+
+typedef void job_callback(void* Data, u32 ThreadId, u32 JobId);
+
+struct alignas(64) job_queue
+{
+    // NOTE: Low 32 bits are the next job to pop, high 32 bits are one past the last job to steal
+    std::atomic<u64> Range;
+};
+
+struct job_system
+{
+    u32 NumThreads;
+    std::thread Workers[JOB_MAX_THREADS];
+    job_queue Queues[JOB_MAX_THREADS];
+
+    std::mutex Mutex;
+    std::condition_variable WorkCondition;
+    std::condition_variable DoneCondition;
+    u64 Generation;
+    u32 NumWorkersRunning;
+    b32 Quit;
+
+    job_callback* Callback;
+    void* CallbackData;
+};
+
+job_system* JobSystemCreate(linear_arena* Arena, u32 NumThreads);
+void JobSystemDestroy(job_system* JobSystem);
+void JobSystemParallelFor(job_system* JobSystem, u32 NumJobs, job_callback* Callback, void* Data);
@@ -0,0 +1,2335 @@
+
+#include "boids_sim.h"
+
+sim_profiler SimProfiler;
+thread_local u32 SimProfilerThreadId;
+
+#include "boids_jobs.cpp"
+#include "boids_sim_lanes.h"
+
+//
+// NOTE: Random Numbers
+//
+
+inline sim_random_series SimRandomSeriesCreate(u32 Seed)
+{
+    sim_random_series Result = {};
+    // NOTE: Xorshift gets stuck on a zero state
+    Result.State = Seed ? Seed : 0x9E3779B9;
+    return Result;
+}
+
+inline u32 RandU32(sim_random_series* Series)
+{
+    // NOTE: Xorshift32, we only need it to be deterministic across platforms unlike rand()
+    u32 Result = Series->State;
+    Result ^= Result << 13;
+    Result ^= Result >> 17;
+    Result ^= Result << 5;
+    Series->State = Result;
+    return Result;
+}
+
+inline f32 RandFloat(sim_random_series* Series)
+{
+    f32 Result = f32(RandU32(Series) >> 8) / f32(1 << 24);
+    return Result;
+}
+
+//
+// NOTE: Spatial Partition
+//
+
+inline u32 MortonSpreadBits(u32 Value)
+{
+    // NOTE: Moves bit i of a 16bit value to bit 2i
+    Value &= 0x0000FFFF;
+    Value = (Value | (Value << 8)) & 0x00FF00FF;
+    Value = (Value | (Value << 4)) & 0x0F0F0F0F;
+    Value = (Value | (Value << 2)) & 0x33333333;
+    Value = (Value | (Value << 1)) & 0x55555555;
+    return Value;
+}
+
+inline u32 MortonEncode(u32 X, u32 Y)
+{
+    u32 Result = MortonSpreadBits(X) | (MortonSpreadBits(Y) << 1);
+    return Result;
+}
+
+inline u32 MortonIncrementX(u32 Id)
+{
+    // NOTE: Fill the Y bits with 1s so the carry of the add skips over them
+    u32 Result = (((Id | 0xAAAAAAAA) + 1) & 0x55555555) | (Id & 0xAAAAAAAA);
+    return Result;
+}
+
+inline u32 GridGetCellId(grid* Grid, u32 CellX, u32 CellY)
+{
+    u32 Result = 0;
+    if (Grid->CellOrder == GridCellOrder_Morton)
+    {
+        Result = MortonEncode(CellX, CellY);
+    }
+    else if (Grid->CellOrder == GridCellOrder_Hashed)
+    {
+        // NOTE: Cells can be negative or past the end, as u32 the masks still wrap them
+        Result = (CellY & (Grid->NumCellsY - 1)) * Grid->NumCellsX + (CellX & (Grid->NumCellsX - 1));
+    }
+    else
+    {
+        Result = CellY * Grid->NumCellsX + CellX;
+    }
+
+    return Result;
+}
+
+inline grid GridCreate(linear_arena* Arena, platform_block_arena* BlockArena, aabb2 WorldBounds, u32 NumCellsX, u32 NumCellsY,
+                       u32 MaxNumEntities)
+{
+    grid Result = {};
+    Result.Layout = GridLayout_Compact;
+    Result.WorldBounds = WorldBounds;
+    Result.NumCellsX = NumCellsX;
+    Result.NumCellsY = NumCellsY;
+    Result.MaxNumCellsX = NumCellsX;
+    Result.MaxNumCellsY = NumCellsY;
+    Result.NumCellsZ = 1;
+    Result.Cells = PushArray(Arena, grid_cell, NumCellsX * NumCellsY);
+
+    for (u32 CellId = 0; CellId < NumCellsX * NumCellsY; ++CellId)
+    {
+        grid_cell* CurrCell = Result.Cells + CellId;
+        *CurrCell = {};
+        CurrCell->IndexArena = BlockArenaCreate(BlockArena, sizeof(v1u_x4));
+    }
+
+    Result.MaxNumIndicesPerBlock = u32(BlockArenaGetBlockSize(&Result.Cells[0].IndexArena) / sizeof(v1u_x4));
+    Result.MaxNumIndicesPerBlock *= 4;
+
+    // NOTE: Compact layout, indices are padded so that the last packet of a cell can always be loaded
+    Result.CellStart = PushArray(Arena, u32, NumCellsX * NumCellsY);
+    Result.CellCount = PushArray(Arena, u32, NumCellsX * NumCellsY);
+    Result.Indices = PushArray(Arena, u32, MaxNumEntities + 4);
+    Result.IndexCellIds = PushArray(Arena, u32, MaxNumEntities + 4);
+    Result.NextCellIds = PushArray(Arena, u32, MaxNumEntities + 4);
+    
+    return Result;
+}
+
+inline void GridResize(grid* Grid, u32 NumCellsX, u32 NumCellsY)
+{
+    // NOTE: Only valid while the grid is cleared, which it is between steps
+    Assert(NumCellsX > 0 && NumCellsX <= Grid->MaxNumCellsX);
+    Assert(NumCellsY > 0 && NumCellsY <= Grid->MaxNumCellsY);
+    Grid->NumCellsX = NumCellsX;
+    Grid->NumCellsY = NumCellsY;
+}
+
+inline u32 GridAddEntity(grid* Grid, v2 Position, u32 EntityId)
+{
+    u32 Result = 0;
+
+    v2 ReMappedPos = (Position - Grid->WorldBounds.Min) / AabbGetDim(Grid->WorldBounds);
+    i32 GridCellX = FloorU32(ReMappedPos.x * u32(Grid->NumCellsX));
+    i32 GridCellY = FloorU32(ReMappedPos.y * u32(Grid->NumCellsY));
+
+    Assert(GridCellX >= 0 && GridCellX < i32(Grid->NumCellsX));
+    Assert(GridCellY >= 0 && GridCellY < i32(Grid->NumCellsY));
+
+    grid_cell* GridCell = Grid->Cells + GridGetCellId(Grid, GridCellX, GridCellY);
+    u32* StoredIndex = PushStruct(&GridCell->IndexArena, u32);
+    *StoredIndex = EntityId;
+
+    Result = GridCell->NumIndices++;
+
+    return Result;
+}
+
+inline void GridClear(grid* Grid)
+{
+    if (Grid->Layout == GridLayout_Compact)
+    {
+        // NOTE: Cell ranges get fully rewritten by the next build
+        return;
+    }
+    
+    for (u32 CellId = 0; CellId < Grid->NumCellsX * Grid->NumCellsY; ++CellId)
+    {
+        grid_cell* Cell = Grid->Cells + CellId;
+        Cell->NumIndices = 0;
+        ArenaClear(&Cell->IndexArena);
+    }
+}
+
+//
+// NOTE: Parallel Grid Build
+//
+
+/*
+
+  NOTE: GridAddEntity pushes one bird at a time into a shared block arena so it can't run on multiple threads. The parallel
+        build is a counting sort instead:
+
+        1) Every chunk of birds computes its cell ids 4 at a time and counts them into its own histogram
+        2) The histograms are prefix summed in (cell, chunk) order which gives every chunk its first slot in every cell. This
+           is also where the compact layout gets its CellStart/CellCount, and where block arena cells reserve all of their
+           storage up front since the block arena isn't thread safe
+        3) Every chunk scatters its birds into their final slots
+
+        Chunks cover increasing bird ranges so birds end up in the same order within a cell as with GridAddEntity.
+  
+ */
+
+struct grid_build_job
+{
+    grid* Grid;
+    bird_array BirdArray;
+    u32 NumBirds;
+    u32 NumChunks;
+    u32* BirdCellIds;
+
+    // NOTE: NumChunks x NumCells, holds counts after the histogram pass and write slots after the prefix sum. For the compact
+    // layout the slots index Grid->Indices, for block arenas they are relative to the start of the cell
+    u32* ChunkCellCounts;
+};
+
+inline void GridBuildGetChunkRange(grid_build_job* Job, u32 ChunkId, u32* Start, u32* End)
+{
+    // NOTE: Keep chunk starts a multiple of 4 so the SIMD pass never straddles chunks
+    u32 NumPackets = (Job->NumBirds + 3) / 4;
+    *Start = Min(Job->NumBirds, 4 * u32(u64(NumPackets) * ChunkId / Job->NumChunks));
+    *End = Min(Job->NumBirds, 4 * u32(u64(NumPackets) * (ChunkId + 1) / Job->NumChunks));
+}
+
+inline void GridBuildHistogram(void* Data, u32 ThreadId, u32 ChunkId)
+{
+    grid_build_job* Job = (grid_build_job*)Data;
+    grid* Grid = Job->Grid;
+    u32 NumCells = GridGetNumCells(Grid);
+    u32* CellCounts = Job->ChunkCellCounts + ChunkId * NumCells;
+    for (u32 CellId = 0; CellId < NumCells; ++CellId)
+    {
+        CellCounts[CellId] = 0;
+    }
+
+    u32 StartBirdId = 0;
+    u32 EndBirdId = 0;
+    GridBuildGetChunkRange(Job, ChunkId, &StartBirdId, &EndBirdId);
+
+    v2 GridMin = Grid->WorldBounds.Min;
+    v2 GridDim = AabbGetDim(Grid->WorldBounds);
+    for (u32 BirdId = StartBirdId; BirdId < EndBirdId; BirdId += 4)
+    {
+        // NOTE: Bird arrays are padded by 4 so the last packet can always be loaded
+        v2_x4 Pos = V2X4LoadUnAligned(Job->BirdArray.PosX + BirdId, Job->BirdArray.PosY + BirdId);
+        v2_x4 ReMappedPos = (Pos - GridMin) / GridDim;
+        v1u_x4 CellX = FloorV1UX4(Clamp(ReMappedPos.x * f32(Grid->NumCellsX), V1X4(0.0f), V1X4(f32(Grid->NumCellsX - 1))));
+        v1u_x4 CellY = FloorV1UX4(Clamp(ReMappedPos.y * f32(Grid->NumCellsY), V1X4(0.0f), V1X4(f32(Grid->NumCellsY - 1))));
+        if (Grid->CellOrder == GridCellOrder_Hashed)
+        {
+            // NOTE: Hashed cells aren't clamped, the floor keeps the sign and GridGetCellId wraps them
+            CellX = FloorV1UX4(ReMappedPos.x * f32(Grid->NumCellsX));
+            CellY = FloorV1UX4(ReMappedPos.y * f32(Grid->NumCellsY));
+        }
+        // NOTE: 3D layers are stacked as extra rows
+        v1_x4 RowId = V1X4(CellY);
+        if (Grid->NumCellsZ > 1)
+        {
+            v1_x4 PosZ = V1X4LoadUnAligned(Job->BirdArray.PosZ + BirdId);
+            v1_x4 ReMappedZ = (PosZ - V1X4(Grid->WorldMinZ)) / V1X4(Grid->WorldMaxZ - Grid->WorldMinZ);
+            v1u_x4 CellZ = FloorV1UX4(Clamp(ReMappedZ * f32(Grid->NumCellsZ), V1X4(0.0f), V1X4(f32(Grid->NumCellsZ - 1))));
+            RowId = V1X4(CellZ) * f32(Grid->NumCellsY) + RowId;
+        }
+        
+        // NOTE: Done in float since there is no 32bit int multiply pre SSE4, exact for < 2^24 cells
+        v1u_x4 CellId = FloorV1UX4(RowId * f32(Grid->NumCellsX) + V1X4(CellX));
+
+        u32 NumValid = Min(4u, EndBirdId - BirdId);
+        for (u32 LaneId = 0; LaneId < NumValid; ++LaneId)
+        {
+            u32 LaneCellId = CellId.e[LaneId];
+            if (Grid->CellOrder != GridCellOrder_RowMajor)
+            {
+                LaneCellId = GridGetCellId(Grid, CellX.e[LaneId], CellY.e[LaneId]);
+            }
+
+            Job->BirdCellIds[BirdId + LaneId] = LaneCellId;
+            CellCounts[LaneCellId] += 1;
+        }
+    }
+}
+
+inline void GridBuildScatter(void* Data, u32 ThreadId, u32 ChunkId)
+{
+    grid_build_job* Job = (grid_build_job*)Data;
+    grid* Grid = Job->Grid;
+    u32 NumCells = GridGetNumCells(Grid);
+    u32* CellSlots = Job->ChunkCellCounts + ChunkId * NumCells;
+
+    u32 StartBirdId = 0;
+    u32 EndBirdId = 0;
+    GridBuildGetChunkRange(Job, ChunkId, &StartBirdId, &EndBirdId);
+    for (u32 BirdId = StartBirdId; BirdId < EndBirdId; ++BirdId)
+    {
+        u32 CellId = Job->BirdCellIds[BirdId];
+        u32 SlotId = CellSlots[CellId]++;
+        if (Grid->Layout == GridLayout_Compact)
+        {
+            Grid->Indices[SlotId] = BirdId;
+            Grid->IndexCellIds[SlotId] = CellId;
+            continue;
+        }
+        
+        // NOTE: Cells almost always fit in one block so this rarely walks
+        block* CurrBlock = Grid->Cells[CellId].IndexArena.Next;
+        while (SlotId >= Grid->MaxNumIndicesPerBlock)
+        {
+            CurrBlock = CurrBlock->Next;
+            SlotId -= Grid->MaxNumIndicesPerBlock;
+        }
+        BlockGetData(CurrBlock, u32)[SlotId] = BirdId;
+    }
+}
+
+inline void GridBuild(grid* Grid, job_system* JobSystem, linear_arena* TempArena, bird_array BirdArray, u32 NumBirds, u32 NumChunks)
+{
+    u32 NumCells = GridGetNumCells(Grid);
+
+    grid_build_job Job = {};
+    Job.Grid = Grid;
+    Job.BirdArray = BirdArray;
+    Job.NumBirds = NumBirds;
+    Job.NumChunks = NumChunks;
+    Job.BirdCellIds = PushArray(TempArena, u32, NumBirds);
+    Job.ChunkCellCounts = PushArray(TempArena, u32, Job.NumChunks * NumCells);
+
+    JobSystemParallelFor(JobSystem, Job.NumChunks, GridBuildHistogram, &Job);
+
+    // NOTE: Prefix sum, turns each chunk's count into its first slot in the cell
+    u32 NumIndicesBefore = 0;
+    for (u32 CellId = 0; CellId < NumCells; ++CellId)
+    {
+        u32 SlotOffset = Grid->Layout == GridLayout_Compact ? NumIndicesBefore : 0;
+        u32 NumIndices = 0;
+        for (u32 ChunkId = 0; ChunkId < Job.NumChunks; ++ChunkId)
+        {
+            u32* ChunkCount = Job.ChunkCellCounts + ChunkId * NumCells + CellId;
+            u32 Count = *ChunkCount;
+            *ChunkCount = SlotOffset + NumIndices;
+            NumIndices += Count;
+        }
+
+        if (Grid->Layout == GridLayout_Compact)
+        {
+            Grid->CellStart[CellId] = NumIndicesBefore;
+            Grid->CellCount[CellId] = NumIndices;
+        }
+        else
+        {
+            grid_cell* Cell = Grid->Cells + CellId;
+            Cell->NumIndices = NumIndices;
+            for (u32 NumReserved = 0; NumReserved < NumIndices; )
+            {
+                u32 NumToReserve = Min(NumIndices - NumReserved, Grid->MaxNumIndicesPerBlock);
+                PushArray(&Cell->IndexArena, u32, NumToReserve);
+                NumReserved += NumToReserve;
+            }
+        }
+
+        NumIndicesBefore += NumIndices;
+    }
+
+    JobSystemParallelFor(JobSystem, Job.NumChunks, GridBuildScatter, &Job);
+
+    if (Grid->Layout == GridLayout_Compact)
+    {
+        Grid->BuiltNumCellsX = Grid->NumCellsX;
+        Grid->BuiltNumCellsY = Grid->NumCellsY;
+        Grid->BuiltWorldBounds = Grid->WorldBounds;
+        Grid->BuiltCellOrder = Grid->CellOrder;
+    }
+}
+
+//
+// NOTE: Bird Reordering
+//
+
+/*
+
+  NOTE: The update writes birds out in cell order but they move before the next grid build, so neighbour scans and packet
+        loads still go through Grid->Indices into scattered memory. With ReorderBirds we gather the SoA arrays into the
+        order of Grid->Indices right after the build, after which cell i holds birds [CellStart[i], CellStart[i] + CellCount[i])
+        and every access is a contiguous load. BirdIds tracks which original bird sits in each slot.
+  
+ */
+
+#define SIM_REORDER_CHUNK_SIZE 4096
+
+struct sim_reorder_job
+{
+    u32* Indices;
+    u32 NumBirds;
+    bird_array SrcBirds;
+    bird_array DstBirds;
+    u32* SrcBirdIds;
+    u32* DstBirdIds;
+};
+
+inline void SimReorderBirdsChunk(void* Data, u32 ThreadId, u32 ChunkId)
+{
+    sim_reorder_job* Job = (sim_reorder_job*)Data;
+
+    u32 StartId = ChunkId * SIM_REORDER_CHUNK_SIZE;
+    u32 EndId = Min(StartId + SIM_REORDER_CHUNK_SIZE, Job->NumBirds);
+    for (u32 DstId = StartId; DstId < EndId; ++DstId)
+    {
+        u32 SrcId = Job->Indices[DstId];
+        Job->DstBirds.PosX[DstId] = Job->SrcBirds.PosX[SrcId];
+        Job->DstBirds.PosY[DstId] = Job->SrcBirds.PosY[SrcId];
+        Job->DstBirds.VelX[DstId] = Job->SrcBirds.VelX[SrcId];
+        Job->DstBirds.VelY[DstId] = Job->SrcBirds.VelY[SrcId];
+        if (Job->SrcBirds.PosZ)
+        {
+            Job->DstBirds.PosZ[DstId] = Job->SrcBirds.PosZ[SrcId];
+            Job->DstBirds.VelZ[DstId] = Job->SrcBirds.VelZ[SrcId];
+        }
+        if (Job->SrcBirds.Species)
+        {
+            Job->DstBirds.Species[DstId] = Job->SrcBirds.Species[SrcId];
+        }
+        Job->DstBirdIds[DstId] = Job->SrcBirdIds[SrcId];
+    }
+}
+
+inline void SimReorderBirds(sim_state* Sim, bird_array SrcBirds, bird_array DstBirds)
+{
+    sim_reorder_job Job = {};
+    Job.Indices = Sim->Grid.Indices;
+    Job.NumBirds = Sim->NumBirds;
+    Job.SrcBirds = SrcBirds;
+    Job.DstBirds = DstBirds;
+    Job.SrcBirdIds = Sim->BirdIds;
+    Job.DstBirdIds = Sim->ScratchBirdIds;
+
+    u32 NumChunks = (Sim->NumBirds + SIM_REORDER_CHUNK_SIZE - 1) / SIM_REORDER_CHUNK_SIZE;
+    JobSystemParallelFor(Sim->JobSystem, NumChunks, SimReorderBirdsChunk, &Job);
+
+    u32* Temp = Sim->BirdIds;
+    Sim->BirdIds = Sim->ScratchBirdIds;
+    Sim->ScratchBirdIds = Temp;
+}
+
+//
+// NOTE: Species Sort
+//
+
+/*
+
+  NOTE: Birds of one species share all their radii and weights, so a packet that only holds one species loads each of them
+        once instead of gathering them per lane. The grid build leaves the birds of a cell in any order, so we sort each
+        cell's indices by species right after it, and the reorder (or the update when birds aren't reordered) carves packets
+        out of cells in that order. Only full builds sort, birds that the incremental update moves land anywhere in their new
+        cell until the next full build, which only costs gathers.
+  
+ */
+
+#define SIM_SPECIES_SORT_CELLS_PER_CHUNK 256
+
+struct sim_species_sort_job
+{
+    grid* Grid;
+    u32* Species;
+    u32 NumSpecies;
+    u32 NumCells;
+};
+
+inline void SimSortCellsBySpeciesChunk(void* Data, u32 ThreadId, u32 ChunkId)
+{
+    sim_species_sort_job* Job = (sim_species_sort_job*)Data;
+    grid* Grid = Job->Grid;
+
+    u32 StartCellId = ChunkId * SIM_SPECIES_SORT_CELLS_PER_CHUNK;
+    u32 EndCellId = Min(StartCellId + SIM_SPECIES_SORT_CELLS_PER_CHUNK, Job->NumCells);
+    for (u32 CellId = StartCellId; CellId < EndCellId; ++CellId)
+    {
+        u32* Indices = Grid->Indices + Grid->CellStart[CellId];
+        u32 NumIndices = Grid->CellCount[CellId];
+        if (NumIndices < 2)
+        {
+            continue;
+        }
+        
+        u32 SpeciesCounts[SIM_MAX_SPECIES] = {};
+        for (u32 IndexId = 0; IndexId < NumIndices; ++IndexId)
+        {
+            SpeciesCounts[Job->Species[Indices[IndexId]]] += 1;
+        }
+
+        // NOTE: In place bucket sort, every swap puts at least one index into its species' range
+        u32 NextIndexId[SIM_MAX_SPECIES];
+        u32 OnePastEndIndexId[SIM_MAX_SPECIES];
+        u32 CurrOffset = 0;
+        for (u32 SpeciesId = 0; SpeciesId < Job->NumSpecies; ++SpeciesId)
+        {
+            NextIndexId[SpeciesId] = CurrOffset;
+            CurrOffset += SpeciesCounts[SpeciesId];
+            OnePastEndIndexId[SpeciesId] = CurrOffset;
+        }
+
+        for (u32 SpeciesId = 0; SpeciesId < Job->NumSpecies; ++SpeciesId)
+        {
+            while (NextIndexId[SpeciesId] < OnePastEndIndexId[SpeciesId])
+            {
+                u32 Index = Indices[NextIndexId[SpeciesId]];
+                u32 IndexSpecies = Job->Species[Index];
+                if (IndexSpecies == SpeciesId)
+                {
+                    NextIndexId[SpeciesId] += 1;
+                    continue;
+                }
+                
+                u32 DstIndexId = NextIndexId[IndexSpecies]++;
+                Indices[NextIndexId[SpeciesId]] = Indices[DstIndexId];
+                Indices[DstIndexId] = Index;
+            }
+        }
+    }
+}
+
+inline void SimSortCellsBySpecies(sim_state* Sim, bird_array Birds)
+{
+    // NOTE: Needs the compact grid that was just built from Birds
+    sim_species_sort_job Job = {};
+    Job.Grid = &Sim->Grid;
+    Job.Species = Birds.Species;
+    Job.NumSpecies = Sim->SpeciesTable.NumSpecies;
+    Job.NumCells = GridGetNumCells(&Sim->Grid);
+
+    u32 NumChunks = (Job.NumCells + SIM_SPECIES_SORT_CELLS_PER_CHUNK - 1) / SIM_SPECIES_SORT_CELLS_PER_CHUNK;
+    JobSystemParallelFor(Sim->JobSystem, NumChunks, SimSortCellsBySpeciesChunk, &Job);
+}
+
+//
+// NOTE: Incremental Grid Update
+//
+
+/*
+
+  NOTE: Birds move a small fraction of a cell per step so only a few of them change cells. Once birds are in cell order,
+        the cell ranges of the last step still describe the bird slots at the start of the next one. So instead of
+        rebuilding the grid and gathering every bird we:
+
+        1) Compare the cell the update computed for every slot's new position (Grid->NextCellIds) against the cell it is
+           stored in (Grid->IndexCellIds) and collect the birds that changed cells
+        2) Move only those birds between the cell counts and prefix sum the new cell starts, O(moved + cells)
+        3) Merge the birds that stayed with the movers sorted by their new cell
+
+        Step 3 still touches every bird since one bird changing cells shifts all slots between its old and new cell. The
+        merge has to branch on every mover, so with ~6% of birds changing cells per step (default radius and dt) it ends up
+        about as fast as the build's scatter plus the reorder's gather, which are close to streaming on a flock that was
+        in cell order last step. It only wins when few birds change cells, and nothing is copied when none did. So it's
+        off by default.
+  
+ */
+
+#define SIM_INCREMENTAL_GRID_CHUNK_SIZE 4096
+#define SIM_INCREMENTAL_GRID_CELLS_PER_CHUNK 256
+#define SIM_INCREMENTAL_GRID_MOVED 0xFFFFFFFF
+
+struct sim_incremental_grid_job
+{
+    grid* Grid;
+    u32 NumBirds;
+    u32 NumCells;
+    bird_array SrcBirds;
+    bird_array DstBirds;
+    u32* SrcBirdIds;
+    u32* DstBirdIds;
+
+    // NOTE: Every chunk collects its movers starting at its first slot
+    u32* Movers;
+    u32* MoverCellIds;
+    u32* ChunkNumMovers;
+
+    // NOTE: Cell ranges at the start of the step, Grid->CellStart/CellCount get the new ones. Cell c gains
+    //       SortedMovers[EnteredStart[c], EnteredStart[c + 1])
+    u32* OldCellStart;
+    u32* OldCellCount;
+    u32* EnteredStart;
+    u32* SortedMovers;
+    u32* SortedMoverCellIds;
+};
+
+inline void SimFindGridMoversChunk(void* Data, u32 ThreadId, u32 ChunkId)
+{
+    sim_incremental_grid_job* Job = (sim_incremental_grid_job*)Data;
+    grid* Grid = Job->Grid;
+
+    u32 StartSlotId = ChunkId * SIM_INCREMENTAL_GRID_CHUNK_SIZE;
+    u32 EndSlotId = Min(StartSlotId + SIM_INCREMENTAL_GRID_CHUNK_SIZE, Job->NumBirds);
+    u32 NumMovers = 0;
+    for (u32 SlotId = StartSlotId; SlotId < EndSlotId; SlotId += 4)
+    {
+        // NOTE: Both arrays are padded by 4 so the last packet can always be loaded
+        v1u_x4 NewCellId = V1UX4LoadUnAligned(Grid->NextCellIds + SlotId);
+        v1u_x4 OldCellId = V1UX4LoadUnAligned(Grid->IndexCellIds + SlotId);
+
+        u32 NumValid = Min(4u, EndSlotId - SlotId);
+        u32 ValidMask = (1u << NumValid) - 1;
+        if ((MoveMask(NewCellId == OldCellId) & ValidMask) == ValidMask)
+        {
+            continue;
+        }
+        
+        for (u32 LaneId = 0; LaneId < NumValid; ++LaneId)
+        {
+            if (NewCellId.e[LaneId] != OldCellId.e[LaneId])
+            {
+                Job->Movers[StartSlotId + NumMovers] = SlotId + LaneId;
+                Job->MoverCellIds[StartSlotId + NumMovers] = NewCellId.e[LaneId];
+                Grid->NextCellIds[SlotId + LaneId] = SIM_INCREMENTAL_GRID_MOVED;
+                NumMovers += 1;
+            }
+        }
+    }
+    Job->ChunkNumMovers[ChunkId] = NumMovers;
+}
+
+inline void SimCopyGridBird(sim_incremental_grid_job* Job, u32 SrcId, u32 DstId, u32 CellId)
+{
+    Job->DstBirds.PosX[DstId] = Job->SrcBirds.PosX[SrcId];
+    Job->DstBirds.PosY[DstId] = Job->SrcBirds.PosY[SrcId];
+    Job->DstBirds.VelX[DstId] = Job->SrcBirds.VelX[SrcId];
+    Job->DstBirds.VelY[DstId] = Job->SrcBirds.VelY[SrcId];
+    if (Job->SrcBirds.Species)
+    {
+        Job->DstBirds.Species[DstId] = Job->SrcBirds.Species[SrcId];
+    }
+    Job->DstBirdIds[DstId] = Job->SrcBirdIds[SrcId];
+    Job->Grid->IndexCellIds[DstId] = CellId;
+}
+
+inline void SimMergeGridMoversChunk(void* Data, u32 ThreadId, u32 ChunkId)
+{
+    // NOTE: Local copy so the compiler doesn't reload every array pointer after each store
+    sim_incremental_grid_job LocalJob = *(sim_incremental_grid_job*)Data;
+    sim_incremental_grid_job* Job = &LocalJob;
+    grid* Grid = Job->Grid;
+
+    // NOTE: Cells are in increasing order in both the old slots and the sorted movers, order within a cell doesn't matter
+    //       (movers land among birds of other species, the species order comes back with the next full build)
+    u32 StartCellId = ChunkId * SIM_INCREMENTAL_GRID_CELLS_PER_CHUNK;
+    u32 EndCellId = Min(StartCellId + SIM_INCREMENTAL_GRID_CELLS_PER_CHUNK, Job->NumCells);
+    u32 StartSlotId = Job->OldCellStart[StartCellId];
+    u32 EndSlotId = Job->OldCellStart[EndCellId - 1] + Job->OldCellCount[EndCellId - 1];
+    u32 MoverId = Job->EnteredStart[StartCellId];
+    u32 EndMoverId = Job->EnteredStart[EndCellId];
+    u32 DstId = Grid->CellStart[StartCellId];
+    for (u32 SlotId = StartSlotId; SlotId < EndSlotId; ++SlotId)
+    {
+        u32 CellId = Grid->NextCellIds[SlotId];
+        if (CellId == SIM_INCREMENTAL_GRID_MOVED)
+        {
+            continue;
+        }
+
+        while (MoverId < EndMoverId && Job->SortedMoverCellIds[MoverId] <= CellId)
+        {
+            SimCopyGridBird(Job, Job->SortedMovers[MoverId], DstId++, Job->SortedMoverCellIds[MoverId]);
+            MoverId += 1;
+        }
+        SimCopyGridBird(Job, SlotId, DstId++, CellId);
+    }
+    
+    for (; MoverId < EndMoverId; ++MoverId)
+    {
+        SimCopyGridBird(Job, Job->SortedMovers[MoverId], DstId++, Job->SortedMoverCellIds[MoverId]);
+    }
+    Assert(DstId == Grid->CellStart[EndCellId - 1] + Grid->CellCount[EndCellId - 1]);
+}
+
+inline b32 SimCanUpdateGridIncremental(sim_state* Sim)
+{
+    grid* Grid = &Sim->Grid;
+    b32 Result = (Sim->IncrementalGrid && Sim->BirdsInCellOrder && Sim->ReorderBirds && Grid->Layout == GridLayout_Compact &&
+                  Grid->NextCellIdsValid && Grid->BuiltNumCellsX == Grid->NumCellsX && Grid->BuiltNumCellsY == Grid->NumCellsY &&
+                  Grid->BuiltCellOrder == Grid->CellOrder && Grid->BuiltWorldBounds.Min.x == Grid->WorldBounds.Min.x &&
+                  Grid->BuiltWorldBounds.Min.y == Grid->WorldBounds.Min.y && Grid->BuiltWorldBounds.Max.x == Grid->WorldBounds.Max.x &&
+                  Grid->BuiltWorldBounds.Max.y == Grid->WorldBounds.Max.y);
+    return Result;
+}
+
+inline b32 SimUpdateGridIncremental(sim_state* Sim, bird_array SrcBirds, bird_array DstBirds)
+{
+    // NOTE: Returns false if no bird changed cells, SrcBirds are then still in cell order and DstBirds weren't touched
+    grid* Grid = &Sim->Grid;
+    linear_arena* TempArena = &Sim->TempArena;
+    
+    sim_incremental_grid_job Job = {};
+    Job.Grid = Grid;
+    Job.NumBirds = Sim->NumBirds;
+    Job.NumCells = Grid->NumCellsX * Grid->NumCellsY;
+    Job.SrcBirds = SrcBirds;
+    Job.DstBirds = DstBirds;
+    Job.SrcBirdIds = Sim->BirdIds;
+    Job.DstBirdIds = Sim->ScratchBirdIds;
+
+    u32 NumChunks = (Sim->NumBirds + SIM_INCREMENTAL_GRID_CHUNK_SIZE - 1) / SIM_INCREMENTAL_GRID_CHUNK_SIZE;
+    Job.Movers = PushArray(TempArena, u32, Sim->NumBirds);
+    Job.MoverCellIds = PushArray(TempArena, u32, Sim->NumBirds);
+    Job.ChunkNumMovers = PushArray(TempArena, u32, NumChunks);
+    JobSystemParallelFor(Sim->JobSystem, NumChunks, SimFindGridMoversChunk, &Job);
+
+    u32 NumMovers = 0;
+    for (u32 ChunkId = 0; ChunkId < NumChunks; ++ChunkId)
+    {
+        NumMovers += Job.ChunkNumMovers[ChunkId];
+    }
+    if (NumMovers == 0)
+    {
+        return false;
+    }
+
+    Job.OldCellStart = PushArray(TempArena, u32, Job.NumCells);
+    Job.OldCellCount = PushArray(TempArena, u32, Job.NumCells);
+    Job.EnteredStart = PushArray(TempArena, u32, Job.NumCells + 1);
+    Job.SortedMovers = PushArray(TempArena, u32, NumMovers);
+    Job.SortedMoverCellIds = PushArray(TempArena, u32, NumMovers);
+    memcpy(Job.OldCellStart, Grid->CellStart, sizeof(u32) * Job.NumCells);
+    memcpy(Job.OldCellCount, Grid->CellCount, sizeof(u32) * Job.NumCells);
+    memset(Job.EnteredStart, 0, sizeof(u32) * (Job.NumCells + 1));
+
+    // NOTE: Move the movers between the cell counts, EnteredStart holds the number of birds entering each cell for now
+    for (u32 ChunkId = 0; ChunkId < NumChunks; ++ChunkId)
+    {
+        u32 FirstMoverId = ChunkId * SIM_INCREMENTAL_GRID_CHUNK_SIZE;
+        for (u32 MoverId = FirstMoverId; MoverId < FirstMoverId + Job.ChunkNumMovers[ChunkId]; ++MoverId)
+        {
+            Grid->CellCount[Grid->IndexCellIds[Job.Movers[MoverId]]] -= 1;
+            Grid->CellCount[Job.MoverCellIds[MoverId]] += 1;
+            Job.EnteredStart[Job.MoverCellIds[MoverId]] += 1;
+        }
+    }
+
+    u32 NumBirdsBefore = 0;
+    u32 NumMoversBefore = 0;
+    for (u32 CellId = 0; CellId < Job.NumCells; ++CellId)
+    {
+        Grid->CellStart[CellId] = NumBirdsBefore;
+        NumBirdsBefore += Grid->CellCount[CellId];
+
+        u32 NumEntered = Job.EnteredStart[CellId];
+        Job.EnteredStart[CellId] = NumMoversBefore;
+        NumMoversBefore += NumEntered;
+    }
+    Job.EnteredStart[Job.NumCells] = NumMoversBefore;
+
+    // NOTE: Counting sort of the movers by their new cell
+    u32* WriteIds = PushArray(TempArena, u32, Job.NumCells);
+    memcpy(WriteIds, Job.EnteredStart, sizeof(u32) * Job.NumCells);
+    for (u32 ChunkId = 0; ChunkId < NumChunks; ++ChunkId)
+    {
+        u32 FirstMoverId = ChunkId * SIM_INCREMENTAL_GRID_CHUNK_SIZE;
+        for (u32 MoverId = FirstMoverId; MoverId < FirstMoverId + Job.ChunkNumMovers[ChunkId]; ++MoverId)
+        {
+            u32 WriteId = WriteIds[Job.MoverCellIds[MoverId]]++;
+            Job.SortedMovers[WriteId] = Job.Movers[MoverId];
+            Job.SortedMoverCellIds[WriteId] = Job.MoverCellIds[MoverId];
+        }
+    }
+
+    u32 NumCellChunks = (Job.NumCells + SIM_INCREMENTAL_GRID_CELLS_PER_CHUNK - 1) / SIM_INCREMENTAL_GRID_CELLS_PER_CHUNK;
+    JobSystemParallelFor(Sim->JobSystem, NumCellChunks, SimMergeGridMoversChunk, &Job);
+
+    u32* Temp = Sim->BirdIds;
+    Sim->BirdIds = Sim->ScratchBirdIds;
+    Sim->ScratchBirdIds = Temp;
+    
+    return true;
+}
+
+//
+// NOTE: Cell Sums
+//
+
+/*
+
+  NOTE: Cell culling accepts cells that are inside the bird radius and either outside or inside the avoid radius for a
+        whole packet. Every bird in such a cell adds the same position and velocity to every lane (and the avoidance is
+        NumBirds * BirdPosition minus the summed positions), so we sum each cell once per step and accepted cells cost
+        O(1) no matter how many birds they hold. Culling splits a row into more scans, so rows with fewer than
+        SIM_CULL_MIN_ROW_BIRDS birds are cheaper to scan whole.
+  
+ */
+
+#define SIM_CELL_SUM_CHUNK_SIZE 4096
+#define SIM_CULL_MIN_ROW_BIRDS 64
+
+struct sim_cell_sum_job
+{
+    grid* Grid;
+    bird_array Birds;
+    u32 NumCells;
+};
+
+inline void SimSumCellsChunk(void* Data, u32 ThreadId, u32 ChunkId)
+{
+    sim_cell_sum_job* Job = (sim_cell_sum_job*)Data;
+    grid* Grid = Job->Grid;
+
+    u32 StartCellId = ChunkId * SIM_CELL_SUM_CHUNK_SIZE;
+    u32 EndCellId = Min(StartCellId + SIM_CELL_SUM_CHUNK_SIZE, Job->NumCells);
+    for (u32 CellId = StartCellId; CellId < EndCellId; ++CellId)
+    {
+        grid_cell_sum Sum = {};
+        u32 StartBirdId = Grid->CellStart[CellId];
+        u32 EndBirdId = StartBirdId + Grid->CellCount[CellId];
+        for (u32 BirdId = StartBirdId; BirdId < EndBirdId; ++BirdId)
+        {
+            Sum.PosX += Job->Birds.PosX[BirdId];
+            Sum.PosY += Job->Birds.PosY[BirdId];
+            Sum.VelX += Job->Birds.VelX[BirdId];
+            Sum.VelY += Job->Birds.VelY[BirdId];
+        }
+        Grid->CellSums[CellId] = Sum;
+    }
+}
+
+inline void SimSumCells(sim_state* Sim, bird_array Birds)
+{
+    // NOTE: Birds have to be in cell order
+    sim_cell_sum_job Job = {};
+    Job.Grid = &Sim->Grid;
+    Job.Birds = Birds;
+    Job.NumCells = Sim->Grid.NumCellsX * Sim->Grid.NumCellsY;
+    Job.Grid->CellSums = PushArray(&Sim->TempArena, grid_cell_sum, Job.NumCells);
+
+    u32 NumChunks = (Job.NumCells + SIM_CELL_SUM_CHUNK_SIZE - 1) / SIM_CELL_SUM_CHUNK_SIZE;
+    JobSystemParallelFor(Sim->JobSystem, NumChunks, SimSumCellsChunk, &Job);
+}
+
+//
+// NOTE: Far Field
+//
+
+/*
+
+  NOTE: With large radii a packet's neighbourhood covers a lot of cells, and most of them are completely inside the bird
+        radius. Cell culling can add those up per row, but it needs cells small enough to fit in the radius, and then a
+        row of them has to be summed cell by cell. The far field instead treats the Morton grid as a quadtree: every
+        aligned 2^L x 2^L block of cells is a node, and its birds are one contiguous range of slots. We sum every level once
+        per step. The query walks the tree and adds a node's sums when the whole node is inside the bird radius and
+        on one side of the avoid radius for every lane. It drops nodes outside the radius and only tests birds one by one
+        in the leaf cells along the edges of the radii, so the result is the same as testing every bird.
+
+        The edges get thinner with smaller cells, so the far field sizes cells to a fraction of the radius. Cells then
+        hold only a few birds, so packets are taken from a whole tile of cells instead of one cell at a time.
+  
+ */
+
+// NOTE: Measured at 100k birds with a radius of 1, finer cells let more nodes be accepted but the traversal cost
+// grows faster than the scans shrink past 4 cells per radius
+#define SIM_FAR_FIELD_CELLS_PER_RADIUS 4
+#define SIM_FAR_FIELD_MAX_LEAF_BIRDS 32
+#define SIM_FAR_FIELD_EDGE 1e18f
+
+inline void SimBuildNodeSums(sim_state* Sim)
+{
+    // NOTE: Needs CellSums in Morton order, the 4 children of node i are nodes 4i..4i+3 of the level below
+    grid* Grid = &Sim->Grid;
+    Grid->NumNodeLevels = 1;
+    Grid->NodeSums[0] = Grid->CellSums;
+    u32 NumNodes = Grid->NumCellsX * Grid->NumCellsY;
+    while (NumNodes > 1)
+    {
+        grid_cell_sum* Children = Grid->NodeSums[Grid->NumNodeLevels - 1];
+        NumNodes /= 4;
+        grid_cell_sum* Nodes = PushArray(&Sim->TempArena, grid_cell_sum, NumNodes);
+        for (u32 NodeId = 0; NodeId < NumNodes; ++NodeId)
+        {
+            grid_cell_sum Sum = {};
+            for (u32 ChildId = 4 * NodeId; ChildId < 4 * NodeId + 4; ++ChildId)
+            {
+                Sum.PosX += Children[ChildId].PosX;
+                Sum.PosY += Children[ChildId].PosY;
+                Sum.VelX += Children[ChildId].VelX;
+                Sum.VelY += Children[ChildId].VelY;
+            }
+            Nodes[NodeId] = Sum;
+        }
+
+        Grid->NodeSums[Grid->NumNodeLevels] = Nodes;
+        Grid->NumNodeLevels += 1;
+    }
+}
+
+//
+// NOTE: Adaptive Grid
+//
+
+/*
+
+  NOTE: After a few hundred steps the birds gather into a few dense flocks. Most cells are then empty, while the cells
+        under a flock hold hundreds of birds and every bird in them scans its whole 3x3 neighbourhood. Smaller cells
+        everywhere would make the sparse parts walk a lot of empty cells, so we only split the crowded cells. Their birds
+        get sorted into GRID_SPLIT_DIM x GRID_SPLIT_DIM sub cells with a sum per sub cell. A query treats every sub cell
+        like a far field node: it skips sub cells outside the radii, adds the sums of the ones inside the bird radius and
+        on one side of the avoid radius, and only tests the rest bird by bird. The sort also keeps the packets taken from a
+        crowded cell close together, so more sub cells pass or fail for every lane at once.
+
+        Sorting only moves birds between the slots of their own cell, so cell ranges, cell sums and the incremental
+        update's cell id per slot stay valid.
+  
+ */
+
+// NOTE: Cells with fewer birds are cheaper to scan than to split
+#define SIM_ADAPTIVE_MAX_CELL_BIRDS 64
+#define SIM_ADAPTIVE_EDGE 1e18f
+
+struct sim_split_cells_job
+{
+    grid* Grid;
+    bird_array Birds;
+    bird_array ScratchBirds;
+    u32* BirdIds;
+    u32* ScratchBirdIds;
+    u32* SplitCellX;
+    u32* SplitCellY;
+};
+
+inline u32 SimGetSubCellId(v2 Pos, v2 CellMin, v2 InvSubCellDim)
+{
+    // NOTE: Birds that rounded into the cell from a neighbour or that are outside the world get clamped into the edge sub cells
+    u32 SubX = u32(Clamp((Pos.x - CellMin.x) * InvSubCellDim.x, 0.0f, f32(GRID_SPLIT_DIM - 1)));
+    u32 SubY = u32(Clamp((Pos.y - CellMin.y) * InvSubCellDim.y, 0.0f, f32(GRID_SPLIT_DIM - 1)));
+    u32 Result = SubY * GRID_SPLIT_DIM + SubX;
+    return Result;
+}
+
+inline void SimSplitCell(void* Data, u32 ThreadId, u32 SplitId)
+{
+    sim_split_cells_job* Job = (sim_split_cells_job*)Data;
+    grid* Grid = Job->Grid;
+    grid_cell_split* Split = Grid->CellSplits + SplitId;
+    
+    u32 CellX = Job->SplitCellX[SplitId];
+    u32 CellY = Job->SplitCellY[SplitId];
+    u32 CellId = GridGetCellId(Grid, CellX, CellY);
+    u32 StartBirdId = Grid->CellStart[CellId];
+    u32 EndBirdId = StartBirdId + Grid->CellCount[CellId];
+
+    v2 CellDim = AabbGetDim(Grid->WorldBounds) / V2(Grid->NumCellsX, Grid->NumCellsY);
+    v2 CellMin = Grid->WorldBounds.Min + V2(f32(CellX), f32(CellY)) * CellDim;
+    v2 InvSubCellDim = V2(f32(GRID_SPLIT_DIM)) / CellDim;
+
+    u32 SubCellCounts[GRID_SPLIT_NUM_CELLS] = {};
+    for (u32 BirdId = StartBirdId; BirdId < EndBirdId; ++BirdId)
+    {
+        v2 Pos = V2(Job->Birds.PosX[BirdId], Job->Birds.PosY[BirdId]);
+        SubCellCounts[SimGetSubCellId(Pos, CellMin, InvSubCellDim)] += 1;
+    }
+
+    u32 SubCellOffsets[GRID_SPLIT_NUM_CELLS];
+    u32 CurrOffset = 0;
+    for (u32 SubCellId = 0; SubCellId < GRID_SPLIT_NUM_CELLS; ++SubCellId)
+    {
+        Split->SubCellStart[SubCellId] = CurrOffset;
+        SubCellOffsets[SubCellId] = StartBirdId + CurrOffset;
+        Split->SubCellSums[SubCellId] = {};
+        CurrOffset += SubCellCounts[SubCellId];
+    }
+    Split->SubCellStart[GRID_SPLIT_NUM_CELLS] = CurrOffset;
+
+    // NOTE: Scatter into the same slots of the scratch arrays and copy back, no other cell uses them
+    for (u32 SrcId = StartBirdId; SrcId < EndBirdId; ++SrcId)
+    {
+        v2 Pos = V2(Job->Birds.PosX[SrcId], Job->Birds.PosY[SrcId]);
+        v2 Vel = V2(Job->Birds.VelX[SrcId], Job->Birds.VelY[SrcId]);
+        u32 SubCellId = SimGetSubCellId(Pos, CellMin, InvSubCellDim);
+        u32 DstId = SubCellOffsets[SubCellId]++;
+        Job->ScratchBirds.PosX[DstId] = Pos.x;
+        Job->ScratchBirds.PosY[DstId] = Pos.y;
+        Job->ScratchBirds.VelX[DstId] = Vel.x;
+        Job->ScratchBirds.VelY[DstId] = Vel.y;
+        Job->ScratchBirdIds[DstId] = Job->BirdIds[SrcId];
+
+        grid_cell_sum* Sum = Split->SubCellSums + SubCellId;
+        Sum->PosX += Pos.x;
+        Sum->PosY += Pos.y;
+        Sum->VelX += Vel.x;
+        Sum->VelY += Vel.y;
+    }
+
+    u32 NumBirds = EndBirdId - StartBirdId;
+    memcpy(Job->Birds.PosX + StartBirdId, Job->ScratchBirds.PosX + StartBirdId, sizeof(f32) * NumBirds);
+    memcpy(Job->Birds.PosY + StartBirdId, Job->ScratchBirds.PosY + StartBirdId, sizeof(f32) * NumBirds);
+    memcpy(Job->Birds.VelX + StartBirdId, Job->ScratchBirds.VelX + StartBirdId, sizeof(f32) * NumBirds);
+    memcpy(Job->Birds.VelY + StartBirdId, Job->ScratchBirds.VelY + StartBirdId, sizeof(f32) * NumBirds);
+    memcpy(Job->BirdIds + StartBirdId, Job->ScratchBirdIds + StartBirdId, sizeof(u32) * NumBirds);
+}
+
+inline void SimSplitCells(sim_state* Sim, bird_array Birds, bird_array ScratchBirds)
+{
+    // NOTE: Birds have to be in cell order, ScratchBirds can be overwritten
+    grid* Grid = &Sim->Grid;
+    u32 NumCells = Grid->NumCellsX * Grid->NumCellsY;
+    u32 MaxNumSplits = Sim->NumBirds / (SIM_ADAPTIVE_MAX_CELL_BIRDS + 1);
+    
+    sim_split_cells_job Job = {};
+    Job.Grid = Grid;
+    Job.Birds = Birds;
+    Job.ScratchBirds = ScratchBirds;
+    Job.BirdIds = Sim->BirdIds;
+    Job.ScratchBirdIds = Sim->ScratchBirdIds;
+    Job.SplitCellX = PushArray(&Sim->TempArena, u32, MaxNumSplits);
+    Job.SplitCellY = PushArray(&Sim->TempArena, u32, MaxNumSplits);
+    Grid->CellSplitIds = PushArray(&Sim->TempArena, u32, NumCells);
+    Grid->CellSplits = PushArray(&Sim->TempArena, grid_cell_split, MaxNumSplits);
+
+    u32 NumSplits = 0;
+    for (u32 CellY = 0; CellY < Grid->NumCellsY; ++CellY)
+    {
+        for (u32 CellX = 0; CellX < Grid->NumCellsX; ++CellX)
+        {
+            u32 CellId = GridGetCellId(Grid, CellX, CellY);
+            Grid->CellSplitIds[CellId] = GRID_CELL_NOT_SPLIT;
+            if (Grid->CellCount[CellId] > SIM_ADAPTIVE_MAX_CELL_BIRDS)
+            {
+                Grid->CellSplitIds[CellId] = NumSplits;
+                Job.SplitCellX[NumSplits] = CellX;
+                Job.SplitCellY[NumSplits] = CellY;
+                NumSplits += 1;
+            }
+        }
+    }
+
+    if (NumSplits == 0)
+    {
+        // NOTE: Queries take the plain path when nothing got split
+        Grid->CellSplitIds = 0;
+        Grid->CellSplits = 0;
+        return;
+    }
+    
+    JobSystemParallelFor(Sim->JobSystem, NumSplits, SimSplitCell, &Job);
+}
+
+//
+// NOTE: Quantised Search
+//
+
+/*
+
+  NOTE: The neighbour search reads a position and a velocity for every candidate, but it only needs them to about the
+        precision of a distance test. With QuantisedSearch we pack both into 16 bits per axis once per step, so a candidate
+        is 8 bytes instead of 16 and the distance test is a 16 bit subtract and a multiply add on ints. The sums are kept as
+        ints relative to the query bird and only turned back into floats once per scanned range.
+
+        Positions are fixed point over the world bounds plus a margin on every side, birds outside of it get clamped onto
+        it. Both axes share one scale so that distances stay isotropic. The 16 bit differences are only exact while birds
+        in a scanned range are less than half the fixed point range apart, which SimCanUseQuantisedSearch checks.
+  
+ */
+
+#define SIM_QUANTISE_CHUNK_SIZE 4096
+#define SIM_QUANTISE_MAX_POS 65535.0f
+#define SIM_QUANTISE_MAX_DIFF 32767.0f
+// NOTE: Velocities are clamped to MaxSpeed, so this leaves 2x headroom
+#define SIM_QUANTISE_MAX_VEL 16383.0f
+
+struct sim_quantise_job
+{
+    bird_array Birds;
+    bird_search_array* Search;
+    u32 NumBirds;
+};
+
+inline aabb2 SimGetQuantisedBounds(grid* Grid)
+{
+    v2 Dim = AabbGetDim(Grid->WorldBounds);
+    f32 Margin = 0.25f * Max(Dim.x, Dim.y);
+    v2 Center = 0.5f * (Grid->WorldBounds.Min + Grid->WorldBounds.Max);
+    aabb2 Result = AabbCenterRadius(Center, V2(0.5f * Max(Dim.x, Dim.y) + Margin));
+    return Result;
+}
+
+inline b32 SimCanUseQuantisedSearch(sim_state* Sim)
+{
+    // NOTE: A scanned range holds birds up to a radius plus a cell from the query, edge cells also hold the birds in the margin
+    grid* Grid = &Sim->Grid;
+    aabb2 Bounds = SimGetQuantisedBounds(Grid);
+    f32 PosScale = AabbGetDim(Bounds).x / SIM_QUANTISE_MAX_POS;
+    v2 CellDim = AabbGetDim(Grid->WorldBounds) / V2(Grid->NumCellsX, Grid->NumCellsY);
+    f32 MaxRadius = SquareRoot(Max(Sim->BirdRadiusSq, Sim->AvoidRadiusSq));
+    v2 Margin = Grid->WorldBounds.Min - Bounds.Min;
+    f32 MaxDiff = MaxRadius + Max(CellDim.x, CellDim.y) + Max(Margin.x, Margin.y);
+    
+    // NOTE: Fixed point positions only cover the world plus the margin, birds past that would get clamped
+    b32 Bounded = !Sim->UnboundedWorld && Grid->CellOrder != GridCellOrder_Hashed;
+    b32 Result = (Sim->QuantisedSearch && Sim->BirdsInCellOrder && !Sim->UseNeighbourLists && !Sim->UseHalfStencil && Bounded &&
+                  !(Sim->ActiveRules & (SimRule_FieldOfView | SimRule_Species)) && MaxDiff < SIM_QUANTISE_MAX_DIFF * PosScale);
+    return Result;
+}
+
+inline void SimQuantiseBirdsChunk(void* Data, u32 ThreadId, u32 ChunkId)
+{
+    sim_quantise_job* Job = (sim_quantise_job*)Data;
+    bird_search_array* Search = Job->Search;
+
+    u32 StartBirdId = ChunkId * SIM_QUANTISE_CHUNK_SIZE;
+    u32 EndBirdId = Min(StartBirdId + SIM_QUANTISE_CHUNK_SIZE, Job->NumBirds);
+    f32 InvVelScale = 1.0f / Search->VelScale;
+    for (u32 BirdId = StartBirdId; BirdId < EndBirdId; ++BirdId)
+    {
+        // NOTE: Has to match SIM_LANE(QuantiseQuery) in the kernel
+        f32 PosX = Clamp((Job->Birds.PosX[BirdId] - Search->PosMin.x) * Search->InvPosScale + 0.5f, 0.0f, SIM_QUANTISE_MAX_POS);
+        f32 PosY = Clamp((Job->Birds.PosY[BirdId] - Search->PosMin.y) * Search->InvPosScale + 0.5f, 0.0f, SIM_QUANTISE_MAX_POS);
+        Search->Pos[BirdId] = u32(FloorI32(PosX)) | (u32(FloorI32(PosY)) << 16);
+
+        i32 VelX = FloorI32(Job->Birds.VelX[BirdId] * InvVelScale + 0.5f);
+        i32 VelY = FloorI32(Job->Birds.VelY[BirdId] * InvVelScale + 0.5f);
+        Search->Vel[BirdId] = (u32(VelX) & 0xFFFF) | (u32(VelY) << 16);
+    }
+}
+
+inline void SimQuantiseBirds(sim_state* Sim, bird_array Birds)
+{
+    // NOTE: Birds have to be in cell order
+    bird_search_array* Search = &Sim->SearchBirds;
+    aabb2 Bounds = SimGetQuantisedBounds(&Sim->Grid);
+    Search->Pos = PushArray(&Sim->TempArena, u32, Sim->NumBirds + SIM_MAX_LANE_WIDTH);
+    Search->Vel = PushArray(&Sim->TempArena, u32, Sim->NumBirds + SIM_MAX_LANE_WIDTH);
+    Search->PosMin = Bounds.Min;
+    Search->PosScale = AabbGetDim(Bounds).x / SIM_QUANTISE_MAX_POS;
+    Search->InvPosScale = 1.0f / Search->PosScale;
+    Search->VelScale = Sim->MaxSpeed / SIM_QUANTISE_MAX_VEL;
+    Search->BirdRadiusSq = u32(Sim->BirdRadiusSq * Square(Search->InvPosScale));
+    Search->AvoidRadiusSq = u32(Sim->AvoidRadiusSq * Square(Search->InvPosScale));
+
+    sim_quantise_job Job = {};
+    Job.Birds = Birds;
+    Job.Search = Search;
+    Job.NumBirds = Sim->NumBirds;
+    
+    u32 NumChunks = (Sim->NumBirds + SIM_QUANTISE_CHUNK_SIZE - 1) / SIM_QUANTISE_CHUNK_SIZE;
+    JobSystemParallelFor(Sim->JobSystem, NumChunks, SimQuantiseBirdsChunk, &Job);
+}
+
+//
+// NOTE: Half Stencil
+//
+
+/*
+
+  NOTE: The full stencil tests every pair twice, once from each bird. With HalfStencil each row of cells is walked in
+        packets of birds, and a packet only tests the birds after it in its own row and the birds in the rows below it.
+        Every pair is then tested exactly once and adds to both birds: the flock sums are symmetric and the avoidance is
+        antisymmetric. A packet's neighbours live in other tiles, so every thread scatters into its own accumulators and the
+        update adds the threads together per bird.
+
+        Packets that end a row get their empty lanes moved far away, on opposite sides for the packet and its neighbours, so
+        the pair loops don't need any valid masks.
+  
+ */
+
+#define SIM_ACCUMULATOR_CLEAR_CHUNK_SIZE 4096
+#define SIM_HALF_STENCIL_FAR_AWAY 1e18f
+
+struct sim_half_stencil_job
+{
+    sim_state* Sim;
+    bird_array Birds;
+    // NOTE: How many cells away a neighbour in range can be
+    u32 ReachX;
+    u32 ReachY;
+};
+
+inline void SimClearAccumulatorsChunk(void* Data, u32 ThreadId, u32 ChunkId)
+{
+    sim_state* Sim = (sim_state*)Data;
+
+    // NOTE: Includes the padding since full packets add into it
+    u32 PaddedNumBirds = Sim->NumBirds + SIM_MAX_LANE_WIDTH;
+    u32 StartId = ChunkId * SIM_ACCUMULATOR_CLEAR_CHUNK_SIZE;
+    u32 NumToClear = Min(u32(SIM_ACCUMULATOR_CLEAR_CHUNK_SIZE), PaddedNumBirds - StartId);
+    for (u32 AccumulatorId = 0; AccumulatorId < Sim->JobSystem->NumThreads; ++AccumulatorId)
+    {
+        bird_accumulator_array* Accumulators = Sim->ThreadAccumulators + AccumulatorId;
+        memset(Accumulators->NumBirdsInRadius + StartId, 0, sizeof(f32) * NumToClear);
+        memset(Accumulators->FlockDirX + StartId, 0, sizeof(f32) * NumToClear);
+        memset(Accumulators->FlockDirY + StartId, 0, sizeof(f32) * NumToClear);
+        memset(Accumulators->FlockPosX + StartId, 0, sizeof(f32) * NumToClear);
+        memset(Accumulators->FlockPosY + StartId, 0, sizeof(f32) * NumToClear);
+        memset(Accumulators->AvoidanceX + StartId, 0, sizeof(f32) * NumToClear);
+        memset(Accumulators->AvoidanceY + StartId, 0, sizeof(f32) * NumToClear);
+    }
+}
+
+//
+// NOTE: Neighbour Lists
+//
+
+/*
+
+  NOTE: Birds move a small fraction of a cell per step, so with NeighbourLists we query the grid with the radius plus a skin
+        and keep every bird's candidates in a list. A pair that is in range now was within radius + skin at the last build as
+        long as neither bird moved more than half the skin since, so until then the steps skip the grid build and reorder and
+        only scan the lists. Birds keep their slots between builds which lets the lists store slot ids.
+
+        The lists are per packet of LaneWidth birds rather than per bird, holding every bird in range of any lane. The scan
+        then broadcasts one neighbour to every lane like the grid does, without gathers, and the build only has to test if
+        any lane is in range. Every chunk of birds gets SIM_NEIGHBOUR_LIST_ENTRIES_PER_BIRD entries per bird, if a chunk's
+        lists don't fit we fall back to the grid for SIM_NEIGHBOUR_LIST_RETRY_STEPS steps.
+  
+ */
+
+// NOTE: A multiple of every lane width so no packet straddles two chunks
+#define SIM_NEIGHBOUR_LIST_CHUNK_SIZE 4096
+// NOTE: Dense flocks overflow this, but that's also where the grid's cell culling beats scanning long lists
+#define SIM_NEIGHBOUR_LIST_ENTRIES_PER_BIRD 64
+#define SIM_NEIGHBOUR_LIST_RETRY_STEPS 32
+
+struct sim_neighbour_list_job
+{
+    sim_state* Sim;
+    bird_array Birds;
+    f32 ListRadius;
+    b32* ChunkOverflowed;
+};
+
+//
+// NOTE: Predators and Attractors
+//
+
+/*
+
+  NOTE: A brute force loop over every predator per bird costs NumBirds x NumPredators tests, which is far too much for
+        thousands of predators. They get a coarse grid of their own instead, with cells as wide as the larger of the two
+        influence radii, so a packet only tests the predators and attractors of the few cells around it. Each one is
+        broadcast against the whole packet like a neighbour, and since there are only a few per packet the grid is simply
+        rebuilt every step after the predators moved.
+  
+ */
+
+// NOTE: Cells are at least as wide as the larger influence radius, so this only limits tiny radii
+#define SIM_INFLUENCER_MAX_CELLS_PER_AXIS 64
+
+inline f32 SimGetInfluenceRadius(sim_state* Sim)
+{
+    f32 MaxRadiusSq = Sim->NumPredators ? Sim->PredatorRadiusSq : 0.0f;
+    if (Sim->NumAttractors)
+    {
+        MaxRadiusSq = Max(MaxRadiusSq, Sim->AttractorRadiusSq);
+    }
+    f32 Result = SquareRoot(MaxRadiusSq);
+    return Result;
+}
+
+inline void SimUpdateInfluencers(sim_state* Sim, f32 FrameTime)
+{
+    // NOTE: Predators and the coarse grid live inside the walls, birds that can leave them would all query the edge cells
+    Assert(!Sim->UnboundedWorld && Sim->Grid.CellOrder != GridCellOrder_Hashed);
+    bird_array* Influencers = &Sim->Influencers;
+    for (u32 PredatorId = 0; PredatorId < Sim->NumPredators; ++PredatorId)
+    {
+        v2 Pos = V2(Influencers->PosX[PredatorId], Influencers->PosY[PredatorId]);
+        v2 Vel = V2(Influencers->VelX[PredatorId], Influencers->VelY[PredatorId]);
+        Pos += Vel * FrameTime;
+
+        // NOTE: Bounce off the walls
+        if (Abs(Pos.x) > Sim->TerrainRadius)
+        {
+            Pos.x = Clamp(Pos.x, -Sim->TerrainRadius, Sim->TerrainRadius);
+            Vel.x = -Vel.x;
+        }
+        if (Abs(Pos.y) > Sim->TerrainRadius)
+        {
+            Pos.y = Clamp(Pos.y, -Sim->TerrainRadius, Sim->TerrainRadius);
+            Vel.y = -Vel.y;
+        }
+
+        Influencers->PosX[PredatorId] = Pos.x;
+        Influencers->PosY[PredatorId] = Pos.y;
+        Influencers->VelX[PredatorId] = Vel.x;
+        Influencers->VelY[PredatorId] = Vel.y;
+    }
+
+    // NOTE: The terrain radius is a UI slider, so the grid follows the walls every step
+    grid* Grid = &Sim->InfluencerGrid;
+    Grid->WorldBounds = AabbCenterRadius(V2(0), V2(Sim->TerrainRadius));
+    f32 MaxRadius = SimGetInfluenceRadius(Sim);
+    v2 WorldDim = AabbGetDim(Grid->WorldBounds);
+    u32 NumCellsX = Grid->MaxNumCellsX;
+    u32 NumCellsY = Grid->MaxNumCellsY;
+    if (MaxRadius > 0.0f)
+    {
+        NumCellsX = Max(1u, u32(Min(WorldDim.x / MaxRadius, f32(Grid->MaxNumCellsX))));
+        NumCellsY = Max(1u, u32(Min(WorldDim.y / MaxRadius, f32(Grid->MaxNumCellsY))));
+    }
+    GridResize(Grid, NumCellsX, NumCellsY);
+
+    // NOTE: Only a few thousand points, so a single chunk
+    temp_mem TempMem = BeginTempMem(&Sim->InfluencerTempArena);
+    GridBuild(Grid, Sim->JobSystem, &Sim->InfluencerTempArena, Sim->Influencers, Sim->NumPredators + Sim->NumAttractors, 1);
+    EndTempMem(TempMem);
+}
+
+//
+// NOTE: Bird Update
+//
+
+struct sim_update_birds_job
+{
+    sim_state* Sim;
+    bird_array PrevBirdArray;
+    bird_array CurrBirdArray;
+    u32* CellOffsets;
+    u32 CellsPerTile;
+    f32 FrameTime;
+
+    // NOTE: Only used with neighbour lists, which update chunks of SIM_NEIGHBOUR_LIST_CHUNK_SIZE birds instead of tiles
+    f32* ChunkMaxDisplacementSq;
+};
+
+//
+// NOTE: Rule Kernels
+//
+
+/*
+
+  NOTE: The neighbour loops are templates on a mask of sim_rule flags, and SIM_DISPATCH_RULES calls the instantiation for the
+        rules that are on. With a constant mask the compiler drops the tests, accumulators and loads of the rules that are
+        off, e.g. separation only flocks never load a neighbour's velocity or count the birds in the flock radius. The switch
+        runs once per scanned range so its branch is free next to the loop. Paths that sum cells ahead of time (half stencil,
+        accepted cell sums, the quantised search) keep accumulating everything, the unused sums just go unread.
+
+        SimRule_FieldOfView adds the blind spot test to the same loops. The paths that sum cells ahead of time can't tell which
+        birds a lane sees, and the half stencil relies on pairs seeing each other, so SimStep turns them all off while it's on.
+        SimRule_Species does the same for the species test and the per species radii, and also turns off the neighbour lists,
+        which are built for the global radii.
+  
+ */
+
+#define SIM_DISPATCH_RULES_CASES(Base, Function, Args)                                  \
+        case (Base): break;                                                             \
+        case (Base) + 1: Function<(Base) + 1> Args; break;                              \
+        case (Base) + 2: Function<(Base) + 2> Args; break;                              \
+        case (Base) + 3: Function<(Base) + 3> Args; break;                              \
+        case (Base) + 4: Function<(Base) + 4> Args; break;                              \
+        case (Base) + 5: Function<(Base) + 5> Args; break;                              \
+        case (Base) + 6: Function<(Base) + 6> Args; break;                              \
+        case (Base) + 7: Function<(Base) + 7> Args; break;
+
+// NOTE: Covers every mask of the five flags, the modifiers without any rule (every Base) have nothing to accumulate
+#define SIM_DISPATCH_RULES(Rules, Function, Args)                                       \
+    switch (Rules)                                                                      \
+    {                                                                                   \
+        SIM_DISPATCH_RULES_CASES(0, Function, Args)                                     \
+        SIM_DISPATCH_RULES_CASES(SimRule_FieldOfView, Function, Args)                   \
+        SIM_DISPATCH_RULES_CASES(SimRule_Species, Function, Args)                       \
+        SIM_DISPATCH_RULES_CASES(SimRule_FieldOfView | SimRule_Species, Function, Args) \
+    }
+
+inline u32 SimGetWeightedRules(f32 MoveToFlockWeight, f32 AlignFlockWeight, f32 AvoidBirdWeight)
+{
+    u32 Result = 0;
+    Result |= MoveToFlockWeight != 0.0f ? SimRule_MoveToFlock : 0;
+    Result |= AlignFlockWeight != 0.0f ? SimRule_AlignFlock : 0;
+    Result |= AvoidBirdWeight != 0.0f ? SimRule_AvoidBirds : 0;
+    return Result;
+}
+
+inline u32 SimGetActiveRules(sim_state* Sim)
+{
+    u32 Result = 0;
+    if (Sim->CurrBirds.Species)
+    {
+        // NOTE: A rule runs if any species weighs it, the species that don't just scale its sums by 0
+        sim_species_table* Table = &Sim->SpeciesTable;
+        for (u32 SpeciesId = 0; SpeciesId < Table->NumSpecies; ++SpeciesId)
+        {
+            Result |= SimGetWeightedRules(Table->MoveToFlockWeight[SpeciesId], Table->AlignFlockWeight[SpeciesId],
+                                          Table->AvoidBirdWeight[SpeciesId]);
+        }
+        Result |= SimRule_Species;
+    }
+    else
+    {
+        Result = SimGetWeightedRules(Sim->MoveToFlockWeight, Sim->AlignFlockWeight, Sim->AvoidBirdWeight);
+    }
+    Result |= ((Result & SimRule_All) && Sim->FovCosHalfAngle > -1.0f) ? SimRule_FieldOfView : 0;
+    return Result;
+}
+
+inline f32 SimGetFovCosSq(sim_state* Sim)
+{
+    // NOTE: Squared but with the sign of the cosine kept, for blind spots smaller than half the circle it's negative
+    f32 Result = Sim->FovCosHalfAngle * Max(Sim->FovCosHalfAngle, -Sim->FovCosHalfAngle);
+    return Result;
+}
+
+inline f32 SimGetRulesRadiusSq(sim_state* Sim, u32 Rules)
+{
+    f32 BirdRadiusSq = Sim->BirdRadiusSq;
+    f32 AvoidRadiusSq = Sim->AvoidRadiusSq;
+    if (Rules & SimRule_Species)
+    {
+        // NOTE: Packets search the largest radius of any species
+        sim_species_table* Table = &Sim->SpeciesTable;
+        BirdRadiusSq = 0.0f;
+        AvoidRadiusSq = 0.0f;
+        for (u32 SpeciesId = 0; SpeciesId < Table->NumSpecies; ++SpeciesId)
+        {
+            BirdRadiusSq = Max(BirdRadiusSq, Table->BirdRadiusSq[SpeciesId]);
+            AvoidRadiusSq = Max(AvoidRadiusSq, Table->AvoidRadiusSq[SpeciesId]);
+        }
+    }
+    
+    f32 Result = 0.0f;
+    if (Rules & (SimRule_MoveToFlock | SimRule_AlignFlock))
+    {
+        Result = Max(Result, BirdRadiusSq);
+    }
+    if (Rules & SimRule_AvoidBirds)
+    {
+        Result = Max(Result, AvoidRadiusSq);
+    }
+    return Result;
+}
+
+inline f32 SimGetSearchRadiusSq(sim_state* Sim)
+{
+    // NOTE: Only the radii of the active rules have to be searched, separation alone only looks at the avoid radius
+    f32 Result = SimGetRulesRadiusSq(Sim, Sim->ActiveRules);
+    return Result;
+}
+
+inline f32 SimGetCellRadiusSq(sim_state* Sim)
+{
+    // NOTE: Cells are sized from every radius even when only some rules are active. Sizing them from the avoid radius alone
+    //       made them so small that separation only flocks spent more time walking cells than testing birds (130x130
+    //       instead of 56x56 at the defaults, about 3x slower at 20k birds)
+    f32 Result = SimGetRulesRadiusSq(Sim, SimRule_All | (Sim->ActiveRules & SimRule_Species));
+    return Result;
+}
+
+//
+// NOTE: Flocking Kernels
+//
+
+/*
+
+  NOTE: SimInit picks the widest kernel the CPU and OS support (SimGetMaxLaneWidth), the 4 wide SSE version is the fallback
+        and the only one that runs on pre AVX2 CPUs.
+  
+ */
+
+#define SIM_LANE_WIDTH 4
+#include "boids_sim_kernel.cpp"
+#undef SIM_LANE_WIDTH
+
+SIM_TARGET_BEGIN_AVX2
+#define SIM_LANE_WIDTH 8
+#include "boids_sim_kernel.cpp"
+#undef SIM_LANE_WIDTH
+SIM_TARGET_END
+
+// NOTE: GCC 12 warns about the _mm512_undefined_ps passthrough inside its own AVX-512 intrinsics
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#endif
+SIM_TARGET_BEGIN_AVX512
+#define SIM_LANE_WIDTH 16
+#include "boids_sim_kernel.cpp"
+#undef SIM_LANE_WIDTH
+SIM_TARGET_END
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+inline void SimCpuId(u32 Leaf, u32 SubLeaf, u32* Regs)
+{
+#if defined(_MSC_VER)
+    __cpuidex((int*)Regs, Leaf, SubLeaf);
+#else
+    __cpuid_count(Leaf, SubLeaf, Regs[0], Regs[1], Regs[2], Regs[3]);
+#endif
+}
+
+inline u64 SimGetXcr0()
+{
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    // NOTE: _xgetbv needs -mxsave on GCC, the raw instruction doesn't
+    u32 Low = 0;
+    u32 High = 0;
+    __asm__ volatile("xgetbv" : "=a"(Low), "=d"(High) : "c"(0));
+    return (u64(High) << 32) | Low;
+#endif
+}
+
+u32 SimGetMaxLaneWidth()
+{
+    u32 Result = 4;
+
+    u32 Regs[4] = {};
+    SimCpuId(0, 0, Regs);
+    u32 MaxLeaf = Regs[0];
+    if (MaxLeaf < 7)
+    {
+        return Result;
+    }
+
+    // NOTE: The CPU supporting AVX isn't enough, the OS also has to save the YMM/ZMM registers (OSXSAVE + XCR0)
+    SimCpuId(1, 0, Regs);
+    b32 OsXSave = (Regs[2] >> 27) & 1;
+    if (!OsXSave)
+    {
+        return Result;
+    }
+
+    u64 Xcr0 = SimGetXcr0();
+    b32 OsSavesYmm = (Xcr0 & 0x6) == 0x6;
+    b32 OsSavesZmm = (Xcr0 & 0xE6) == 0xE6;
+
+    SimCpuId(7, 0, Regs);
+    b32 HasAvx2 = (Regs[1] >> 5) & 1;
+    b32 HasAvx512F = (Regs[1] >> 16) & 1;
+    if (HasAvx2 && OsSavesYmm)
+    {
+        Result = 8;
+    }
+    if (HasAvx512F && OsSavesZmm)
+    {
+        Result = 16;
+    }
+
+    return Result;
+}
+
+//
+// NOTE: Sim Code
+//
+
+void SimSetLaneWidth(sim_state* Sim, u32 LaneWidth)
+{
+    Assert(LaneWidth == 4 || LaneWidth == 8 || LaneWidth == 16);
+    Sim->LaneWidth = LaneWidth;
+
+    // NOTE: SSE has no broadcast from memory so rotating a loaded tile is cheaper than broadcasting every neighbour. With
+    //       AVX the broadcast is a plain load while the cross lane rotations all compete for the shuffle port, which made
+    //       the tiled kernel 15-25% slower at 8 and 16 lanes (100k birds)
+    Sim->TiledNeighbours = LaneWidth == 4;
+}
+
+void SimSetRuleSet(sim_state* Sim, sim_rule_set RuleSet)
+{
+    Sim->RuleSet = RuleSet;
+    if (RuleSet == SimRuleSet_Steering)
+    {
+        // NOTE: Weights of the acceleration model prototype, terrain has to win against the flock
+        Sim->AvoidTerrainWeight = 5.0f;
+        Sim->AvoidBirdWeight = 1.0f;
+        Sim->AlignFlockWeight = 1.0f;
+        Sim->MoveToFlockWeight = 1.0f;
+        Sim->MaxSteerSpeed = 2.0f;
+        Sim->FleePredatorWeight = 3.0f;
+        Sim->SeekAttractorWeight = 0.5f;
+    }
+    else
+    {
+        Sim->AvoidTerrainWeight = 0.14117f;
+        Sim->AvoidBirdWeight = 0.07352f;
+        Sim->AlignFlockWeight = 0.09117f;
+        Sim->MoveToFlockWeight = 0.22352f;
+        Sim->FleePredatorWeight = 0.3f;
+        Sim->SeekAttractorWeight = 0.02f;
+    }
+}
+
+void SimInit(sim_state* Sim, linear_arena* Arena, u32 NumBirds, u32 Seed, u32 NumThreads, u32 MaxCellCountForAxis)
+{
+    *Sim = {};
+    Sim->Random = SimRandomSeriesCreate(Seed);
+
+    Sim->MinSpeed = 1.088f;
+    Sim->MaxSpeed = 1.55f;
+
+    Sim->BirdRadiusSq = 0.138f;
+    Sim->AvoidRadiusSq=  0.02598f;
+    Sim->TerrainAvoidRadius = 0.25292f;
+    Sim->FovCosHalfAngle = -1.0f;
+
+    Sim->TerrainRadius = 10.5f; //10.55f;
+    Sim->PredatorRadiusSq = 1.0f;
+    Sim->AttractorRadiusSq = 4.0f;
+    Sim->PredatorSpeed = 1.2f;
+    Sim->PlatformBlockArena = PlatformBlockArenaCreate(KiloBytes(256), 64);
+    Sim->Grid = GridCreate(Arena, &Sim->PlatformBlockArena, AabbCenterRadius(V2(0), V2(Sim->TerrainRadius)),
+                           MaxCellCountForAxis, MaxCellCountForAxis, NumBirds);
+
+    SimSetRuleSet(Sim, SimRuleSet_VelocityBlend);
+
+    // NOTE: Scratch memory for a single step, the incremental grid update needs up to 4 ids per bird and 4 per cell, the
+    //       quantised search 2 more per bird, the far field node sums up to a third of the cell sums and the adaptive grid one
+    //       id per cell plus a split for every cell that can be crowded
+    u32 NumCells = Sim->Grid.NumCellsX * Sim->Grid.NumCellsY;
+    u32 MaxNumSplits = NumBirds / (SIM_ADAPTIVE_MAX_CELL_BIRDS + 1);
+    Sim->TempArena = LinearSubArena(Arena, sizeof(u32) * (4 * NumBirds + NumCells * (NumThreads + 5)) +
+                                    2 * sizeof(u32) * (NumBirds + SIM_MAX_LANE_WIDTH) +
+                                    sizeof(grid_cell_sum) * (NumCells + NumCells / 2) +
+                                    (sizeof(grid_cell_split) + 2 * sizeof(u32)) * MaxNumSplits + KiloBytes(64));
+    Sim->JobSystem = JobSystemCreate(Arena, NumThreads);
+    Sim->ParallelGridBuild = true;
+    Sim->AutoGridSize = true;
+    SimSetLaneWidth(Sim, SimGetMaxLaneWidth());
+
+    Sim->NumBirds = NumBirds;
+    u32 PaddedNumBirds = Sim->NumBirds + SIM_MAX_LANE_WIDTH;
+    Sim->CurrBirds.PosX = PushArray(Arena, f32, PaddedNumBirds);
+    Sim->CurrBirds.PosY = PushArray(Arena, f32, PaddedNumBirds);
+    Sim->CurrBirds.VelX = PushArray(Arena, f32, PaddedNumBirds);
+    Sim->CurrBirds.VelY = PushArray(Arena, f32, PaddedNumBirds);
+    Sim->PrevBirds.PosX = PushArray(Arena, f32, PaddedNumBirds);
+    Sim->PrevBirds.PosY = PushArray(Arena, f32, PaddedNumBirds);
+    Sim->PrevBirds.VelX = PushArray(Arena, f32, PaddedNumBirds);
+    Sim->PrevBirds.VelY = PushArray(Arena, f32, PaddedNumBirds);
+
+    Sim->ReorderBirds = true;
+    Sim->CellCulling = true;
+    Sim->NeighbourSkin = 0.2f;
+    Sim->BirdIds = PushArray(Arena, u32, PaddedNumBirds);
+    Sim->ScratchBirdIds = PushArray(Arena, u32, PaddedNumBirds);
+    for (u32 BirdId = 0; BirdId < NumBirds; ++BirdId)
+    {
+        Sim->BirdIds[BirdId] = BirdId;
+    }
+
+    for (u32 BirdId = 0; BirdId < Sim->NumBirds; ++BirdId)
+    {
+        f32 RandVel = Lerp(Sim->MinSpeed, Sim->MaxSpeed, RandFloat(&Sim->Random));
+        v2 Pos = 2.0f * V2(RandFloat(&Sim->Random), RandFloat(&Sim->Random)) - V2(1);
+        Pos *= 0.9f * Sim->TerrainRadius;
+        v2 Vel = 0.5f * RandVel * Normalize(2.0f * V2(RandFloat(&Sim->Random), RandFloat(&Sim->Random)) - V2(1));
+
+        Sim->CurrBirds.PosX[BirdId] = Pos.x;
+        Sim->CurrBirds.PosY[BirdId] = Pos.y;
+        Sim->CurrBirds.VelX[BirdId] = Vel.x;
+        Sim->CurrBirds.VelY[BirdId] = Vel.y;
+    }
+}
+
+void SimEnableHalfStencil(sim_state* Sim, linear_arena* Arena)
+{
+    // NOTE: NumThreads full copies of the sums is a lot of memory for big flocks, so only allocate them when asked to
+    if (!Sim->ThreadAccumulators)
+    {
+        u32 NumThreads = Sim->JobSystem->NumThreads;
+        u32 PaddedNumBirds = Sim->NumBirds + SIM_MAX_LANE_WIDTH;
+        Sim->ThreadAccumulators = PushArray(Arena, bird_accumulator_array, NumThreads);
+        for (u32 AccumulatorId = 0; AccumulatorId < NumThreads; ++AccumulatorId)
+        {
+            bird_accumulator_array* Accumulators = Sim->ThreadAccumulators + AccumulatorId;
+            Accumulators->NumBirdsInRadius = PushArray(Arena, f32, PaddedNumBirds);
+            Accumulators->FlockDirX = PushArray(Arena, f32, PaddedNumBirds);
+            Accumulators->FlockDirY = PushArray(Arena, f32, PaddedNumBirds);
+            Accumulators->FlockPosX = PushArray(Arena, f32, PaddedNumBirds);
+            Accumulators->FlockPosY = PushArray(Arena, f32, PaddedNumBirds);
+            Accumulators->AvoidanceX = PushArray(Arena, f32, PaddedNumBirds);
+            Accumulators->AvoidanceY = PushArray(Arena, f32, PaddedNumBirds);
+        }
+    }
+
+    Sim->HalfStencil = true;
+}
+
+void SimEnableNeighbourLists(sim_state* Sim, linear_arena* Arena)
+{
+    neighbour_lists* Lists = &Sim->NeighbourListData;
+    if (!Lists->Entries)
+    {
+        // NOTE: Sized for the widest lanes, narrower ones just use fewer packets
+        u32 PaddedNumBirds = Sim->NumBirds + SIM_MAX_LANE_WIDTH;
+        u32 MaxNumPackets = (Sim->NumBirds + 3) / 4;
+        u32 NumChunks = (Sim->NumBirds + SIM_NEIGHBOUR_LIST_CHUNK_SIZE - 1) / SIM_NEIGHBOUR_LIST_CHUNK_SIZE;
+        Lists->MaxNumEntries = NumChunks * SIM_NEIGHBOUR_LIST_CHUNK_SIZE * SIM_NEIGHBOUR_LIST_ENTRIES_PER_BIRD;
+        Lists->Entries = PushArray(Arena, u32, Lists->MaxNumEntries);
+        Lists->PacketOffsets = PushArray(Arena, u32, MaxNumPackets);
+        Lists->PacketLengths = PushArray(Arena, u32, MaxNumPackets);
+        Lists->BuildPosX = PushArray(Arena, f32, PaddedNumBirds);
+        Lists->BuildPosY = PushArray(Arena, f32, PaddedNumBirds);
+    }
+
+    Sim->NeighbourLists = true;
+}
+
+void SimEnable3d(sim_state* Sim, linear_arena* Arena)
+{
+    // NOTE: 2D flocks don't pay for the Z arrays. The flock gets reseeded in a cube at the same speeds as SimInit
+    if (Sim->Flock3d)
+    {
+        return;
+    }
+
+    u32 PaddedNumBirds = Sim->NumBirds + SIM_MAX_LANE_WIDTH;
+    Sim->CurrBirds.PosZ = PushArray(Arena, f32, PaddedNumBirds);
+    Sim->CurrBirds.VelZ = PushArray(Arena, f32, PaddedNumBirds);
+    Sim->PrevBirds.PosZ = PushArray(Arena, f32, PaddedNumBirds);
+    Sim->PrevBirds.VelZ = PushArray(Arena, f32, PaddedNumBirds);
+    Sim->Grid.WorldMinZ = -Sim->TerrainRadius;
+    Sim->Grid.WorldMaxZ = Sim->TerrainRadius;
+
+    for (u32 BirdId = 0; BirdId < Sim->NumBirds; ++BirdId)
+    {
+        f32 RandVel = Lerp(Sim->MinSpeed, Sim->MaxSpeed, RandFloat(&Sim->Random));
+        v3 Pos = 2.0f * V3(RandFloat(&Sim->Random), RandFloat(&Sim->Random), RandFloat(&Sim->Random)) - V3(1);
+        Pos *= 0.9f * Sim->TerrainRadius;
+        v3 Vel = 0.5f * RandVel * Normalize(2.0f * V3(RandFloat(&Sim->Random), RandFloat(&Sim->Random), RandFloat(&Sim->Random)) -
+                                            V3(1));
+
+        Sim->CurrBirds.PosX[BirdId] = Pos.x;
+        Sim->CurrBirds.PosY[BirdId] = Pos.y;
+        Sim->CurrBirds.PosZ[BirdId] = Pos.z;
+        Sim->CurrBirds.VelX[BirdId] = Vel.x;
+        Sim->CurrBirds.VelY[BirdId] = Vel.y;
+        Sim->CurrBirds.VelZ[BirdId] = Vel.z;
+    }
+
+    Sim->Flock3d = true;
+}
+
+void SimEnableSpecies(sim_state* Sim, linear_arena* Arena, u32 NumSpecies)
+{
+    // NOTE: Birds get a random species each, and the species table starts from the current globals. The species spread from
+    //       small fast birds in tight flocks to large slow ones that keep more distance
+    Assert(NumSpecies > 0 && NumSpecies <= SIM_MAX_SPECIES);
+    if (!Sim->CurrBirds.Species)
+    {
+        u32 PaddedNumBirds = Sim->NumBirds + SIM_MAX_LANE_WIDTH;
+        Sim->CurrBirds.Species = PushArray(Arena, u32, PaddedNumBirds);
+        Sim->PrevBirds.Species = PushArray(Arena, u32, PaddedNumBirds);
+        for (u32 BirdId = 0; BirdId < PaddedNumBirds; ++BirdId)
+        {
+            Sim->CurrBirds.Species[BirdId] = 0;
+            Sim->PrevBirds.Species[BirdId] = 0;
+        }
+    }
+
+    for (u32 BirdId = 0; BirdId < Sim->NumBirds; ++BirdId)
+    {
+        Sim->CurrBirds.Species[BirdId] = RandU32(&Sim->Random) % NumSpecies;
+    }
+
+    sim_species_table* Table = &Sim->SpeciesTable;
+    Table->NumSpecies = NumSpecies;
+    for (u32 SpeciesId = 0; SpeciesId < NumSpecies; ++SpeciesId)
+    {
+        f32 t = NumSpecies > 1 ? f32(SpeciesId) / f32(NumSpecies - 1) : 0.5f;
+        f32 RadiusScale = Lerp(0.75f, 1.25f, t);
+        f32 SpeedScale = Lerp(1.2f, 0.8f, t);
+        Table->MinSpeed[SpeciesId] = SpeedScale * Sim->MinSpeed;
+        Table->MaxSpeed[SpeciesId] = SpeedScale * Sim->MaxSpeed;
+        Table->BirdRadiusSq[SpeciesId] = Square(RadiusScale) * Sim->BirdRadiusSq;
+        Table->AvoidRadiusSq[SpeciesId] = Square(RadiusScale) * Sim->AvoidRadiusSq;
+        Table->AvoidBirdWeight[SpeciesId] = Sim->AvoidBirdWeight;
+        Table->AlignFlockWeight[SpeciesId] = Lerp(1.25f, 0.75f, t) * Sim->AlignFlockWeight;
+        Table->MoveToFlockWeight[SpeciesId] = Lerp(0.75f, 1.25f, t) * Sim->MoveToFlockWeight;
+    }
+}
+
+void SimEnableInfluencers(sim_state* Sim, linear_arena* Arena, u32 NumPredators, u32 NumAttractors)
+{
+    // NOTE: Predators start anywhere with a random heading at PredatorSpeed, attractors get a random spot and no velocity.
+    //       Only 2D flocks inside the walls are influenced
+    Assert(!Sim->Flock3d && !Sim->UnboundedWorld && Sim->Grid.CellOrder != GridCellOrder_Hashed);
+    if (Sim->Influencers.PosX)
+    {
+        return;
+    }
+
+    u32 NumInfluencers = NumPredators + NumAttractors;
+    u32 PaddedNumInfluencers = NumInfluencers + SIM_MAX_LANE_WIDTH;
+    Sim->NumPredators = NumPredators;
+    Sim->NumAttractors = NumAttractors;
+    Sim->Influencers.PosX = PushArray(Arena, f32, PaddedNumInfluencers);
+    Sim->Influencers.PosY = PushArray(Arena, f32, PaddedNumInfluencers);
+    Sim->Influencers.VelX = PushArray(Arena, f32, PaddedNumInfluencers);
+    Sim->Influencers.VelY = PushArray(Arena, f32, PaddedNumInfluencers);
+    for (u32 InfluencerId = 0; InfluencerId < PaddedNumInfluencers; ++InfluencerId)
+    {
+        v2 Pos = {};
+        v2 Vel = {};
+        if (InfluencerId < NumInfluencers)
+        {
+            Pos = 0.9f * Sim->TerrainRadius * (2.0f * V2(RandFloat(&Sim->Random), RandFloat(&Sim->Random)) - V2(1));
+        }
+        if (InfluencerId < NumPredators)
+        {
+            Vel = Sim->PredatorSpeed * Normalize(2.0f * V2(RandFloat(&Sim->Random), RandFloat(&Sim->Random)) - V2(1));
+        }
+
+        Sim->Influencers.PosX[InfluencerId] = Pos.x;
+        Sim->Influencers.PosY[InfluencerId] = Pos.y;
+        Sim->Influencers.VelX[InfluencerId] = Vel.x;
+        Sim->Influencers.VelY[InfluencerId] = Vel.y;
+    }
+
+    u32 MaxNumCells = SIM_INFLUENCER_MAX_CELLS_PER_AXIS * SIM_INFLUENCER_MAX_CELLS_PER_AXIS;
+    Sim->InfluencerGrid = GridCreate(Arena, &Sim->PlatformBlockArena, AabbCenterRadius(V2(0), V2(Sim->TerrainRadius)),
+                                     SIM_INFLUENCER_MAX_CELLS_PER_AXIS, SIM_INFLUENCER_MAX_CELLS_PER_AXIS, NumInfluencers);
+    Sim->InfluencerTempArena = LinearSubArena(Arena, sizeof(u32) * (NumInfluencers + MaxNumCells) + KiloBytes(4));
+}
+
+b32 SimLoadSdf(sim_state* Sim, linear_arena* Arena, void* FileData, u64 FileSize)
+{
+    // NOTE: The file only stores the distances, the gradients are central differences of them (one sided at the border)
+    if (FileSize < sizeof(sim_sdf_file_header))
+    {
+        return false;
+    }
+
+    sim_sdf_file_header* Header = (sim_sdf_file_header*)FileData;
+    u64 NumSamples = u64(Header->Width) * u64(Header->Height);
+    b32 ValidHeader = (Header->Magic == SIM_SDF_FILE_MAGIC && Header->Width >= 2 && Header->Height >= 2 &&
+                       Header->MaxX > Header->MinX && Header->MaxY > Header->MinY &&
+                       FileSize == sizeof(sim_sdf_file_header) + NumSamples * sizeof(f32));
+    if (!ValidHeader)
+    {
+        return false;
+    }
+
+    sim_sdf* Sdf = &Sim->Sdf;
+    *Sdf = {};
+    Sdf->Width = Header->Width;
+    Sdf->Height = Header->Height;
+    Sdf->Min = V2(Header->MinX, Header->MinY);
+    Sdf->Max = V2(Header->MaxX, Header->MaxY);
+    Sdf->InvSampleDim = V2(f32(Sdf->Width - 1), f32(Sdf->Height - 1)) / (Sdf->Max - Sdf->Min);
+    Sdf->Distance = PushArray(Arena, f32, NumSamples);
+    Sdf->GradientX = PushArray(Arena, f32, NumSamples);
+    Sdf->GradientY = PushArray(Arena, f32, NumSamples);
+    memcpy(Sdf->Distance, Header + 1, NumSamples * sizeof(f32));
+
+    for (u32 Y = 0; Y < Sdf->Height; ++Y)
+    {
+        u32 PrevY = Y > 0 ? Y - 1 : Y;
+        u32 NextY = Min(Y + 1, Sdf->Height - 1);
+        for (u32 X = 0; X < Sdf->Width; ++X)
+        {
+            u32 PrevX = X > 0 ? X - 1 : X;
+            u32 NextX = Min(X + 1, Sdf->Width - 1);
+            v2 Gradient = {};
+            Gradient.x = ((Sdf->Distance[Y * Sdf->Width + NextX] - Sdf->Distance[Y * Sdf->Width + PrevX]) *
+                          Sdf->InvSampleDim.x / f32(NextX - PrevX));
+            Gradient.y = ((Sdf->Distance[NextY * Sdf->Width + X] - Sdf->Distance[PrevY * Sdf->Width + X]) *
+                          Sdf->InvSampleDim.y / f32(NextY - PrevY));
+
+            f32 GradientLengthSq = LengthSquared(Gradient);
+            if (GradientLengthSq > 0.0f)
+            {
+                Gradient *= 1.0f / SquareRoot(GradientLengthSq);
+            }
+            Sdf->GradientX[Y * Sdf->Width + X] = Gradient.x;
+            Sdf->GradientY[Y * Sdf->Width + X] = Gradient.y;
+        }
+    }
+
+    return true;
+}
+
+void SimDestroy(sim_state* Sim)
+{
+    JobSystemDestroy(Sim->JobSystem);
+    Sim->JobSystem = 0;
+}
+
+inline void SimAutoSizeGrid(sim_state* Sim)
+{
+    // NOTE: Cells at least as wide as the largest radius keep every bird's query inside a 3x3 cell stencil. Smaller cells
+    //       would scan more cells, larger ones more birds per cell. The radii are UI sliders so this runs every step
+    grid* Grid = &Sim->Grid;
+    f32 MaxRadius = SquareRoot(SimGetCellRadiusSq(Sim));
+    v2 WorldDim = AabbGetDim(Grid->WorldBounds);
+    u32 NumCellsX = Grid->MaxNumCellsX;
+    u32 NumCellsY = Grid->MaxNumCellsY;
+    f32 CellWidth = MaxRadius;
+    if (Sim->FarField && !(Sim->ActiveRules & (SimRule_FieldOfView | SimRule_Species)))
+    {
+        CellWidth /= SIM_FAR_FIELD_CELLS_PER_RADIUS;
+    }
+    if (CellWidth > 0.0f)
+    {
+        // NOTE: Clamp in float, a tiny radius would overflow the u32
+        NumCellsX = Max(1u, u32(Min(WorldDim.x / CellWidth, f32(Grid->MaxNumCellsX))));
+        NumCellsY = Max(1u, u32(Min(WorldDim.y / CellWidth, f32(Grid->MaxNumCellsY))));
+    }
+
+    if (Grid->CellOrder == GridCellOrder_Hashed)
+    {
+        // NOTE: The hashed grid only has to hold the birds rather than the world, about one cell per bird keeps far apart cells
+        //       from sharing a slot. The world bounds become one period of the wrap
+        u32 NumCellsPerAxis = 1;
+        while (NumCellsPerAxis * 2 <= Min(Grid->MaxNumCellsX, Grid->MaxNumCellsY) && NumCellsPerAxis * NumCellsPerAxis < Sim->NumBirds)
+        {
+            NumCellsPerAxis *= 2;
+        }
+        if (CellWidth > 0.0f)
+        {
+            Grid->WorldBounds.Max = Grid->WorldBounds.Min + V2(f32(NumCellsPerAxis) * CellWidth);
+        }
+        GridResize(Grid, NumCellsPerAxis, NumCellsPerAxis);
+        return;
+    }
+
+    if (Grid->CellOrder == GridCellOrder_Morton)
+    {
+        // NOTE: Round down so cells only get larger
+        u32 NumCells = Min(NumCellsX, NumCellsY);
+        u32 PowerOf2 = 1;
+        while (PowerOf2 * 2 <= NumCells)
+        {
+            PowerOf2 *= 2;
+        }
+        NumCellsX = PowerOf2;
+        NumCellsY = PowerOf2;
+    }
+
+    GridResize(Grid, NumCellsX, NumCellsY);
+}
+
+inline void SimAutoSizeGrid3d(sim_state* Sim)
+{
+    // NOTE: Same cell width as in 2D, but the cube of cells has to fit the storage of a MaxNumCellsX x MaxNumCellsY grid
+    grid* Grid = &Sim->Grid;
+    u64 MaxNumCells = u64(Grid->MaxNumCellsX) * u64(Grid->MaxNumCellsY);
+    u32 NumCellsPerAxis = 1;
+    while (u64(NumCellsPerAxis + 1) * u64(NumCellsPerAxis + 1) * u64(NumCellsPerAxis + 1) <= MaxNumCells &&
+           NumCellsPerAxis < Grid->MaxNumCellsX && NumCellsPerAxis < Grid->MaxNumCellsY)
+    {
+        NumCellsPerAxis += 1;
+    }
+
+    f32 MaxRadius = SquareRoot(SimGetCellRadiusSq(Sim));
+    if (Sim->AutoGridSize && MaxRadius > 0.0f)
+    {
+        // NOTE: The world is a cube so one axis sizes all three
+        f32 WorldDim = Grid->WorldMaxZ - Grid->WorldMinZ;
+        NumCellsPerAxis = Max(1u, u32(Min(WorldDim / MaxRadius, f32(NumCellsPerAxis))));
+    }
+
+    GridResize(Grid, NumCellsPerAxis, NumCellsPerAxis);
+    Grid->NumCellsZ = NumCellsPerAxis;
+}
+
+inline void SimStep3d(sim_state* Sim, f32 FrameTime)
+{
+    // NOTE: Same as in 2D, the grid follows the terrain radius slider
+    grid* Grid = &Sim->Grid;
+    Grid->WorldBounds = AabbCenterRadius(V2(0), V2(Sim->TerrainRadius));
+    Grid->WorldMinZ = -Sim->TerrainRadius;
+    Grid->WorldMaxZ = Sim->TerrainRadius;
+    SimAutoSizeGrid3d(Sim);
+    Assert(Grid->Layout == GridLayout_Compact && Grid->CellOrder == GridCellOrder_RowMajor);
+    temp_mem TempMem = BeginTempMem(&Sim->TempArena);
+
+    // NOTE: Last step's output becomes this step's input
+    bird_array PrevBirdArray = Sim->CurrBirds;
+    bird_array CurrBirdArray = Sim->PrevBirds;
+
+    {
+        SIM_TIMED_BLOCK("Generate Grid");
+        u32 NumChunks = Sim->ParallelGridBuild ? Sim->JobSystem->NumThreads : 1;
+        GridBuild(Grid, Sim->JobSystem, &Sim->TempArena, PrevBirdArray, Sim->NumBirds, NumChunks);
+    }
+
+    // NOTE: 3D packets run across whole rows of cells that hold a bird or two, so this mostly helps in crowded cells
+    if (Sim->ActiveRules & SimRule_Species)
+    {
+        SIM_TIMED_BLOCK("Sort Species");
+        SimSortCellsBySpecies(Sim, PrevBirdArray);
+    }
+
+    {
+        SIM_TIMED_BLOCK("Reorder Birds");
+
+        // NOTE: Gather into the scratch array, it then becomes this step's input
+        SimReorderBirds(Sim, PrevBirdArray, CurrBirdArray);
+        bird_array Temp = PrevBirdArray;
+        PrevBirdArray = CurrBirdArray;
+        CurrBirdArray = Temp;
+        Sim->BirdsInCellOrder = true;
+    }
+
+    {
+        SIM_TIMED_BLOCK("Update Birds");
+
+        sim_update_birds_job Job = {};
+        Job.Sim = Sim;
+        Job.PrevBirdArray = PrevBirdArray;
+        Job.CurrBirdArray = CurrBirdArray;
+        Job.CellsPerTile = Grid->NumCellsX;
+        Job.FrameTime = FrameTime;
+
+        job_callback* TileCallback = SimUpdateBirdsTile3d_x4;
+        if (Sim->LaneWidth == 16)
+        {
+            TileCallback = SimUpdateBirdsTile3d_x16;
+        }
+        else if (Sim->LaneWidth == 8)
+        {
+            TileCallback = SimUpdateBirdsTile3d_x8;
+        }
+
+        u32 NumTiles = Grid->NumCellsY * Grid->NumCellsZ;
+        JobSystemParallelFor(Sim->JobSystem, NumTiles, TileCallback, &Job);
+    }
+
+    Sim->PrevBirds = PrevBirdArray;
+    Sim->CurrBirds = CurrBirdArray;
+    Grid->NextCellIdsValid = false;
+    EndTempMem(TempMem);
+}
+
+inline b32 SimNeighbourListsNeedRebuild(sim_state* Sim)
+{
+    neighbour_lists* Lists = &Sim->NeighbourListData;
+    f32 HalfSkin = 0.5f * Sim->NeighbourSkin;
+    b32 Result = (!Lists->Valid || Lists->LaneWidth != Sim->LaneWidth || Lists->BirdRadiusSq != Sim->BirdRadiusSq ||
+                  Lists->AvoidRadiusSq != Sim->AvoidRadiusSq || Lists->Skin != Sim->NeighbourSkin ||
+                  Lists->MaxDisplacementSq > HalfSkin * HalfSkin);
+    return Result;
+}
+
+inline void SimBuildNeighbourLists(sim_state* Sim, bird_array Birds)
+{
+    neighbour_lists* Lists = &Sim->NeighbourListData;
+    Lists->LaneWidth = Sim->LaneWidth;
+    Lists->BirdRadiusSq = Sim->BirdRadiusSq;
+    Lists->AvoidRadiusSq = Sim->AvoidRadiusSq;
+    Lists->Skin = Sim->NeighbourSkin;
+    Lists->MaxDisplacementSq = 0.0f;
+
+    sim_neighbour_list_job Job = {};
+    Job.Sim = Sim;
+    Job.Birds = Birds;
+    Job.ListRadius = SquareRoot(Max(Sim->BirdRadiusSq, Sim->AvoidRadiusSq)) + Sim->NeighbourSkin;
+
+    job_callback* ChunkCallback = BuildNeighbourListsChunk_x4;
+    if (Sim->LaneWidth == 16)
+    {
+        ChunkCallback = BuildNeighbourListsChunk_x16;
+    }
+    else if (Sim->LaneWidth == 8)
+    {
+        ChunkCallback = BuildNeighbourListsChunk_x8;
+    }
+
+    u32 NumChunks = (Sim->NumBirds + SIM_NEIGHBOUR_LIST_CHUNK_SIZE - 1) / SIM_NEIGHBOUR_LIST_CHUNK_SIZE;
+    Job.ChunkOverflowed = PushArray(&Sim->TempArena, b32, NumChunks);
+    for (u32 ChunkId = 0; ChunkId < NumChunks; ++ChunkId)
+    {
+        Job.ChunkOverflowed[ChunkId] = false;
+    }
+    JobSystemParallelFor(Sim->JobSystem, NumChunks, ChunkCallback, &Job);
+
+    Lists->Valid = true;
+    for (u32 ChunkId = 0; ChunkId < NumChunks; ++ChunkId)
+    {
+        Lists->Valid = Lists->Valid && !Job.ChunkOverflowed[ChunkId];
+    }
+}
+
+void SimStep(sim_state* Sim, f32 FrameTime)
+{
+    Sim->ActiveRules = SimGetActiveRules(Sim);
+    Sim->StepSearchPaths = 0;
+    if (Sim->Flock3d)
+    {
+        SimStep3d(Sim, FrameTime);
+        return;
+    }
+
+    grid* Grid = &Sim->Grid;
+
+    // NOTE: While the neighbour lists are valid the grid and the bird order from the last build stay as they are
+    neighbour_lists* Lists = &Sim->NeighbourListData;
+    if (Lists->NumStepsUntilRetry > 0)
+    {
+        Lists->NumStepsUntilRetry -= 1;
+    }
+    Sim->UseNeighbourLists = (Sim->NeighbourLists && Lists->Entries && Sim->ReorderBirds && Grid->Layout == GridLayout_Compact &&
+                              Lists->NumStepsUntilRetry == 0 && !(Sim->ActiveRules & SimRule_Species));
+    b32 RebuildGrid = !Sim->UseNeighbourLists || SimNeighbourListsNeedRebuild(Sim);
+    if (RebuildGrid && !Sim->UnboundedWorld && Grid->CellOrder != GridCellOrder_Hashed)
+    {
+        // NOTE: The terrain radius is a UI slider, so the grid follows the walls. Culling, cell sums and the quantised frame
+        //       assume that every bird lies inside the bounds of its cell
+        Grid->WorldBounds = AabbCenterRadius(V2(0), V2(Sim->TerrainRadius));
+    }
+    if (RebuildGrid && Sim->AutoGridSize)
+    {
+        SimAutoSizeGrid(Sim);
+    }
+    Assert(Grid->CellOrder == GridCellOrder_RowMajor || (Grid->CellOrder == GridCellOrder_Morton && GridSupportsMorton(Grid)) ||
+           (Grid->CellOrder == GridCellOrder_Hashed && GridSupportsHashed(Grid)));
+    temp_mem TempMem = BeginTempMem(&Sim->TempArena);
+
+    // NOTE: Last step's output becomes this step's input
+    bird_array PrevBirdArray = Sim->CurrBirds;
+    bird_array CurrBirdArray = Sim->PrevBirds;
+    Sim->PrevBirds = PrevBirdArray;
+    Sim->CurrBirds = CurrBirdArray;
+
+    // NOTE: Birds are still in the cell order of the last step, only move the ones that changed cells
+    b32 UpdateGridIncremental = RebuildGrid && SimCanUpdateGridIncremental(Sim);
+    if (UpdateGridIncremental)
+    {
+        SIM_TIMED_BLOCK("Update Grid");
+        if (SimUpdateGridIncremental(Sim, PrevBirdArray, CurrBirdArray))
+        {
+            bird_array Temp = PrevBirdArray;
+            PrevBirdArray = CurrBirdArray;
+            CurrBirdArray = Temp;
+            Sim->PrevBirds = PrevBirdArray;
+            Sim->CurrBirds = CurrBirdArray;
+        }
+    }
+    
+    // NOTE: Add all birds to grid data structure
+    if (RebuildGrid && !UpdateGridIncremental)
+    {
+        SIM_TIMED_BLOCK("Generate Grid");
+        if (Sim->ParallelGridBuild || Grid->Layout == GridLayout_Compact)
+        {
+            u32 NumChunks = Sim->ParallelGridBuild ? Sim->JobSystem->NumThreads : 1;
+            GridBuild(Grid, Sim->JobSystem, &Sim->TempArena, PrevBirdArray, Sim->NumBirds, NumChunks);
+        }
+        else
+        {
+            u32* BirdGridIds = PushArray(&Sim->TempArena, u32, Sim->NumBirds);
+            for (u32 BirdId = 0; BirdId < Sim->NumBirds; ++BirdId)
+            {
+                v2 Pos = V2(PrevBirdArray.PosX[BirdId], PrevBirdArray.PosY[BirdId]);
+                BirdGridIds[BirdId] = GridAddEntity(Grid, Pos, BirdId);
+            }
+        }
+    }
+
+    if (RebuildGrid && !UpdateGridIncremental && Grid->Layout == GridLayout_Compact && (Sim->ActiveRules & SimRule_Species))
+    {
+        SIM_TIMED_BLOCK("Sort Species");
+        SimSortCellsBySpecies(Sim, PrevBirdArray);
+    }
+
+    if (RebuildGrid && !UpdateGridIncremental)
+    {
+        Sim->BirdsInCellOrder = Sim->ReorderBirds && Grid->Layout == GridLayout_Compact;
+    }
+    
+    if (RebuildGrid && !UpdateGridIncremental && Sim->BirdsInCellOrder)
+    {
+        SIM_TIMED_BLOCK("Reorder Birds");
+
+        // NOTE: Gather into the scratch array, it then becomes this step's input
+        SimReorderBirds(Sim, PrevBirdArray, CurrBirdArray);
+        bird_array Temp = PrevBirdArray;
+        PrevBirdArray = CurrBirdArray;
+        CurrBirdArray = Temp;
+        Sim->PrevBirds = PrevBirdArray;
+        Sim->CurrBirds = CurrBirdArray;
+    }
+
+    if (RebuildGrid && Sim->UseNeighbourLists)
+    {
+        SIM_TIMED_BLOCK("Build Neighbour Lists");
+        SimBuildNeighbourLists(Sim, PrevBirdArray);
+        
+        // NOTE: Lists that didn't fit fall back to the grid that we just built
+        Sim->UseNeighbourLists = Lists->Valid;
+        if (!Lists->Valid)
+        {
+            Lists->NumStepsUntilRetry = SIM_NEIGHBOUR_LIST_RETRY_STEPS;
+        }
+    }
+
+    // NOTE: A cell can only be accepted if its diagonal fits in the bird radius. Sums and pairs assume that every bird sees all
+    //       around and flocks with every other bird within the same radii
+    v2 CellDim = AabbGetDim(Grid->WorldBounds) / V2(Grid->NumCellsX, Grid->NumCellsY);
+    b32 SameNeighboursForAll = !(Sim->ActiveRules & (SimRule_FieldOfView | SimRule_Species));
+
+    // NOTE: Culling, cell sums, node sums and split cells measure against the bounds of each cell. Birds that left an unbounded
+    //       world get clamped into the border cells of a dense grid and lie far outside them, only the hashed grid wraps them
+    //       into cells that contain them
+    b32 BirdsInsideCells = !Sim->UnboundedWorld || Grid->CellOrder == GridCellOrder_Hashed;
+    Sim->UseCellCulling = Sim->CellCulling && BirdsInsideCells;
+    Sim->UseHalfStencil = (!Sim->UseNeighbourLists && Sim->HalfStencil && Sim->ThreadAccumulators && Sim->BirdsInCellOrder &&
+                           Grid->CellOrder == GridCellOrder_RowMajor && SameNeighboursForAll);
+    Grid->CellSums = 0;
+    if (!Sim->UseNeighbourLists && !Sim->UseHalfStencil && Sim->BirdsInCellOrder && Sim->FarField &&
+        Grid->CellOrder == GridCellOrder_Morton && SameNeighboursForAll && BirdsInsideCells)
+    {
+        SIM_TIMED_BLOCK("Sum Nodes");
+        SimSumCells(Sim, PrevBirdArray);
+        SimBuildNodeSums(Sim);
+    }
+    else if (!Sim->UseNeighbourLists && !Sim->UseHalfStencil && Sim->BirdsInCellOrder && Sim->UseCellCulling &&
+             Grid->CellOrder == GridCellOrder_RowMajor && LengthSquared(CellDim) < Sim->BirdRadiusSq && SameNeighboursForAll)
+    {
+        SIM_TIMED_BLOCK("Sum Cells");
+        SimSumCells(Sim, PrevBirdArray);
+    }
+
+    Grid->CellSplitIds = 0;
+    Grid->CellSplits = 0;
+    if (!Sim->UseNeighbourLists && !Sim->UseHalfStencil && !Grid->NumNodeLevels && Sim->BirdsInCellOrder && Sim->AdaptiveGrid &&
+        Grid->CellOrder != GridCellOrder_Hashed && SameNeighboursForAll && BirdsInsideCells)
+    {
+        SIM_TIMED_BLOCK("Split Cells");
+        SimSplitCells(Sim, PrevBirdArray, CurrBirdArray);
+    }
+
+    Sim->SearchBirds = {};
+    if (SimCanUseQuantisedSearch(Sim))
+    {
+        SIM_TIMED_BLOCK("Quantise Birds");
+        SimQuantiseBirds(Sim, PrevBirdArray);
+    }
+
+    if (Sim->Influencers.PosX)
+    {
+        SIM_TIMED_BLOCK("Update Influencers");
+        SimUpdateInfluencers(Sim, FrameTime);
+    }
+
+    // NOTE: Update birds
+    Sim->WriteNextCellIds = Sim->IncrementalGrid && Sim->BirdsInCellOrder;
+    {
+        SIM_TIMED_BLOCK("Update Birds");
+
+        if (Sim->UseHalfStencil)
+        {
+            SIM_TIMED_BLOCK("Accumulate Pairs");
+
+            u32 PaddedNumBirds = Sim->NumBirds + SIM_MAX_LANE_WIDTH;
+            u32 NumClearChunks = (PaddedNumBirds + SIM_ACCUMULATOR_CLEAR_CHUNK_SIZE - 1) / SIM_ACCUMULATOR_CLEAR_CHUNK_SIZE;
+            JobSystemParallelFor(Sim->JobSystem, NumClearChunks, SimClearAccumulatorsChunk, Sim);
+
+            // NOTE: Rounds the reach up, it only has to cover every pair in range
+            f32 MaxRadius = SquareRoot(Max(Sim->BirdRadiusSq, Sim->AvoidRadiusSq));
+            sim_half_stencil_job Job = {};
+            Job.Sim = Sim;
+            Job.Birds = PrevBirdArray;
+            Job.ReachX = Min(u32(MaxRadius / CellDim.x) + 1, Grid->NumCellsX);
+            Job.ReachY = Min(u32(MaxRadius / CellDim.y) + 1, Grid->NumCellsY);
+
+            job_callback* RowCallback = SimAccumulatePairsRow_x4;
+            if (Sim->LaneWidth == 16)
+            {
+                RowCallback = SimAccumulatePairsRow_x16;
+            }
+            else if (Sim->LaneWidth == 8)
+            {
+                RowCallback = SimAccumulatePairsRow_x8;
+            }
+            JobSystemParallelFor(Sim->JobSystem, Grid->NumCellsY, RowCallback, &Job);
+        }
+
+        if (Sim->UseNeighbourLists)
+        {
+            sim_update_birds_job Job = {};
+            Job.Sim = Sim;
+            Job.PrevBirdArray = PrevBirdArray;
+            Job.CurrBirdArray = CurrBirdArray;
+            Job.FrameTime = FrameTime;
+
+            u32 NumChunks = (Sim->NumBirds + SIM_NEIGHBOUR_LIST_CHUNK_SIZE - 1) / SIM_NEIGHBOUR_LIST_CHUNK_SIZE;
+            Job.ChunkMaxDisplacementSq = PushArray(&Sim->TempArena, f32, NumChunks);
+
+            job_callback* ChunkCallback = SimUpdateBirdsChunk_x4;
+            if (Sim->LaneWidth == 16)
+            {
+                ChunkCallback = SimUpdateBirdsChunk_x16;
+            }
+            else if (Sim->LaneWidth == 8)
+            {
+                ChunkCallback = SimUpdateBirdsChunk_x8;
+            }
+            JobSystemParallelFor(Sim->JobSystem, NumChunks, ChunkCallback, &Job);
+
+            for (u32 ChunkId = 0; ChunkId < NumChunks; ++ChunkId)
+            {
+                Lists->MaxDisplacementSq = Max(Lists->MaxDisplacementSq, Job.ChunkMaxDisplacementSq[ChunkId]);
+            }
+        }
+        else
+        {
+            // NOTE: Each cell writes its birds starting at the prefix sum of the cells before it, so tiles never share output
+            u32 NumCells = Grid->NumCellsX * Grid->NumCellsY;
+            u32* CellOffsets = Grid->CellStart;
+            if (Grid->Layout == GridLayout_BlockArena)
+            {
+                CellOffsets = PushArray(&Sim->TempArena, u32, NumCells);
+                u32 CurrOffset = 0;
+                for (u32 CellId = 0; CellId < NumCells; ++CellId)
+                {
+                    CellOffsets[CellId] = CurrOffset;
+                    CurrOffset += Grid->Cells[CellId].NumIndices;
+                }
+            }
+
+            sim_update_birds_job Job = {};
+            Job.Sim = Sim;
+            Job.PrevBirdArray = PrevBirdArray;
+            Job.CurrBirdArray = CurrBirdArray;
+            Job.CellOffsets = CellOffsets;
+            Job.CellsPerTile = Grid->NumCellsX;
+            Job.FrameTime = FrameTime;
+
+            job_callback* TileCallback = SimUpdateBirdsTile_x4;
+            if (Sim->LaneWidth == 16)
+            {
+                TileCallback = SimUpdateBirdsTile_x16;
+            }
+            else if (Sim->LaneWidth == 8)
+            {
+                TileCallback = SimUpdateBirdsTile_x8;
+            }
+        
+            u32 NumTiles = (NumCells + Job.CellsPerTile - 1) / Job.CellsPerTile;
+            JobSystemParallelFor(Sim->JobSystem, NumTiles, TileCallback, &Job);
+        }
+    }
+
+    // NOTE: Only list updates keep track of how far birds moved from the lists
+    if (!Sim->UseNeighbourLists)
+    {
+        Lists->Valid = false;
+    }
+
+    Sim->StepSearchPaths = ((Sim->UseNeighbourLists ? SimSearchPath_NeighbourLists : 0) |
+                            (Sim->UseHalfStencil ? SimSearchPath_HalfStencil : 0) |
+                            (Grid->NumNodeLevels ? SimSearchPath_FarField : 0) |
+                            (Grid->CellSplits ? SimSearchPath_AdaptiveGrid : 0) |
+                            (Sim->SearchBirds.Pos ? SimSearchPath_Quantised : 0));
+    Grid->CellSums = 0;
+    Grid->NumNodeLevels = 0;
+    Grid->CellSplitIds = 0;
+    Grid->CellSplits = 0;
+    Sim->SearchBirds = {};
+    Grid->NextCellIdsValid = Sim->WriteNextCellIds;
+    Sim->WriteNextCellIds = false;
+    Sim->UseHalfStencil = false;
+    Sim->UseNeighbourLists = false;
+    Sim->UseCellCulling = false;
+    EndTempMem(TempMem);
+
+    // NOTE: Clear the grid
+    {
+        SIM_TIMED_BLOCK("Clear Grid");
+        GridClear(Grid);
+    }
+}
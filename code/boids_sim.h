@@ -0,0 +1,552 @@
+#pragma once
+
+/*
+
+  NOTE: Headless boids simulation. Only depends on the math and memory libs so that it can be built on its own (see
+        CMakeLists.txt) and stepped without a window or GPU. The demo pulls this in as part of its unity build.
+
+ */
+
+#include "math/math.h"
+#include "memory/memory.h"
+
+#include <string.h>
+#include <mutex>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#include <cpuid.h>
+#endif
+
+//
+// NOTE: Profiling
+//
+
+/*
+
+  NOTE: The demo maps SIM_TIMED_BLOCK onto the profiling lib. Headless builds (boids_bench) get this minimal cycle counter
+        instead, which keeps one running total per named block until SimProfilerReset is called.
+
+ */
+
+#define SIM_MAX_TIMED_BLOCKS 32
+#define SIM_MAX_PROFILER_THREADS 64
+
+struct sim_profiler
+{
+    std::mutex RegisterMutex;
+    u32 NumBlocks;
+    const char* BlockNames[SIM_MAX_TIMED_BLOCKS];
+
+    // NOTE: Every thread accumulates into its own row, blocks that run on workers report the total cycles over all threads
+    u64 BlockCycles[SIM_MAX_PROFILER_THREADS][SIM_MAX_TIMED_BLOCKS];
+};
+
+extern sim_profiler SimProfiler;
+extern thread_local u32 SimProfilerThreadId;
+
+inline u32 SimProfilerBlockId(const char* Name)
+{
+    std::lock_guard<std::mutex> Lock(SimProfiler.RegisterMutex);
+    
+    // NOTE: Only called once per call site so a linear search is fine
+    for (u32 BlockId = 0; BlockId < SimProfiler.NumBlocks; ++BlockId)
+    {
+        if (strcmp(SimProfiler.BlockNames[BlockId], Name) == 0)
+        {
+            return BlockId;
+        }
+    }
+
+    Assert(SimProfiler.NumBlocks < SIM_MAX_TIMED_BLOCKS);
+    u32 Result = SimProfiler.NumBlocks++;
+    SimProfiler.BlockNames[Result] = Name;
+    return Result;
+}
+
+inline void SimProfilerReset()
+{
+    for (u32 ThreadId = 0; ThreadId < SIM_MAX_PROFILER_THREADS; ++ThreadId)
+    {
+        for (u32 BlockId = 0; BlockId < SimProfiler.NumBlocks; ++BlockId)
+        {
+            SimProfiler.BlockCycles[ThreadId][BlockId] = 0;
+        }
+    }
+}
+
+inline u64 SimProfilerGetCycles(u32 BlockId)
+{
+    u64 Result = 0;
+    for (u32 ThreadId = 0; ThreadId < SIM_MAX_PROFILER_THREADS; ++ThreadId)
+    {
+        Result += SimProfiler.BlockCycles[ThreadId][BlockId];
+    }
+    return Result;
+}
+
+struct sim_timed_block
+{
+    u32 BlockId;
+    u64 StartCycles;
+
+    sim_timed_block(u32 InBlockId)
+    {
+        BlockId = InBlockId;
+        StartCycles = __rdtsc();
+    }
+
+    ~sim_timed_block()
+    {
+        SimProfiler.BlockCycles[SimProfilerThreadId][BlockId] += __rdtsc() - StartCycles;
+    }
+};
+
+#ifndef SIM_TIMED_BLOCK
+#define SIM_TIMED_BLOCK__(Name, Line) local_global u32 SimBlockId##Line = SimProfilerBlockId(Name); sim_timed_block SimTimedBlock##Line(SimBlockId##Line)
+#define SIM_TIMED_BLOCK_(Name, Line) SIM_TIMED_BLOCK__(Name, Line)
+#define SIM_TIMED_BLOCK(Name) SIM_TIMED_BLOCK_(Name, __LINE__)
+#endif
+
+#include "boids_jobs.h"
+
+//
+// NOTE: Spatial Partition
+//
+
+struct grid_range
+{
+    u32 StartX;
+    u32 StartY;
+    u32 EndX;
+    u32 EndY;
+    // NOTE: Only set for 3D grids
+    u32 StartZ;
+    u32 EndZ;
+};
+
+struct grid_row_cull
+{
+    // NOTE: Cells of the row that any lane can reach, empty when StartX > EndX
+    u32 StartX;
+    u32 EndX;
+
+    // NOTE: Runs of cells inside the bird radius for every lane, and either outside or (AcceptInsideAvoid) inside the avoid
+    //       radius for every lane
+    u32 NumAccepted;
+    u32 AcceptStartX[3];
+    u32 AcceptOnePastEndX[3];
+    b32 AcceptInsideAvoid[3];
+};
+
+struct grid_cell
+{
+    u32 NumIndices;
+    block_arena IndexArena;
+};
+
+struct grid_cell_sum
+{
+    f32 PosX;
+    f32 PosY;
+    f32 VelX;
+    f32 VelY;
+};
+
+#define GRID_SPLIT_DIM 4
+#define GRID_SPLIT_NUM_CELLS (GRID_SPLIT_DIM * GRID_SPLIT_DIM)
+#define GRID_CELL_NOT_SPLIT 0xFFFFFFFF
+
+// NOTE: A crowded cell cut into GRID_SPLIT_DIM x GRID_SPLIT_DIM row major sub cells. Its birds are sorted by sub cell, so sub cell s
+//       holds the slots from CellStart + SubCellStart[s] up to CellStart + SubCellStart[s + 1]
+struct grid_cell_split
+{
+    u32 SubCellStart[GRID_SPLIT_NUM_CELLS + 1];
+    grid_cell_sum SubCellSums[GRID_SPLIT_NUM_CELLS];
+};
+
+enum grid_layout
+{
+    // NOTE: Every cell owns a block arena of bird ids
+    GridLayout_BlockArena,
+    // NOTE: CSR layout, cell i owns Indices[CellStart[i], CellStart[i] + CellCount[i])
+    GridLayout_Compact,
+};
+
+// NOTE: Enough levels for the largest Morton grid (0x10000 cells per axis)
+#define GRID_MAX_NODE_LEVELS 17
+
+enum grid_cell_order
+{
+    // NOTE: CellId = Y * NumCellsX + X, a 3x3 neighbourhood spans 3 rows that are NumCellsX cells apart
+    GridCellOrder_RowMajor,
+    // NOTE: CellId interleaves the bits of X and Y so nearby cells get nearby ids, needs a square power of 2 grid
+    GridCellOrder_Morton,
+    // NOTE: Spatial hash for unbounded worlds, any integer cell (X, Y) on the plane is stored in row major cell
+    //       (X mod NumCellsX, Y mod NumCellsY). WorldBounds is one period of the wrap and only sets the origin and the cell
+    //       size, and the cell counts have to be powers of 2 so that the mod is a mask
+    GridCellOrder_Hashed,
+};
+
+struct grid
+{
+    grid_layout Layout;
+    grid_cell_order CellOrder;
+    aabb2 WorldBounds;
+    u32 NumCellsX;
+    u32 NumCellsY;
+    // NOTE: Storage is allocated for the max grid, NumCellsX/Y can change between steps as long as they fit
+    u32 MaxNumCellsX;
+    u32 MaxNumCellsY;
+    // NOTE: 1 for 2D. 3D grids are always row major and stack NumCellsZ layers of NumCellsY rows, so that
+    //       CellId = (Z * NumCellsY + Y) * NumCellsX + X and a row of X cells is still contiguous. They only have to fit
+    //       MaxNumCellsX * MaxNumCellsY cells in total
+    u32 NumCellsZ;
+    f32 WorldMinZ;
+    f32 WorldMaxZ;
+
+    // NOTE: Block arena layout
+    u32 MaxNumIndicesPerBlock;
+    grid_cell* Cells;
+
+    // NOTE: Compact layout
+    u32* CellStart;
+    u32* CellCount;
+    u32* Indices;
+    u32* IndexCellIds;
+
+    // NOTE: Cell count, bounds and order of the last compact build. The incremental update keeps CellStart/CellCount and
+    //       IndexCellIds up to date from there on but not Indices, which are only read while birds aren't in cell order
+    u32 BuiltNumCellsX;
+    u32 BuiltNumCellsY;
+    aabb2 BuiltWorldBounds;
+    grid_cell_order BuiltCellOrder;
+    // NOTE: Cell of every slot's position after the last update, only written while birds are in cell order
+    b32 NextCellIdsValid;
+    u32* NextCellIds;
+
+    // NOTE: Only set during SimStep when birds are in cell order and culling is on, sums of the birds in each cell
+    grid_cell_sum* CellSums;
+    // NOTE: Only set during SimStep with the far field. In Morton order every aligned 2^L x 2^L block of cells is a node of a
+    //       quadtree and a contiguous range of cell ids, NodeSums[L] holds the sums of those blocks and NodeSums[0] is CellSums
+    u32 NumNodeLevels;
+    grid_cell_sum* NodeSums[GRID_MAX_NODE_LEVELS];
+    // NOTE: Only set during SimStep with the adaptive grid, CellSplitIds[CellId] indexes the split of a crowded cell in
+    //       CellSplits or is GRID_CELL_NOT_SPLIT
+    u32* CellSplitIds;
+    grid_cell_split* CellSplits;
+};
+
+inline u32 GridGetNumCells(grid* Grid)
+{
+    u32 Result = Grid->NumCellsX * Grid->NumCellsY * Grid->NumCellsZ;
+    return Result;
+}
+
+inline b32 GridSupportsMorton(grid* Grid)
+{
+    // NOTE: Morton ids are only dense for square power of 2 grids
+    b32 Result = (Grid->NumCellsX == Grid->NumCellsY && (Grid->NumCellsX & (Grid->NumCellsX - 1)) == 0 &&
+                  Grid->NumCellsX <= 0x10000);
+    return Result;
+}
+
+inline b32 GridSupportsHashed(grid* Grid)
+{
+    b32 Result = (Grid->NumCellsX & (Grid->NumCellsX - 1)) == 0 && (Grid->NumCellsY & (Grid->NumCellsY - 1)) == 0;
+    return Result;
+}
+
+//
+// NOTE: Bird Data
+//
+
+struct bird_array
+{
+    // TODO: Handle multiple grid cells for one entity
+    f32* PosX;
+    f32* PosY;
+    f32* VelX;
+    f32* VelY;
+    // NOTE: Only allocated once SimEnable3d was called
+    f32* PosZ;
+    f32* VelZ;
+    // NOTE: Only allocated once SimEnableSpecies was called, indexes the rows of Sim->SpeciesTable
+    u32* Species;
+};
+
+// NOTE: Per bird neighbour sums, in the same slots as the bird arrays
+struct bird_accumulator_array
+{
+    f32* NumBirdsInRadius;
+    f32* FlockDirX;
+    f32* FlockDirY;
+    f32* FlockPosX;
+    f32* FlockPosY;
+    f32* AvoidanceX;
+    f32* AvoidanceY;
+};
+
+// NOTE: 16 bit copies of the birds for the neighbour search, in the same slots as the bird arrays. X is in the low half and Y in
+//       the high half of every u32. Positions are fixed point from PosMin, velocities are signed
+struct bird_search_array
+{
+    u32* Pos;
+    u32* Vel;
+    v2 PosMin;
+    f32 PosScale;
+    f32 InvPosScale;
+    f32 VelScale;
+    u32 BirdRadiusSq;
+    u32 AvoidRadiusSq;
+};
+
+struct neighbour_lists
+{
+    // NOTE: Packet p of LaneWidth birds lists Entries[PacketOffsets[p], PacketOffsets[p] + PacketLengths[p]), every bird within
+    //       radius + skin of any bird in the packet
+    u32 MaxNumEntries;
+    u32* Entries;
+    u32* PacketOffsets;
+    u32* PacketLengths;
+
+    // NOTE: Positions at the last build, the lists stay valid while no bird moved more than half the skin from them
+    f32* BuildPosX;
+    f32* BuildPosY;
+    f32 MaxDisplacementSq;
+    u32 NumStepsUntilRetry;
+
+    // NOTE: Any change to these since the last build forces a rebuild
+    b32 Valid;
+    u32 LaneWidth;
+    f32 BirdRadiusSq;
+    f32 AvoidRadiusSq;
+    f32 Skin;
+};
+
+enum sim_rule_set
+{
+    // NOTE: Blends the velocity towards each rule's target and clamps the speed afterwards
+    SimRuleSet_VelocityBlend,
+    // NOTE: Reynolds style steering from the acceleration model prototype. Every rule steers from the velocity towards its
+    //       target at MaxSpeed with a force clamped to MaxSteerSpeed, and the weighted forces are integrated as an acceleration
+    SimRuleSet_Steering,
+};
+
+enum sim_rule
+{
+    // NOTE: The rules that read the neighbours. The kernels get compiled once per combination so a zero weight also drops
+    //       the rule's accumulators and loads from the neighbour loops (see SIM_DISPATCH_RULES)
+    SimRule_MoveToFlock = 1 << 0,
+    SimRule_AlignFlock = 1 << 1,
+    SimRule_AvoidBirds = 1 << 2,
+    // NOTE: Not a rule of its own, the rules above only see the neighbours in front of the bird (see FovCosHalfAngle)
+    SimRule_FieldOfView = 1 << 3,
+    // NOTE: Not a rule of its own either, birds only flock with their own species but still avoid every bird, and every lane
+    //       gets its radii and weights from the species table
+    SimRule_Species = 1 << 4,
+
+    SimRule_All = SimRule_MoveToFlock | SimRule_AlignFlock | SimRule_AvoidBirds,
+};
+
+enum sim_search_path
+{
+    // NOTE: The search modes are requests, SimStep turns them off when they can't run (e.g. the half stencil with a field of
+    //       view). These are the ones a step actually took
+    SimSearchPath_NeighbourLists = 1 << 0,
+    SimSearchPath_HalfStencil = 1 << 1,
+    SimSearchPath_FarField = 1 << 2,
+    SimSearchPath_AdaptiveGrid = 1 << 3,
+    SimSearchPath_Quantised = 1 << 4,
+};
+
+#define SIM_MAX_SPECIES 8
+
+// NOTE: The boid globals per species, one array per parameter so that a packet of birds with mixed species can gather each
+//       parameter with the species ids as indices
+struct sim_species_table
+{
+    u32 NumSpecies;
+    f32 MinSpeed[SIM_MAX_SPECIES];
+    f32 MaxSpeed[SIM_MAX_SPECIES];
+    f32 BirdRadiusSq[SIM_MAX_SPECIES];
+    f32 AvoidRadiusSq[SIM_MAX_SPECIES];
+    f32 AvoidBirdWeight[SIM_MAX_SPECIES];
+    f32 AlignFlockWeight[SIM_MAX_SPECIES];
+    f32 MoveToFlockWeight[SIM_MAX_SPECIES];
+};
+
+// NOTE: Static obstacles as a signed distance field, sampled on a regular grid over Min..Max and negative inside the
+//       obstacles. SimLoadSdf precomputes the normalised gradient of every sample so the update only blends the 4 samples
+//       around each bird, whatever the number of obstacles
+struct sim_sdf
+{
+    u32 Width;
+    u32 Height;
+    v2 Min;
+    v2 Max;
+    // NOTE: Samples per world unit on each axis
+    v2 InvSampleDim;
+    f32* Distance;
+    f32* GradientX;
+    f32* GradientY;
+};
+
+// NOTE: An SDF file is this header followed by Width * Height f32 distances, row by row from MinY up
+#define SIM_SDF_FILE_MAGIC 0x31464453 // "SDF1"
+
+struct sim_sdf_file_header
+{
+    u32 Magic;
+    u32 Width;
+    u32 Height;
+    f32 MinX;
+    f32 MinY;
+    f32 MaxX;
+    f32 MaxY;
+};
+
+struct sim_random_series
+{
+    u32 State;
+};
+
+struct sim_state
+{
+    sim_random_series Random;
+    linear_arena TempArena;
+    job_system* JobSystem;
+    platform_block_arena PlatformBlockArena;
+
+    // NOTE: Boid Globals
+    f32 MinSpeed;
+    f32 MaxSpeed;
+    f32 BirdRadiusSq;
+    f32 AvoidRadiusSq;
+    f32 TerrainAvoidRadius;
+    f32 TerrainRadius;
+    // NOTE: Drops the terrain walls and the clamp that keeps birds inside them. The dense grids still work but pile every bird
+    //       outside their bounds into the edge cells, the hashed grid doesn't care how far the birds fly
+    b32 UnboundedWorld;
+
+    // NOTE: The weights mean different things per rule set, SimSetRuleSet loads the defaults of the one it switches to
+    sim_rule_set RuleSet;
+    f32 AvoidTerrainWeight;
+    f32 AvoidBirdWeight;
+    f32 AlignFlockWeight;
+    f32 MoveToFlockWeight;
+    // NOTE: Only used by the steering rules
+    f32 MaxSteerSpeed;
+    // NOTE: Cosine of half the angle birds see around their heading, the rest is a blind spot behind them. -1 sees everything
+    f32 FovCosHalfAngle;
+    // NOTE: sim_rule flags of the rules with a nonzero weight, SimStep sets them from the weights every step
+    u32 ActiveRules;
+    // NOTE: Only used once SimEnableSpecies was called. Replaces the globals above that it has a column for, the terrain
+    //       ones and MaxSteerSpeed stay shared
+    sim_species_table SpeciesTable;
+    // NOTE: Only used once SimLoadSdf was called. Replaces the 2D wall tests, birds avoid every point of the field closer
+    //       than TerrainAvoidRadius. The world stays clamped to TerrainRadius and 3D flocks keep their walls
+    sim_sdf Sdf;
+    // NOTE: The weights mean different things per rule set like the ones above. Birds flee every predator within
+    //       PredatorRadiusSq and seek every attractor within AttractorRadiusSq with the full weight, and see both all around
+    f32 FleePredatorWeight;
+    f32 SeekAttractorWeight;
+    f32 PredatorRadiusSq;
+    f32 AttractorRadiusSq;
+    f32 PredatorSpeed;
+
+    // NOTE: Bird Data
+    // IMPORTANT: CurrBirds always holds the result of the last SimStep, PrevBirds is scratch for the next step
+    u32 NumBirds;
+    bird_array CurrBirds;
+    bird_array PrevBirds;
+
+    grid Grid;
+
+    // NOTE: Only set once SimEnableInfluencers was called. Predators come first and fly straight, bouncing off the walls,
+    //       attractors stay where they were put. Both get their own coarse row major grid, rebuilt every step, that the
+    //       update queries next to the bird grid
+    u32 NumPredators;
+    u32 NumAttractors;
+    bird_array Influencers;
+    grid InfluencerGrid;
+    linear_arena InfluencerTempArena;
+
+    // NOTE: Sim Modes
+    b32 ParallelGridBuild;
+    // NOTE: Re-derives the cell count every step so that cells are about as wide as the largest radius
+    b32 AutoGridSize;
+    b32 ReorderBirds;
+    // NOTE: Once birds are in cell order, only moves the birds that changed cells instead of rebuilding the grid and
+    //       reordering every bird. Falls back to a full build whenever the cell count or order changes
+    b32 IncrementalGrid;
+    // NOTE: Only used when birds are in cell order, tests a vector of neighbours per iteration through lane rotations. Set by
+    //       SimSetLaneWidth to whatever is faster for that width
+    b32 TiledNeighbours;
+    // NOTE: Trims each neighbour row to the cells the radii reach and sums cells that pass every radius test without per pair
+    //       tests
+    b32 CellCulling;
+    // NOTE: Tests every pair once from the lower of its two cells and scatters the sums to both birds. Only used when birds
+    //       are in row major cell order, and needs SimEnableHalfStencil to allocate the per thread accumulators
+    b32 HalfStencil;
+    // NOTE: Keeps a list of the birds within the radius + NeighbourSkin of every bird and only rebuilds the grid and the lists
+    //       once a bird moved more than half the skin. Needs ReorderBirds, the compact grid and SimEnableNeighbourLists
+    b32 NeighbourLists;
+    f32 NeighbourSkin;
+    // NOTE: Walks the quadtree of the Morton grid and adds whole nodes that are inside the bird radius and outside the avoid
+    //       radius for the entire packet, only the rest is tested per bird. Picks cells much smaller than the radius and packs
+    //       packets across cells, needs ReorderBirds and the compact grid
+    b32 FarField;
+    // NOTE: Sorts the birds of crowded cells into sub cells so that queries can skip, sum or scan each sub cell, which keeps
+    //       dense flocks from scanning hundreds of birds per cell. Needs birds in cell order, not used with the far field,
+    //       neighbour lists or the half stencil
+    b32 AdaptiveGrid;
+    // NOTE: Runs the neighbour search on 16 bit positions and velocities with integer distance tests, which halves the bytes
+    //       read per neighbour. Only used when birds are in cell order and without neighbour lists or the half stencil. Faster at
+    //       4 and 8 lanes, but the 16 lane kernel has to split the 16 bit ops into AVX2 halves and ends up slower
+    b32 QuantisedSearch;
+    // NOTE: Flocks in a cube instead of a square, set by SimEnable3d. Runs its own step on a 3D row major compact grid with a
+    //       3x3x3 stencil and ignores the modes above except ParallelGridBuild and AutoGridSize
+    b32 Flock3d;
+    // NOTE: 4 (SSE), 8 (AVX2) or 16 (AVX-512), defaults to the widest the CPU supports
+    u32 LaneWidth;
+
+    // NOTE: Only valid with ReorderBirds, BirdIds[i] is the id given by SimInit to the bird now stored in slot i
+    b32 BirdsInCellOrder;
+    u32* BirdIds;
+    u32* ScratchBirdIds;
+
+    // NOTE: One accumulator array per job system thread, UseHalfStencil is only valid during SimStep
+    b32 UseHalfStencil;
+    bird_accumulator_array* ThreadAccumulators;
+
+    // NOTE: Only set during SimStep when the quantised search is used
+    bird_search_array SearchBirds;
+
+    // NOTE: Only valid during SimStep, tells the update to fill Grid.NextCellIds
+    b32 WriteNextCellIds;
+
+    // NOTE: Only valid during SimStep, CellCulling while every bird lies inside the bounds of its cell
+    b32 UseCellCulling;
+
+    // NOTE: UseNeighbourLists is only valid during SimStep
+    b32 UseNeighbourLists;
+    neighbour_lists NeighbourListData;
+
+    // NOTE: sim_search_path flags of the last SimStep
+    u32 StepSearchPaths;
+};
+
+u32 SimGetMaxLaneWidth();
+void SimSetLaneWidth(sim_state* Sim, u32 LaneWidth);
+void SimSetRuleSet(sim_state* Sim, sim_rule_set RuleSet);
+void SimInit(sim_state* Sim, linear_arena* Arena, u32 NumBirds, u32 Seed, u32 NumThreads, u32 MaxCellCountForAxis);
+void SimEnableHalfStencil(sim_state* Sim, linear_arena* Arena);
+void SimEnableNeighbourLists(sim_state* Sim, linear_arena* Arena);
+void SimEnable3d(sim_state* Sim, linear_arena* Arena);
+void SimEnableSpecies(sim_state* Sim, linear_arena* Arena, u32 NumSpecies);
+b32 SimLoadSdf(sim_state* Sim, linear_arena* Arena, void* FileData, u64 FileSize);
+void SimEnableInfluencers(sim_state* Sim, linear_arena* Arena, u32 NumPredators, u32 NumAttractors);
+void SimDestroy(sim_state* Sim);
+void SimStep(sim_state* Sim, f32 FrameTime);
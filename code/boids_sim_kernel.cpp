@@ -0,0 +1,2258 @@
+/*
+
+  NOTE: The flocking kernel, written once against lane_f32/lane_u32/lane_v2 and compiled for every lane width the sim
+        dispatches to. Set SIM_LANE_WIDTH to 4, 8 or 16 before including this file, every function gets a _x4/_x8/_x16
+        suffix through SIM_LANE so the widths can live side by side in the unity build. The 8 and 16 wide versions have to
+        be included between SIM_TARGET_BEGIN_AVX2/AVX512 and SIM_TARGET_END.
+
+ */
+
+#if SIM_LANE_WIDTH == 4
+#define SIM_LANE(Name) Name##_x4
+#define SIM_LANE_MASK 0xF
+#define lane_f32 v1_x4
+#define lane_u32 v1u_x4
+#define lane_v2 v2_x4
+#define LaneF32 V1X4
+#define LaneU32 V1UX4
+#define LaneV2 V2X4
+#define lane_v3 v3_x4
+#define LaneV3 V3X4
+#define LaneU32Index() V1UX4(0, 1, 2, 3)
+#define LaneU32Cast V1UX4Cast
+#define LaneF32LoadUnAligned V1X4LoadUnAligned
+#define LaneU32LoadUnAligned V1UX4LoadUnAligned
+#define LaneV2LoadUnAligned V2X4LoadUnAligned
+#define LaneV2Gather V2X4Gather
+#define LaneF32Gather V1X4Gather
+#define LaneFloorU32 FloorV1UX4
+#elif SIM_LANE_WIDTH == 8
+#define SIM_LANE(Name) Name##_x8
+#define SIM_LANE_MASK 0xFF
+#define lane_f32 v1_x8
+#define lane_u32 v1u_x8
+#define lane_v2 v2_x8
+#define LaneF32 V1X8
+#define LaneU32 V1UX8
+#define LaneV2 V2X8
+#define lane_v3 v3_x8
+#define LaneV3 V3X8
+#define LaneU32Index() V1UX8LaneIndex()
+#define LaneU32Cast V1UX8Cast
+#define LaneF32LoadUnAligned V1X8LoadUnAligned
+#define LaneU32LoadUnAligned V1UX8LoadUnAligned
+#define LaneV2LoadUnAligned V2X8LoadUnAligned
+#define LaneV2Gather V2X8Gather
+#define LaneF32Gather V1X8Gather
+#define LaneFloorU32 FloorV1UX8
+#elif SIM_LANE_WIDTH == 16
+#define SIM_LANE(Name) Name##_x16
+#define SIM_LANE_MASK 0xFFFF
+#define lane_f32 v1_x16
+#define lane_u32 v1u_x16
+#define lane_v2 v2_x16
+#define LaneF32 V1X16
+#define LaneU32 V1UX16
+#define LaneV2 V2X16
+#define lane_v3 v3_x16
+#define LaneV3 V3X16
+#define LaneU32Index() V1UX16LaneIndex()
+#define LaneU32Cast V1UX16Cast
+#define LaneF32LoadUnAligned V1X16LoadUnAligned
+#define LaneU32LoadUnAligned V1UX16LoadUnAligned
+#define LaneV2LoadUnAligned V2X16LoadUnAligned
+#define LaneV2Gather V2X16Gather
+#define LaneF32Gather V1X16Gather
+#define LaneFloorU32 FloorV1UX16
+#else
+#error "SIM_LANE_WIDTH has to be 4, 8 or 16"
+#endif
+
+struct SIM_LANE(bird_average_data)
+{
+    lane_u32 NumBirdsInRadius;
+    lane_v2 AvgFlockDir;
+    lane_v2 AvgFlockPos;
+    lane_v2 AvgFlockAvoidance;
+};
+
+//
+// NOTE: Spatial Partition
+//
+
+inline grid_range SIM_LANE(GridGetRange)(grid* Grid, lane_v2 Pos, lane_f32 Radius, lane_u32 IgnoreMask)
+{
+    grid_range Result = {};
+
+    lane_v2 MinPos = Pos - LaneV2(Radius, Radius);
+    lane_v2 MaxPos = Pos + LaneV2(Radius, Radius);
+
+    lane_v2 ReMappedMin = (MinPos - Grid->WorldBounds.Min) / AabbGetDim(Grid->WorldBounds);
+    lane_v2 ReMappedMax = (MaxPos - Grid->WorldBounds.Min) / AabbGetDim(Grid->WorldBounds);
+
+    // NOTE: Clamp while still in float, a negative value would wrap to a huge u32 and clamp to the last cell instead of the first
+    lane_u32 StartX = LaneFloorU32(Clamp(ReMappedMin.x * f32(Grid->NumCellsX), LaneF32(0.0f), LaneF32(f32(Grid->NumCellsX - 1))));
+    lane_u32 StartY = LaneFloorU32(Clamp(ReMappedMin.y * f32(Grid->NumCellsY), LaneF32(0.0f), LaneF32(f32(Grid->NumCellsY - 1))));
+    lane_u32 EndX = LaneFloorU32(Clamp(ReMappedMax.x * f32(Grid->NumCellsX), LaneF32(0.0f), LaneF32(f32(Grid->NumCellsX - 1))));
+    lane_u32 EndY = LaneFloorU32(Clamp(ReMappedMax.y * f32(Grid->NumCellsY), LaneF32(0.0f), LaneF32(f32(Grid->NumCellsY - 1))));
+    u32 OriginX = 0;
+    u32 OriginY = 0;
+    if (Grid->CellOrder == GridCellOrder_Hashed)
+    {
+        /* NOTE: Hashed cells aren't clamped and can be negative. The birds of a packet share a slot but can come from cells a
+                 whole number of periods apart, so their ranges only line up after wrapping. Every lane's start gets wrapped
+                 relative to half a period before the first lane's start, which is always valid, and its end keeps the lane's
+                 width so the min/max below never straddle the wrap.
+         */
+        lane_u32 CellStartX = LaneFloorU32(ReMappedMin.x * f32(Grid->NumCellsX));
+        lane_u32 CellStartY = LaneFloorU32(ReMappedMin.y * f32(Grid->NumCellsY));
+        OriginX = CellStartX.e[0] - Grid->NumCellsX / 2;
+        OriginY = CellStartY.e[0] - Grid->NumCellsY / 2;
+        StartX = (CellStartX - LaneU32(OriginX)) & LaneU32(Grid->NumCellsX - 1);
+        StartY = (CellStartY - LaneU32(OriginY)) & LaneU32(Grid->NumCellsY - 1);
+        EndX = StartX + (LaneFloorU32(ReMappedMax.x * f32(Grid->NumCellsX)) - CellStartX);
+        EndY = StartY + (LaneFloorU32(ReMappedMax.y * f32(Grid->NumCellsY)) - CellStartY);
+    }
+
+    // NOTE: Apply ignore mask to not change output
+    lane_u32 IgnoreMaskMin = ~IgnoreMask;
+    lane_u32 IgnoreMaskMax = IgnoreMask;
+
+    StartX = StartX | IgnoreMaskMin;
+    StartY = StartY | IgnoreMaskMin;
+    EndX = EndX & IgnoreMaskMax;
+    EndY = EndY & IgnoreMaskMax;
+
+    // NOTE: Compute horizontal min/maxes
+    Result.StartX = HorizontalMin(StartX);
+    Result.StartY = HorizontalMin(StartY);
+    Result.EndX = HorizontalMax(EndX);
+    Result.EndY = HorizontalMax(EndY);
+
+    if (Grid->CellOrder == GridCellOrder_Hashed)
+    {
+        // NOTE: A range wider than the grid would visit slots twice, so it gets cut down to one whole period. Back in cell
+        //       coordinates the end can be smaller than the start as u32, so loops have to count from the start
+        u32 NumCellsX = Min(Result.EndX - Result.StartX, Grid->NumCellsX - 1);
+        u32 NumCellsY = Min(Result.EndY - Result.StartY, Grid->NumCellsY - 1);
+        Result.StartX += OriginX;
+        Result.StartY += OriginY;
+        Result.EndX = Result.StartX + NumCellsX;
+        Result.EndY = Result.StartY + NumCellsY;
+    }
+
+    return Result;
+}
+
+// NOTE: The boid globals for every lane of a packet, per species once SimEnableSpecies was called
+struct SIM_LANE(bird_params)
+{
+    lane_u32 Species;
+    lane_f32 MinSpeed;
+    lane_f32 MaxSpeed;
+    lane_f32 BirdRadiusSq;
+    lane_f32 AvoidRadiusSq;
+    lane_f32 AvoidBirdWeight;
+    lane_f32 AlignFlockWeight;
+    lane_f32 MoveToFlockWeight;
+};
+
+inline lane_f32 SIM_LANE(GetSpeciesParam)(f32* Column, lane_u32 Species, b32 OneSpecies)
+{
+    lane_f32 Result = OneSpecies ? LaneF32(Column[Species.e[0]]) : LaneF32Gather(Column, Species, LaneU32(0xFFFFFFFF));
+    return Result;
+}
+
+inline SIM_LANE(bird_params) SIM_LANE(GetBirdParams)(sim_state* Sim, lane_u32 Species)
+{
+    SIM_LANE(bird_params) Result = {};
+    Result.Species = Species;
+    if (!(Sim->ActiveRules & SimRule_Species))
+    {
+        Result.MinSpeed = LaneF32(Sim->MinSpeed);
+        Result.MaxSpeed = LaneF32(Sim->MaxSpeed);
+        Result.BirdRadiusSq = LaneF32(Sim->BirdRadiusSq);
+        Result.AvoidRadiusSq = LaneF32(Sim->AvoidRadiusSq);
+        Result.AvoidBirdWeight = LaneF32(Sim->AvoidBirdWeight);
+        Result.AlignFlockWeight = LaneF32(Sim->AlignFlockWeight);
+        Result.MoveToFlockWeight = LaneF32(Sim->MoveToFlockWeight);
+        return Result;
+    }
+
+    // NOTE: Cells are sorted by species so most packets hold one and broadcast its row, the rest gather every column
+    sim_species_table* Table = &Sim->SpeciesTable;
+    b32 OneSpecies = MoveMask(Species == LaneU32(Species.e[0])) == SIM_LANE_MASK;
+    Result.MinSpeed = SIM_LANE(GetSpeciesParam)(Table->MinSpeed, Species, OneSpecies);
+    Result.MaxSpeed = SIM_LANE(GetSpeciesParam)(Table->MaxSpeed, Species, OneSpecies);
+    Result.BirdRadiusSq = SIM_LANE(GetSpeciesParam)(Table->BirdRadiusSq, Species, OneSpecies);
+    Result.AvoidRadiusSq = SIM_LANE(GetSpeciesParam)(Table->AvoidRadiusSq, Species, OneSpecies);
+    Result.AvoidBirdWeight = SIM_LANE(GetSpeciesParam)(Table->AvoidBirdWeight, Species, OneSpecies);
+    Result.AlignFlockWeight = SIM_LANE(GetSpeciesParam)(Table->AlignFlockWeight, Species, OneSpecies);
+    Result.MoveToFlockWeight = SIM_LANE(GetSpeciesParam)(Table->MoveToFlockWeight, Species, OneSpecies);
+    return Result;
+}
+
+inline lane_u32 SIM_LANE(GetInViewMask)(lane_v2 DistanceVec, lane_f32 DistanceSq, lane_v2 BirdHeading, lane_f32 FovCosSq)
+{
+    // NOTE: A neighbour is in view when Dot(Dir, Heading) >= Cos(HalfAngle), i.e. Dot(DistanceVec, Heading) >= Cos * Distance.
+    //       Squaring both sides but keeping their signs (FovCosSq is Cos * |Cos|) gets rid of the sqrt, and the blind spot
+    //       stays one compare
+    lane_f32 Dot = DistanceVec.x * BirdHeading.x + DistanceVec.y * BirdHeading.y;
+    lane_u32 Result = LaneU32Cast(Dot * Max(Dot, -Dot) >= FovCosSq * DistanceSq);
+    return Result;
+}
+
+// NOTE: Rules is a mask of sim_rule flags, call these through SIM_DISPATCH_RULES
+template <u32 Rules>
+inline void SIM_LANE(GridAccumulateNeighbours)(SIM_LANE(bird_average_data)* Result, bird_array BirdArray, u32* Indices,
+                                               u32 NumIndices, lane_v2 BirdPosition, lane_v2 BirdHeading, lane_u32 CurrBirdId,
+                                               lane_u32 CurrSpecies, lane_f32 BirdRadiusSq, lane_f32 AvoidRadiusSq,
+                                               lane_f32 FovCosSq)
+{
+    for (u32 IndexId = 0; IndexId < NumIndices; ++IndexId)
+    {
+        u32 NearbyBirdId = Indices[IndexId];
+        lane_u32 SameBirdMask = LaneU32(NearbyBirdId) != CurrBirdId;
+
+        lane_v2 NearbyBirdPos = LaneV2(BirdArray.PosX[NearbyBirdId], BirdArray.PosY[NearbyBirdId]);
+        lane_v2 DistanceVec = NearbyBirdPos - BirdPosition;
+        lane_f32 DistanceSq = LengthSquared(DistanceVec);
+
+        if (Rules & SimRule_FieldOfView)
+        {
+            SameBirdMask = SameBirdMask & SIM_LANE(GetInViewMask)(DistanceVec, DistanceSq, BirdHeading, FovCosSq);
+        }
+
+        if (Rules & (SimRule_MoveToFlock | SimRule_AlignFlock))
+        {
+            lane_u32 BirdRadiusMask = SameBirdMask & LaneU32Cast(DistanceSq < BirdRadiusSq) & LaneU32(0x1);
+            if (Rules & SimRule_Species)
+            {
+                // NOTE: Birds only flock with their own species, avoidance still counts everyone
+                BirdRadiusMask = BirdRadiusMask & (LaneU32(BirdArray.Species[NearbyBirdId]) == CurrSpecies);
+            }
+            lane_f32 BirdRadiusMaskFloat = LaneF32(BirdRadiusMask);
+            Result->NumBirdsInRadius += BirdRadiusMask;
+
+            // NOTE: Velocity Matching
+            if (Rules & SimRule_AlignFlock)
+            {
+                Result->AvgFlockDir += BirdRadiusMaskFloat * LaneV2(BirdArray.VelX[NearbyBirdId], BirdArray.VelY[NearbyBirdId]);
+            }
+
+            // NOTE: Bird Flocking
+            if (Rules & SimRule_MoveToFlock)
+            {
+                Result->AvgFlockPos += BirdRadiusMaskFloat * NearbyBirdPos;
+            }
+        }
+
+        // NOTE: Avoidance
+        if (Rules & SimRule_AvoidBirds)
+        {
+            lane_u32 AvoidRadiusMask = SameBirdMask & LaneU32Cast(DistanceSq < AvoidRadiusSq) & LaneU32(0x1);
+            lane_f32 AvoidRadiusMaskFloat = LaneF32(AvoidRadiusMask);
+            Result->AvgFlockAvoidance += AvoidRadiusMaskFloat * (-DistanceVec);
+        }
+    }
+}
+
+template <u32 Rules>
+inline void SIM_LANE(GridAccumulateNeighboursSorted)(SIM_LANE(bird_average_data)* Result, bird_array BirdArray, u32 StartBirdId,
+                                                     u32 NumBirds, lane_v2 BirdPosition, lane_v2 BirdHeading, lane_u32 CurrBirdId,
+                                                     lane_u32 CurrSpecies, lane_f32 BirdRadiusSq, lane_f32 AvoidRadiusSq,
+                                                     lane_f32 FovCosSq)
+{
+    // NOTE: Birds are stored in cell order so a cell range is a range of bird ids, no indirection and all loads stream
+    f32* PosX = BirdArray.PosX + StartBirdId;
+    f32* PosY = BirdArray.PosY + StartBirdId;
+    f32* VelX = BirdArray.VelX + StartBirdId;
+    f32* VelY = BirdArray.VelY + StartBirdId;
+    u32* Species = BirdArray.Species + StartBirdId;
+    for (u32 IndexId = 0; IndexId < NumBirds; ++IndexId)
+    {
+        lane_u32 SameBirdMask = LaneU32(StartBirdId + IndexId) != CurrBirdId;
+
+        lane_v2 NearbyBirdPos = LaneV2(PosX[IndexId], PosY[IndexId]);
+        lane_v2 DistanceVec = NearbyBirdPos - BirdPosition;
+        lane_f32 DistanceSq = LengthSquared(DistanceVec);
+
+        if (Rules & SimRule_FieldOfView)
+        {
+            SameBirdMask = SameBirdMask & SIM_LANE(GetInViewMask)(DistanceVec, DistanceSq, BirdHeading, FovCosSq);
+        }
+
+        if (Rules & (SimRule_MoveToFlock | SimRule_AlignFlock))
+        {
+            lane_u32 BirdRadiusMask = SameBirdMask & LaneU32Cast(DistanceSq < BirdRadiusSq) & LaneU32(0x1);
+            if (Rules & SimRule_Species)
+            {
+                BirdRadiusMask = BirdRadiusMask & (LaneU32(Species[IndexId]) == CurrSpecies);
+            }
+            lane_f32 BirdRadiusMaskFloat = LaneF32(BirdRadiusMask);
+            Result->NumBirdsInRadius += BirdRadiusMask;
+            if (Rules & SimRule_AlignFlock)
+            {
+                Result->AvgFlockDir += BirdRadiusMaskFloat * LaneV2(VelX[IndexId], VelY[IndexId]);
+            }
+            if (Rules & SimRule_MoveToFlock)
+            {
+                Result->AvgFlockPos += BirdRadiusMaskFloat * NearbyBirdPos;
+            }
+        }
+
+        if (Rules & SimRule_AvoidBirds)
+        {
+            lane_u32 AvoidRadiusMask = SameBirdMask & LaneU32Cast(DistanceSq < AvoidRadiusSq) & LaneU32(0x1);
+            lane_f32 AvoidRadiusMaskFloat = LaneF32(AvoidRadiusMask);
+            Result->AvgFlockAvoidance += AvoidRadiusMaskFloat * (-DistanceVec);
+        }
+    }
+}
+
+template <u32 Rules>
+inline void SIM_LANE(GridAccumulateNeighboursTiled)(SIM_LANE(bird_average_data)* Result, bird_array BirdArray, u32 StartBirdId,
+                                                    u32 NumBirds, lane_v2 BirdPosition, lane_v2 BirdHeading, lane_u32 CurrBirdId,
+                                                    lane_u32 CurrSpecies, lane_f32 BirdRadiusSq, lane_f32 AvoidRadiusSq,
+                                                    lane_f32 FovCosSq)
+{
+    // NOTE: Same as the sorted version but we load a full vector of neighbours and rotate it through every lane, so each
+    //       iteration tests one neighbour against every current bird without a scalar load + broadcast per neighbour
+    u32 NumTiledBirds = NumBirds - (NumBirds % SIM_LANE_WIDTH);
+    u32 MinCurrBirdId = HorizontalMin(CurrBirdId);
+    u32 MaxCurrBirdId = HorizontalMax(CurrBirdId);
+    for (u32 IndexId = 0; IndexId < NumTiledBirds; IndexId += SIM_LANE_WIDTH)
+    {
+        u32 FirstBirdId = StartBirdId + IndexId;
+        lane_u32 NearbyBirdId = LaneU32(FirstBirdId) + LaneU32Index();
+        lane_v2 NearbyBirdPos = LaneV2LoadUnAligned(BirdArray.PosX + FirstBirdId, BirdArray.PosY + FirstBirdId);
+        lane_v2 NearbyBirdVel = {};
+        if (Rules & SimRule_AlignFlock)
+        {
+            NearbyBirdVel = LaneV2LoadUnAligned(BirdArray.VelX + FirstBirdId, BirdArray.VelY + FirstBirdId);
+        }
+        lane_u32 NearbyBirdSpecies = {};
+        if (Rules & SimRule_Species)
+        {
+            NearbyBirdSpecies = LaneU32LoadUnAligned(BirdArray.Species + FirstBirdId);
+        }
+
+        // NOTE: Only tiles holding one of the current birds need the self test, which saves a rotation everywhere else
+        b32 TestIds = FirstBirdId <= MaxCurrBirdId && FirstBirdId + SIM_LANE_WIDTH > MinCurrBirdId;
+        for (u32 RotationId = 0; RotationId < SIM_LANE_WIDTH; ++RotationId)
+        {
+            lane_u32 SameBirdMask = LaneU32(0xFFFFFFFF);
+            if (TestIds)
+            {
+                SameBirdMask = NearbyBirdId != CurrBirdId;
+                NearbyBirdId = RotateLanes(NearbyBirdId);
+            }
+
+            lane_v2 DistanceVec = NearbyBirdPos - BirdPosition;
+            lane_f32 DistanceSq = LengthSquared(DistanceVec);
+            if (Rules & SimRule_FieldOfView)
+            {
+                SameBirdMask = SameBirdMask & SIM_LANE(GetInViewMask)(DistanceVec, DistanceSq, BirdHeading, FovCosSq);
+            }
+
+            if (Rules & (SimRule_MoveToFlock | SimRule_AlignFlock))
+            {
+                lane_u32 BirdRadiusMask = SameBirdMask & LaneU32Cast(DistanceSq < BirdRadiusSq) & LaneU32(0x1);
+                if (Rules & SimRule_Species)
+                {
+                    BirdRadiusMask = BirdRadiusMask & (NearbyBirdSpecies == CurrSpecies);
+                }
+                lane_f32 BirdRadiusMaskFloat = LaneF32(BirdRadiusMask);
+                Result->NumBirdsInRadius += BirdRadiusMask;
+                if (Rules & SimRule_AlignFlock)
+                {
+                    Result->AvgFlockDir += BirdRadiusMaskFloat * NearbyBirdVel;
+                }
+                if (Rules & SimRule_MoveToFlock)
+                {
+                    Result->AvgFlockPos += BirdRadiusMaskFloat * NearbyBirdPos;
+                }
+            }
+
+            if (Rules & SimRule_AvoidBirds)
+            {
+                lane_u32 AvoidRadiusMask = SameBirdMask & LaneU32Cast(DistanceSq < AvoidRadiusSq) & LaneU32(0x1);
+                lane_f32 AvoidRadiusMaskFloat = LaneF32(AvoidRadiusMask);
+                Result->AvgFlockAvoidance += AvoidRadiusMaskFloat * (-DistanceVec);
+            }
+
+            NearbyBirdPos = RotateLanes(NearbyBirdPos);
+            if (Rules & SimRule_AlignFlock)
+            {
+                NearbyBirdVel = RotateLanes(NearbyBirdVel);
+            }
+            if (Rules & SimRule_Species)
+            {
+                NearbyBirdSpecies = RotateLanes(NearbyBirdSpecies);
+            }
+        }
+    }
+
+    // NOTE: A partial tile would still pay for every rotation, sparse cells are cheaper one neighbour at a time
+    SIM_LANE(GridAccumulateNeighboursSorted)<Rules>(Result, BirdArray, StartBirdId + NumTiledBirds, NumBirds - NumTiledBirds,
+                                                    BirdPosition, BirdHeading, CurrBirdId, CurrSpecies, BirdRadiusSq, AvoidRadiusSq,
+                                                    FovCosSq);
+}
+
+struct SIM_LANE(quantised_query)
+{
+    lane_u32 Pos;
+    // NOTE: Position that Pos stands for, the position sums are kept relative to it
+    lane_v2 Origin;
+    lane_u32 BirdRadiusSq;
+    lane_u32 AvoidRadiusSq;
+};
+
+struct SIM_LANE(quantised_sums)
+{
+    lane_u32 NumBirdsInRadius;
+    lane_u32 FlockDirX;
+    lane_u32 FlockDirY;
+    lane_u32 FlockOffsetX;
+    lane_u32 FlockOffsetY;
+    lane_u32 AvoidOffsetX;
+    lane_u32 AvoidOffsetY;
+};
+
+inline SIM_LANE(quantised_query) SIM_LANE(QuantiseQuery)(bird_search_array* Search, lane_v2 BirdPosition)
+{
+    SIM_LANE(quantised_query) Result = {};
+
+    lane_v2 Scaled = (BirdPosition - Search->PosMin) * Search->InvPosScale + LaneV2(0.5f);
+    lane_u32 X = LaneFloorU32(Clamp(Scaled.x, LaneF32(0.0f), LaneF32(SIM_QUANTISE_MAX_POS)));
+    lane_u32 Y = LaneFloorU32(Clamp(Scaled.y, LaneF32(0.0f), LaneF32(SIM_QUANTISE_MAX_POS)));
+    Result.Pos = PackI16Pairs(X, Y);
+    Result.Origin = LaneV2(LaneF32(X), LaneF32(Y)) * Search->PosScale + Search->PosMin;
+    Result.BirdRadiusSq = LaneU32(Search->BirdRadiusSq);
+    Result.AvoidRadiusSq = LaneU32(Search->AvoidRadiusSq);
+
+    return Result;
+}
+
+inline void SIM_LANE(QuantisedAccumulate)(SIM_LANE(quantised_sums)* Sums, SIM_LANE(quantised_query)* Query, lane_u32 NearbyBirdPos,
+                                          lane_u32 NearbyBirdVel, lane_u32 SameBirdMask)
+{
+    // NOTE: Birds in a scanned range are less than half the fixed point range apart, so the wrapped 16 bit differences are exact
+    lane_u32 DistanceVec = SubI16Pairs(NearbyBirdPos, Query->Pos);
+    lane_u32 DistanceSq = DotI16Pairs(DistanceVec, DistanceVec);
+    lane_u32 UnitX = LaneU32(0x00000001);
+    lane_u32 UnitY = LaneU32(0x00010000);
+
+    lane_u32 BirdRadiusMask = SameBirdMask & (DistanceSq < Query->BirdRadiusSq);
+    lane_u32 BirdDistanceVec = DistanceVec & BirdRadiusMask;
+    lane_u32 BirdVel = NearbyBirdVel & BirdRadiusMask;
+    Sums->NumBirdsInRadius = Sums->NumBirdsInRadius - BirdRadiusMask;
+    Sums->FlockDirX += DotI16Pairs(BirdVel, UnitX);
+    Sums->FlockDirY += DotI16Pairs(BirdVel, UnitY);
+    Sums->FlockOffsetX += DotI16Pairs(BirdDistanceVec, UnitX);
+    Sums->FlockOffsetY += DotI16Pairs(BirdDistanceVec, UnitY);
+
+    lane_u32 AvoidRadiusMask = SameBirdMask & (DistanceSq < Query->AvoidRadiusSq);
+    lane_u32 AvoidDistanceVec = DistanceVec & AvoidRadiusMask;
+    Sums->AvoidOffsetX += DotI16Pairs(AvoidDistanceVec, UnitX);
+    Sums->AvoidOffsetY += DotI16Pairs(AvoidDistanceVec, UnitY);
+}
+
+inline void SIM_LANE(GridAccumulateNeighboursQuantised)(SIM_LANE(bird_average_data)* Result, bird_search_array* Search,
+                                                        b32 Tiled, u32 StartBirdId, u32 NumBirds, SIM_LANE(quantised_query)* Query,
+                                                        lane_u32 CurrBirdId)
+{
+    // NOTE: Same scans as the sorted and tiled versions on the 16 bit copies of the birds
+    SIM_LANE(quantised_sums) Sums = {};
+
+    u32 NumTiledBirds = Tiled ? NumBirds - (NumBirds % SIM_LANE_WIDTH) : 0;
+    u32 MinCurrBirdId = HorizontalMin(CurrBirdId);
+    u32 MaxCurrBirdId = HorizontalMax(CurrBirdId);
+    for (u32 IndexId = 0; IndexId < NumTiledBirds; IndexId += SIM_LANE_WIDTH)
+    {
+        u32 FirstBirdId = StartBirdId + IndexId;
+        lane_u32 NearbyBirdId = LaneU32(FirstBirdId) + LaneU32Index();
+        lane_u32 NearbyBirdPos = LaneU32LoadUnAligned(Search->Pos + FirstBirdId);
+        lane_u32 NearbyBirdVel = LaneU32LoadUnAligned(Search->Vel + FirstBirdId);
+
+        b32 TestIds = FirstBirdId <= MaxCurrBirdId && FirstBirdId + SIM_LANE_WIDTH > MinCurrBirdId;
+        for (u32 RotationId = 0; RotationId < SIM_LANE_WIDTH; ++RotationId)
+        {
+            lane_u32 SameBirdMask = LaneU32(0xFFFFFFFF);
+            if (TestIds)
+            {
+                SameBirdMask = NearbyBirdId != CurrBirdId;
+                NearbyBirdId = RotateLanes(NearbyBirdId);
+            }
+
+            SIM_LANE(QuantisedAccumulate)(&Sums, Query, NearbyBirdPos, NearbyBirdVel, SameBirdMask);
+            NearbyBirdPos = RotateLanes(NearbyBirdPos);
+            NearbyBirdVel = RotateLanes(NearbyBirdVel);
+        }
+    }
+
+    for (u32 IndexId = NumTiledBirds; IndexId < NumBirds; ++IndexId)
+    {
+        u32 NearbyBirdId = StartBirdId + IndexId;
+        lane_u32 SameBirdMask = LaneU32(NearbyBirdId) != CurrBirdId;
+        SIM_LANE(QuantisedAccumulate)(&Sums, Query, LaneU32(Search->Pos[NearbyBirdId]), LaneU32(Search->Vel[NearbyBirdId]),
+                                      SameBirdMask);
+    }
+
+    // NOTE: Convert once per range, the positions come back as the query position plus the summed offsets
+    lane_v2 FlockOffset = LaneV2(LaneF32(Sums.FlockOffsetX), LaneF32(Sums.FlockOffsetY));
+    lane_v2 AvoidOffset = LaneV2(LaneF32(Sums.AvoidOffsetX), LaneF32(Sums.AvoidOffsetY));
+    Result->NumBirdsInRadius += Sums.NumBirdsInRadius;
+    Result->AvgFlockDir += LaneV2(LaneF32(Sums.FlockDirX), LaneF32(Sums.FlockDirY)) * Search->VelScale;
+    Result->AvgFlockPos += LaneF32(Sums.NumBirdsInRadius) * Query->Origin + FlockOffset * Search->PosScale;
+    Result->AvgFlockAvoidance += AvoidOffset * (-Search->PosScale);
+}
+
+inline void SIM_LANE(GridAccumulateIndexRange)(sim_state* Sim, grid* Grid, SIM_LANE(bird_average_data)* Result,
+                                               bird_array BirdArray, u32 StartIndexId, u32 EndIndexId, lane_v2 BirdPosition,
+                                               lane_v2 BirdHeading, lane_u32 CurrBirdId, lane_u32 CurrSpecies,
+                                               lane_f32 BirdRadiusSq, lane_f32 AvoidRadiusSq, SIM_LANE(quantised_query)* Query)
+{
+    // NOTE: Accumulates Grid->Indices[StartIndexId, EndIndexId), which are bird ids StartIndexId.. when birds are in cell order
+    u32 NumIndices = EndIndexId - StartIndexId;
+    lane_f32 FovCosSq = LaneF32(SimGetFovCosSq(Sim));
+    if (Query)
+    {
+        SIM_LANE(GridAccumulateNeighboursQuantised)(Result, &Sim->SearchBirds, Sim->TiledNeighbours, StartIndexId, NumIndices, Query,
+                                                    CurrBirdId);
+    }
+    else if (!Sim->BirdsInCellOrder)
+    {
+        SIM_DISPATCH_RULES(Sim->ActiveRules, SIM_LANE(GridAccumulateNeighbours),
+                           (Result, BirdArray, Grid->Indices + StartIndexId, NumIndices, BirdPosition, BirdHeading, CurrBirdId,
+                            CurrSpecies, BirdRadiusSq, AvoidRadiusSq, FovCosSq));
+    }
+    else if (Sim->TiledNeighbours)
+    {
+        SIM_DISPATCH_RULES(Sim->ActiveRules, SIM_LANE(GridAccumulateNeighboursTiled),
+                           (Result, BirdArray, StartIndexId, NumIndices, BirdPosition, BirdHeading, CurrBirdId, CurrSpecies,
+                            BirdRadiusSq, AvoidRadiusSq, FovCosSq));
+    }
+    else
+    {
+        SIM_DISPATCH_RULES(Sim->ActiveRules, SIM_LANE(GridAccumulateNeighboursSorted),
+                           (Result, BirdArray, StartIndexId, NumIndices, BirdPosition, BirdHeading, CurrBirdId, CurrSpecies,
+                            BirdRadiusSq, AvoidRadiusSq, FovCosSq));
+    }
+}
+
+inline lane_u32 SIM_LANE(GridGetCellX)(grid* Grid, lane_f32 PosX)
+{
+    lane_f32 CellX = (PosX - LaneF32(Grid->WorldBounds.Min.x)) * LaneF32(f32(Grid->NumCellsX) / AabbGetDim(Grid->WorldBounds).x);
+    lane_u32 Result = LaneFloorU32(Clamp(CellX, LaneF32(0.0f), LaneF32(f32(Grid->NumCellsX - 1))));
+    return Result;
+}
+
+inline lane_u32 SIM_LANE(GridGetCellId)(grid* Grid, lane_v2 Pos)
+{
+    lane_u32 CellX = SIM_LANE(GridGetCellX)(Grid, Pos.x);
+    lane_f32 CellYFloat = (Pos.y - LaneF32(Grid->WorldBounds.Min.y)) * LaneF32(f32(Grid->NumCellsY) / AabbGetDim(Grid->WorldBounds).y);
+    lane_u32 CellY = LaneFloorU32(Clamp(CellYFloat, LaneF32(0.0f), LaneF32(f32(Grid->NumCellsY - 1))));
+    if (Grid->CellOrder == GridCellOrder_Hashed)
+    {
+        // NOTE: Same wrap as the grid build, the floor keeps the sign and the masks wrap negative cells too
+        lane_f32 CellXFloat = (Pos.x - LaneF32(Grid->WorldBounds.Min.x)) * LaneF32(f32(Grid->NumCellsX) / AabbGetDim(Grid->WorldBounds).x);
+        CellX = LaneFloorU32(CellXFloat) & LaneU32(Grid->NumCellsX - 1);
+        CellY = LaneFloorU32(CellYFloat) & LaneU32(Grid->NumCellsY - 1);
+    }
+
+    // NOTE: Done in float like the grid build, exact for < 2^24 cells
+    lane_u32 Result = LaneFloorU32(LaneF32(CellY) * f32(Grid->NumCellsX) + LaneF32(CellX));
+    if (Grid->CellOrder == GridCellOrder_Morton)
+    {
+        for (u32 LaneId = 0; LaneId < SIM_LANE_WIDTH; ++LaneId)
+        {
+            Result.e[LaneId] = MortonEncode(CellX.e[LaneId], CellY.e[LaneId]);
+        }
+    }
+
+    return Result;
+}
+
+inline grid_row_cull SIM_LANE(GridCullRow)(sim_state* Sim, grid* Grid, grid_range Range, u32 GridY, lane_v2 BirdPosition,
+                                           lane_u32 ValidMask, lane_f32 BirdRadiusSq, lane_f32 AvoidRadiusSq, b32 FindAccepted)
+{
+    /* NOTE: Every lane's radius cuts a chord out of the row, so instead of testing cells one by one we trim the row to the
+             union of the chords and, for the accepted runs, intersect the chords of the farthest edge of the row. Bounds get a
+             small margin since birds on a cell edge can round into the neighbouring cell.
+     */
+    grid_row_cull Result = {};
+    Result.StartX = Range.StartX;
+    Result.EndX = Range.EndX;
+    
+    v2 CellDim = AabbGetDim(Grid->WorldBounds) / V2(Grid->NumCellsX, Grid->NumCellsY);
+    v2 Margin = 0.001f * CellDim;
+    lane_f32 MaxRadiusSq = Max(BirdRadiusSq, AvoidRadiusSq);
+    
+    f32 RowMinY = Grid->WorldBounds.Min.y + f32(GridY) * CellDim.y;
+    lane_f32 ToMin = LaneF32(RowMinY - Margin.y) - BirdPosition.y;
+    lane_f32 ToMax = LaneF32(RowMinY + CellDim.y + Margin.y) - BirdPosition.y;
+    // NOTE: ToMin <= ToMax, so the nearest offset is whichever is past 0 and the farthest is the larger magnitude
+    lane_f32 NearestY = Max(Max(ToMin, -ToMax), LaneF32(0.0f));
+    lane_f32 FarthestY = Max(-ToMin, ToMax);
+    lane_f32 NearestYSq = NearestY * NearestY;
+    lane_f32 FarthestYSq = FarthestY * FarthestY;
+
+    // NOTE: Reject the cells outside every lane's chord
+    lane_u32 TouchMask = ValidMask & LaneU32Cast(NearestYSq < MaxRadiusSq);
+    if (MoveMask(TouchMask) == 0)
+    {
+        Result.StartX = 1;
+        Result.EndX = 0;
+        return Result;
+    }
+    
+    {
+        lane_f32 HalfWidth = SquareRoot(Max(MaxRadiusSq - NearestYSq, LaneF32(0.0f))) + LaneF32(Margin.x);
+        lane_u32 StartX = SIM_LANE(GridGetCellX)(Grid, BirdPosition.x - HalfWidth) | ~TouchMask;
+        lane_u32 EndX = SIM_LANE(GridGetCellX)(Grid, BirdPosition.x + HalfWidth) & TouchMask;
+        Result.StartX = Max(Result.StartX, HorizontalMin(StartX));
+        Result.EndX = Min(Result.EndX, HorizontalMax(EndX));
+    }
+
+    // NOTE: Accept the cells inside every lane's bird radius chord that are either outside every avoid radius chord or inside
+    //       all of them
+    if (FindAccepted && Result.StartX <= Result.EndX && MoveMask(ValidMask & ~LaneU32Cast(FarthestYSq < BirdRadiusSq)) == 0)
+    {
+        // NOTE: The cell holding the end of a chord pokes out of it, so the run starts one cell in on both sides
+        lane_f32 HalfWidth = SquareRoot(BirdRadiusSq - FarthestYSq) - LaneF32(Margin.x);
+        lane_u32 StartX = (SIM_LANE(GridGetCellX)(Grid, BirdPosition.x - HalfWidth) + LaneU32(1)) & ValidMask;
+        lane_u32 OnePastEndX = SIM_LANE(GridGetCellX)(Grid, BirdPosition.x + HalfWidth) | ~ValidMask;
+        u32 AcceptStartX = Max(Result.StartX, HorizontalMax(StartX));
+        u32 AcceptOnePastEndX = Min(Result.EndX + 1, HorizontalMin(OnePastEndX));
+
+        u32 AvoidStartX = Grid->NumCellsX;
+        u32 AvoidOnePastEndX = Grid->NumCellsX;
+        lane_u32 AvoidMask = ValidMask & LaneU32Cast(NearestYSq < AvoidRadiusSq);
+        if (MoveMask(AvoidMask) != 0)
+        {
+            lane_f32 AvoidHalfWidth = SquareRoot(Max(AvoidRadiusSq - NearestYSq, LaneF32(0.0f))) + LaneF32(Margin.x);
+            AvoidStartX = HorizontalMin(SIM_LANE(GridGetCellX)(Grid, BirdPosition.x - AvoidHalfWidth) | ~AvoidMask);
+            AvoidOnePastEndX = HorizontalMax(SIM_LANE(GridGetCellX)(Grid, BirdPosition.x + AvoidHalfWidth) & AvoidMask) + 1;
+        }
+
+        // NOTE: Same as the bird radius, the cells inside every lane's avoid chord at the farthest edge of the row. They lie
+        //       inside the union of the avoid chords, so the runs stay in order
+        u32 AvoidInsideStartX = AcceptOnePastEndX;
+        u32 AvoidInsideOnePastEndX = AcceptOnePastEndX;
+        if (MoveMask(ValidMask & ~LaneU32Cast(FarthestYSq < AvoidRadiusSq)) == 0)
+        {
+            lane_f32 AvoidHalfWidth = SquareRoot(AvoidRadiusSq - FarthestYSq) - LaneF32(Margin.x);
+            lane_u32 InsideStartX = (SIM_LANE(GridGetCellX)(Grid, BirdPosition.x - AvoidHalfWidth) + LaneU32(1)) & ValidMask;
+            lane_u32 InsideOnePastEndX = SIM_LANE(GridGetCellX)(Grid, BirdPosition.x + AvoidHalfWidth) | ~ValidMask;
+            AvoidInsideStartX = Max(AcceptStartX, HorizontalMax(InsideStartX));
+            AvoidInsideOnePastEndX = Min(AcceptOnePastEndX, HorizontalMin(InsideOnePastEndX));
+        }
+
+        // NOTE: The avoid chords split the accepted cells into a run on either side, and a run in the middle if every lane's
+        //       chord covers it
+        u32 LeftOnePastEndX = Min(AcceptOnePastEndX, AvoidStartX);
+        if (AcceptStartX < LeftOnePastEndX)
+        {
+            Result.AcceptStartX[Result.NumAccepted] = AcceptStartX;
+            Result.AcceptOnePastEndX[Result.NumAccepted] = LeftOnePastEndX;
+            Result.AcceptInsideAvoid[Result.NumAccepted] = false;
+            Result.NumAccepted += 1;
+        }
+
+        if (AvoidInsideStartX < AvoidInsideOnePastEndX)
+        {
+            Result.AcceptStartX[Result.NumAccepted] = AvoidInsideStartX;
+            Result.AcceptOnePastEndX[Result.NumAccepted] = AvoidInsideOnePastEndX;
+            Result.AcceptInsideAvoid[Result.NumAccepted] = true;
+            Result.NumAccepted += 1;
+        }
+        
+        u32 RightStartX = Max(AcceptStartX, AvoidOnePastEndX);
+        if (RightStartX < AcceptOnePastEndX)
+        {
+            Result.AcceptStartX[Result.NumAccepted] = RightStartX;
+            Result.AcceptOnePastEndX[Result.NumAccepted] = AcceptOnePastEndX;
+            Result.AcceptInsideAvoid[Result.NumAccepted] = false;
+            Result.NumAccepted += 1;
+        }
+    }
+
+    return Result;
+}
+
+inline void SIM_LANE(AccumulateSum)(SIM_LANE(bird_average_data)* Result, grid_cell_sum Sum, u32 StartBirdId, u32 NumBirds,
+                                    lane_v2 BirdPosition, lane_v2 BirdVelocity, lane_u32 CurrBirdId, lane_f32 InsideAvoidMask)
+{
+    // NOTE: Take out the current bird if it lives in these slots
+    lane_u32 SelfMask = ~(CurrBirdId < LaneU32(StartBirdId)) & (CurrBirdId < LaneU32(StartBirdId + NumBirds)) & LaneU32(0x1);
+    lane_f32 SelfMaskFloat = LaneF32(SelfMask);
+    Result->NumBirdsInRadius += LaneU32(NumBirds) - SelfMask;
+    Result->AvgFlockDir += LaneV2(Sum.VelX, Sum.VelY) - SelfMaskFloat * BirdVelocity;
+    Result->AvgFlockPos += LaneV2(Sum.PosX, Sum.PosY) - SelfMaskFloat * BirdPosition;
+
+    // NOTE: Lanes (1 or 0) with every bird inside the avoid radius avoid them all, which is the sum of BirdPosition - Pos. The
+    //       current bird adds nothing to it
+    Result->AvgFlockAvoidance += InsideAvoidMask * (LaneF32(f32(NumBirds)) * BirdPosition - LaneV2(Sum.PosX, Sum.PosY));
+}
+
+inline void SIM_LANE(GridAccumulateAccepted)(SIM_LANE(bird_average_data)* Result, grid* Grid, u32 StartCellId, u32 OnePastEndCellId,
+                                             lane_v2 BirdPosition, lane_v2 BirdVelocity, lane_u32 CurrBirdId, b32 InsideAvoid)
+{
+    // NOTE: Every bird in these cells is inside the bird radius and on the same side of the avoid radius for every lane, so
+    //       they add the same sums to every lane without any per pair tests
+    u32 StartBirdId = Grid->CellStart[StartCellId];
+    u32 NumBirds = Grid->CellStart[OnePastEndCellId - 1] + Grid->CellCount[OnePastEndCellId - 1] - StartBirdId;
+    if (NumBirds == 0)
+    {
+        return;
+    }
+    
+    grid_cell_sum Sum = {};
+    for (u32 CellId = StartCellId; CellId < OnePastEndCellId; ++CellId)
+    {
+        Sum.PosX += Grid->CellSums[CellId].PosX;
+        Sum.PosY += Grid->CellSums[CellId].PosY;
+        Sum.VelX += Grid->CellSums[CellId].VelX;
+        Sum.VelY += Grid->CellSums[CellId].VelY;
+    }
+
+    SIM_LANE(AccumulateSum)(Result, Sum, StartBirdId, NumBirds, BirdPosition, BirdVelocity, CurrBirdId, LaneF32(InsideAvoid ? 1.0f : 0.0f));
+}
+
+inline void SIM_LANE(GetBoxDistancesSq)(v2 BoxMin, v2 BoxMax, lane_v2 BirdPosition, lane_f32* NearestSq, lane_f32* FarthestSq)
+{
+    // NOTE: Squared distance from every lane's bird to the nearest and the farthest point of the box
+    lane_v2 ToMin = LaneV2(BoxMin.x, BoxMin.y) - BirdPosition;
+    lane_v2 ToMax = LaneV2(BoxMax.x, BoxMax.y) - BirdPosition;
+    lane_v2 Nearest = LaneV2(Max(Max(ToMin.x, -ToMax.x), LaneF32(0.0f)), Max(Max(ToMin.y, -ToMax.y), LaneF32(0.0f)));
+    lane_v2 Farthest = LaneV2(Max(-ToMin.x, ToMax.x), Max(-ToMin.y, ToMax.y));
+    *NearestSq = LengthSquared(Nearest);
+    *FarthestSq = LengthSquared(Farthest);
+}
+
+inline void SIM_LANE(GridAccumulateSplitCell)(sim_state* Sim, grid* Grid, SIM_LANE(bird_average_data)* Result,
+                                              bird_array BirdArray, u32 CellX, u32 CellY, u32 CellId, lane_v2 BirdPosition,
+                                              lane_v2 BirdVelocity, lane_v2 BirdHeading, lane_u32 CurrBirdId, lane_u32 CurrSpecies,
+                                              lane_u32 ValidMask, lane_f32 BirdRadiusSq, lane_f32 AvoidRadiusSq,
+                                              SIM_LANE(quantised_query)* Query)
+{
+    // NOTE: Every sub cell gets the far field node tests, the sub cells that need per bird tests merge into runs of slots
+    grid_cell_split* Split = Grid->CellSplits + Grid->CellSplitIds[CellId];
+    u32 CellStartId = Grid->CellStart[CellId];
+    lane_f32 MaxRadiusSq = Max(BirdRadiusSq, AvoidRadiusSq);
+    lane_u32 IgnoreMask = ~ValidMask;
+    v2 CellDim = AabbGetDim(Grid->WorldBounds) / V2(Grid->NumCellsX, Grid->NumCellsY);
+    v2 SubCellDim = CellDim / f32(GRID_SPLIT_DIM);
+    v2 Margin = 0.001f * CellDim;
+    v2 CellMin = Grid->WorldBounds.Min + V2(f32(CellX), f32(CellY)) * CellDim;
+    
+    u32 RunStartId = 0;
+    u32 RunEndId = 0;
+    for (u32 SubCellId = 0; SubCellId < GRID_SPLIT_NUM_CELLS; ++SubCellId)
+    {
+        u32 StartBirdId = CellStartId + Split->SubCellStart[SubCellId];
+        u32 EndBirdId = CellStartId + Split->SubCellStart[SubCellId + 1];
+        if (StartBirdId == EndBirdId)
+        {
+            continue;
+        }
+
+        // NOTE: Birds outside the world are clamped into the edge cells, so sub cells on the edge of the world reach out forever
+        u32 SubX = SubCellId % GRID_SPLIT_DIM;
+        u32 SubY = SubCellId / GRID_SPLIT_DIM;
+        v2 SubCellMin = CellMin + V2(f32(SubX), f32(SubY)) * SubCellDim - Margin;
+        v2 SubCellMax = SubCellMin + SubCellDim + 2.0f * Margin;
+        SubCellMin.x = CellX == 0 && SubX == 0 ? -SIM_ADAPTIVE_EDGE : SubCellMin.x;
+        SubCellMin.y = CellY == 0 && SubY == 0 ? -SIM_ADAPTIVE_EDGE : SubCellMin.y;
+        SubCellMax.x = CellX == Grid->NumCellsX - 1 && SubX == GRID_SPLIT_DIM - 1 ? SIM_ADAPTIVE_EDGE : SubCellMax.x;
+        SubCellMax.y = CellY == Grid->NumCellsY - 1 && SubY == GRID_SPLIT_DIM - 1 ? SIM_ADAPTIVE_EDGE : SubCellMax.y;
+        
+        lane_f32 NearestSq;
+        lane_f32 FarthestSq;
+        SIM_LANE(GetBoxDistancesSq)(SubCellMin, SubCellMax, BirdPosition, &NearestSq, &FarthestSq);
+        if (MoveMask(ValidMask & LaneU32Cast(NearestSq < MaxRadiusSq)) == 0)
+        {
+            continue;
+        }
+
+        lane_u32 InsideAvoidMask = LaneU32Cast(FarthestSq < AvoidRadiusSq);
+        lane_u32 AcceptMask = LaneU32Cast(FarthestSq < BirdRadiusSq) & (~LaneU32Cast(NearestSq < AvoidRadiusSq) | InsideAvoidMask);
+        if (MoveMask(AcceptMask | IgnoreMask) == SIM_LANE_MASK)
+        {
+            SIM_LANE(AccumulateSum)(Result, Split->SubCellSums[SubCellId], StartBirdId, EndBirdId - StartBirdId, BirdPosition,
+                                    BirdVelocity, CurrBirdId, LaneF32(InsideAvoidMask & LaneU32(0x1)));
+            continue;
+        }
+
+        if (StartBirdId != RunEndId)
+        {
+            if (RunEndId > RunStartId)
+            {
+                SIM_LANE(GridAccumulateIndexRange)(Sim, Grid, Result, BirdArray, RunStartId, RunEndId, BirdPosition, BirdHeading,
+                                                   CurrBirdId, CurrSpecies, BirdRadiusSq, AvoidRadiusSq, Query);
+            }
+            RunStartId = StartBirdId;
+        }
+        RunEndId = EndBirdId;
+    }
+
+    if (RunEndId > RunStartId)
+    {
+        SIM_LANE(GridAccumulateIndexRange)(Sim, Grid, Result, BirdArray, RunStartId, RunEndId, BirdPosition, BirdHeading,
+                                           CurrBirdId, CurrSpecies, BirdRadiusSq, AvoidRadiusSq, Query);
+    }
+}
+
+inline void SIM_LANE(GridAccumulateRowCells)(sim_state* Sim, grid* Grid, SIM_LANE(bird_average_data)* Result,
+                                             bird_array BirdArray, u32 GridY, u32 StartX, u32 OnePastEndX, lane_v2 BirdPosition,
+                                             lane_v2 BirdVelocity, lane_v2 BirdHeading, lane_u32 CurrBirdId, lane_u32 CurrSpecies,
+                                             lane_u32 ValidMask, lane_f32 BirdRadiusSq, lane_f32 AvoidRadiusSq,
+                                             SIM_LANE(quantised_query)* Query)
+{
+    // NOTE: Cells in a row major row are contiguous, so everything between split cells is one linear scan
+    u32 RowCellId = GridY * Grid->NumCellsX;
+    u32 ScanStartX = StartX;
+    for (u32 GridX = StartX; GridX <= OnePastEndX; ++GridX)
+    {
+        b32 IsSplit = GridX < OnePastEndX && Grid->CellSplitIds && Grid->CellSplitIds[RowCellId + GridX] != GRID_CELL_NOT_SPLIT;
+        if (GridX < OnePastEndX && !IsSplit)
+        {
+            continue;
+        }
+
+        if (ScanStartX < GridX)
+        {
+            u32 StartCellId = RowCellId + ScanStartX;
+            u32 EndCellId = RowCellId + GridX - 1;
+            u32 StartIndexId = Grid->CellStart[StartCellId];
+            u32 EndIndexId = Grid->CellStart[EndCellId] + Grid->CellCount[EndCellId];
+            SIM_LANE(GridAccumulateIndexRange)(Sim, Grid, Result, BirdArray, StartIndexId, EndIndexId, BirdPosition, BirdHeading,
+                                               CurrBirdId, CurrSpecies, BirdRadiusSq, AvoidRadiusSq, Query);
+        }
+
+        if (IsSplit)
+        {
+            SIM_LANE(GridAccumulateSplitCell)(Sim, Grid, Result, BirdArray, GridX, GridY, RowCellId + GridX, BirdPosition,
+                                              BirdVelocity, BirdHeading, CurrBirdId, CurrSpecies, ValidMask,
+                                              BirdRadiusSq, AvoidRadiusSq, Query);
+        }
+        ScanStartX = GridX + 1;
+    }
+}
+
+inline SIM_LANE(bird_average_data) SIM_LANE(GridGetAverageDataFarField)(sim_state* Sim, grid* Grid, bird_array BirdArray,
+                                                                        lane_v2 BirdPosition, lane_v2 BirdVelocity,
+                                                                        lane_v2 BirdHeading, lane_u32 CurrBirdId,
+                                                                        lane_u32 CurrSpecies, lane_u32 ValidMask)
+{
+    SIM_LANE(bird_average_data) Result = {};
+
+    lane_f32 BirdRadiusSq = LaneF32(Sim->BirdRadiusSq);
+    lane_f32 AvoidRadiusSq = LaneF32(Sim->AvoidRadiusSq);
+    lane_f32 MaxRadiusSq = LaneF32(Max(Sim->BirdRadiusSq, Sim->AvoidRadiusSq));
+    SIM_LANE(quantised_query) QuantisedQuery = {};
+    SIM_LANE(quantised_query)* Query = 0;
+    if (Sim->SearchBirds.Pos)
+    {
+        QuantisedQuery = SIM_LANE(QuantiseQuery)(&Sim->SearchBirds, BirdPosition);
+        Query = &QuantisedQuery;
+    }
+
+    // NOTE: Empty lanes never touch a node, and never stop one from being accepted
+    lane_u32 IgnoreMask = ~ValidMask;
+    v2 CellDim = AabbGetDim(Grid->WorldBounds) / V2(Grid->NumCellsX, Grid->NumCellsY);
+    v2 Margin = 0.001f * CellDim;
+
+    // NOTE: Nodes are (level, first cell x, first cell y), children are pushed in reverse so that we pop them in Morton order,
+    //       which keeps the slots of the leaves we scan increasing so neighbouring leaves merge into one run
+    u32 StackLevel[4 * GRID_MAX_NODE_LEVELS];
+    u32 StackX[4 * GRID_MAX_NODE_LEVELS];
+    u32 StackY[4 * GRID_MAX_NODE_LEVELS];
+    u32 StackSize = 1;
+    StackLevel[0] = Grid->NumNodeLevels - 1;
+    StackX[0] = 0;
+    StackY[0] = 0;
+
+    u32 RunStartId = 0;
+    u32 RunEndId = 0;
+    while (StackSize > 0)
+    {
+        StackSize -= 1;
+        u32 Level = StackLevel[StackSize];
+        u32 NodeX = StackX[StackSize];
+        u32 NodeY = StackY[StackSize];
+        u32 NodeDim = 1 << Level;
+        u32 StartCellId = MortonEncode(NodeX, NodeY);
+        u32 LastCellId = StartCellId + NodeDim * NodeDim - 1;
+        u32 StartBirdId = Grid->CellStart[StartCellId];
+        u32 EndBirdId = Grid->CellStart[LastCellId] + Grid->CellCount[LastCellId];
+        if (StartBirdId == EndBirdId)
+        {
+            continue;
+        }
+
+        // NOTE: Birds outside the world are clamped into the edge cells, so nodes on the edge reach out forever
+        v2 NodeMin = Grid->WorldBounds.Min + V2(f32(NodeX), f32(NodeY)) * CellDim - Margin;
+        v2 NodeMax = NodeMin + f32(NodeDim) * CellDim + 2.0f * Margin;
+        NodeMin.x = NodeX == 0 ? -SIM_FAR_FIELD_EDGE : NodeMin.x;
+        NodeMin.y = NodeY == 0 ? -SIM_FAR_FIELD_EDGE : NodeMin.y;
+        NodeMax.x = NodeX + NodeDim == Grid->NumCellsX ? SIM_FAR_FIELD_EDGE : NodeMax.x;
+        NodeMax.y = NodeY + NodeDim == Grid->NumCellsY ? SIM_FAR_FIELD_EDGE : NodeMax.y;
+        
+        lane_f32 NearestSq;
+        lane_f32 FarthestSq;
+        SIM_LANE(GetBoxDistancesSq)(NodeMin, NodeMax, BirdPosition, &NearestSq, &FarthestSq);
+
+        lane_u32 TouchMask = ValidMask & LaneU32Cast(NearestSq < MaxRadiusSq);
+        if (MoveMask(TouchMask) == 0)
+        {
+            continue;
+        }
+
+        lane_u32 InsideAvoidMask = LaneU32Cast(FarthestSq < AvoidRadiusSq);
+        lane_u32 AcceptMask = LaneU32Cast(FarthestSq < BirdRadiusSq) & (~LaneU32Cast(NearestSq < AvoidRadiusSq) | InsideAvoidMask);
+        if (MoveMask(AcceptMask | IgnoreMask) == SIM_LANE_MASK)
+        {
+            u32 NodeId = StartCellId >> (2 * Level);
+            SIM_LANE(AccumulateSum)(&Result, Grid->NodeSums[Level][NodeId], StartBirdId, EndBirdId - StartBirdId, BirdPosition,
+                                    BirdVelocity, CurrBirdId, LaneF32(InsideAvoidMask & LaneU32(0x1)));
+            continue;
+        }
+
+        // NOTE: Splitting a node that holds only a few birds costs more than testing them all, so we treat it as a leaf
+        if (Level > 0 && EndBirdId - StartBirdId > SIM_FAR_FIELD_MAX_LEAF_BIRDS)
+        {
+            u32 ChildDim = NodeDim / 2;
+            for (u32 ChildId = 4; ChildId > 0; --ChildId)
+            {
+                StackLevel[StackSize] = Level - 1;
+                StackX[StackSize] = NodeX + ((ChildId - 1) & 1) * ChildDim;
+                StackY[StackSize] = NodeY + ((ChildId - 1) >> 1) * ChildDim;
+                StackSize += 1;
+            }
+            continue;
+        }
+
+        // NOTE: A leaf on the edge of a radius, its birds get tested one by one
+        if (StartBirdId != RunEndId)
+        {
+            if (RunEndId > RunStartId)
+            {
+                SIM_LANE(GridAccumulateIndexRange)(Sim, Grid, &Result, BirdArray, RunStartId, RunEndId, BirdPosition, BirdHeading,
+                                                   CurrBirdId, CurrSpecies, BirdRadiusSq, AvoidRadiusSq, Query);
+            }
+            RunStartId = StartBirdId;
+        }
+        RunEndId = EndBirdId;
+    }
+
+    if (RunEndId > RunStartId)
+    {
+        SIM_LANE(GridAccumulateIndexRange)(Sim, Grid, &Result, BirdArray, RunStartId, RunEndId, BirdPosition, BirdHeading,
+                                           CurrBirdId, CurrSpecies, BirdRadiusSq, AvoidRadiusSq, Query);
+    }
+
+    return Result;
+}
+
+inline SIM_LANE(bird_average_data) SIM_LANE(GridGetAverageData)(sim_state* Sim, grid* Grid, bird_array BirdArray,
+                                                                lane_v2 BirdPosition, lane_v2 BirdVelocity, lane_v2 BirdHeading,
+                                                                lane_u32 CurrBirdId, lane_u32 ValidMask,
+                                                                SIM_LANE(bird_params)* Params)
+{
+    lane_u32 CurrSpecies = Params->Species;
+    if (Grid->NumNodeLevels)
+    {
+        return SIM_LANE(GridGetAverageDataFarField)(Sim, Grid, BirdArray, BirdPosition, BirdVelocity, BirdHeading, CurrBirdId,
+                                                    CurrSpecies, ValidMask);
+    }
+    
+    SIM_LANE(bird_average_data) Result = {};
+
+    lane_f32 BirdRadiusSq = Params->BirdRadiusSq;
+    lane_f32 AvoidRadiusSq = Params->AvoidRadiusSq;
+    lane_f32 MaxRadius = LaneF32(SquareRoot(SimGetSearchRadiusSq(Sim)));
+    grid_range Range = SIM_LANE(GridGetRange)(Grid, BirdPosition, MaxRadius, ValidMask);
+
+    // NOTE: Only set while the search uses the 16 bit copies of the birds
+    SIM_LANE(quantised_query) QuantisedQuery = {};
+    SIM_LANE(quantised_query)* Query = 0;
+    if (Sim->SearchBirds.Pos)
+    {
+        QuantisedQuery = SIM_LANE(QuantiseQuery)(&Sim->SearchBirds, BirdPosition);
+        Query = &QuantisedQuery;
+    }
+    if (Grid->CellOrder == GridCellOrder_Hashed)
+    {
+        // NOTE: Hashed rows are contiguous like row major ones, but a range can wrap past the end of a row and split into two
+        //       scans. Birds from far away cells that share a slot get rejected by the distance tests
+        Assert(Grid->Layout == GridLayout_Compact);
+        for (u32 OffsetY = 0; OffsetY <= Range.EndY - Range.StartY; ++OffsetY)
+        {
+            u32 GridY = (Range.StartY + OffsetY) & (Grid->NumCellsY - 1);
+            u32 StartX = Range.StartX & (Grid->NumCellsX - 1);
+            u32 NumCellsInRange = Range.EndX - Range.StartX + 1;
+            u32 NumCellsBeforeWrap = Min(NumCellsInRange, Grid->NumCellsX - StartX);
+            SIM_LANE(GridAccumulateRowCells)(Sim, Grid, &Result, BirdArray, GridY, StartX, StartX + NumCellsBeforeWrap,
+                                             BirdPosition, BirdVelocity, BirdHeading, CurrBirdId, CurrSpecies, ValidMask,
+                                             BirdRadiusSq, AvoidRadiusSq, Query);
+            if (NumCellsInRange > NumCellsBeforeWrap)
+            {
+                SIM_LANE(GridAccumulateRowCells)(Sim, Grid, &Result, BirdArray, GridY, 0, NumCellsInRange - NumCellsBeforeWrap,
+                                                 BirdPosition, BirdVelocity, BirdHeading, CurrBirdId, CurrSpecies, ValidMask,
+                                                 BirdRadiusSq, AvoidRadiusSq, Query);
+            }
+        }
+
+        return Result;
+    }
+    
+    for (u32 GridY = Range.StartY; GridY <= Range.EndY; ++GridY)
+    {
+        grid_row_cull Row = {};
+        Row.StartX = Range.StartX;
+        Row.EndX = Range.EndX;
+
+        // NOTE: Culling splits the row into more scans, which only pays off when the row holds enough birds
+        b32 CullRow = Sim->UseCellCulling;
+        if (CullRow && Grid->Layout == GridLayout_Compact && Grid->CellOrder == GridCellOrder_RowMajor)
+        {
+            u32 StartCellId = GridY * Grid->NumCellsX + Range.StartX;
+            u32 EndCellId = GridY * Grid->NumCellsX + Range.EndX;
+            CullRow = Grid->CellStart[EndCellId] + Grid->CellCount[EndCellId] - Grid->CellStart[StartCellId] >= SIM_CULL_MIN_ROW_BIRDS;
+        }
+        
+        if (CullRow)
+        {
+            b32 FindAccepted = Grid->CellSums != 0;
+            Row = SIM_LANE(GridCullRow)(Sim, Grid, Range, GridY, BirdPosition, ValidMask, BirdRadiusSq, AvoidRadiusSq, FindAccepted);
+            if (Row.StartX > Row.EndX)
+            {
+                continue;
+            }
+        }
+        
+        if (Grid->Layout == GridLayout_Compact && Grid->CellOrder == GridCellOrder_Morton)
+        {
+            // NOTE: A row isn't contiguous in Morton order, but neighbouring Morton ids (and empty cells between them) still
+            //       are, so we merge cells into runs and only scan when a run breaks
+            u32 RunStartId = 0;
+            u32 RunEndId = 0;
+            u32 CellId = MortonEncode(Row.StartX, GridY);
+            for (u32 GridX = Row.StartX; GridX <= Row.EndX + 1; ++GridX)
+            {
+                u32 CellStartId = RunEndId + 1;
+                u32 CellEndId = CellStartId;
+                if (GridX <= Row.EndX)
+                {
+                    CellStartId = Grid->CellStart[CellId];
+                    CellEndId = CellStartId + Grid->CellCount[CellId];
+                    if (Grid->CellSplitIds && Grid->CellSplitIds[CellId] != GRID_CELL_NOT_SPLIT)
+                    {
+                        // NOTE: Split cells end the run, the next one can start right after them
+                        if (RunEndId > RunStartId)
+                        {
+                            SIM_LANE(GridAccumulateIndexRange)(Sim, Grid, &Result, BirdArray, RunStartId, RunEndId, BirdPosition,
+                                                               BirdHeading, CurrBirdId, CurrSpecies, BirdRadiusSq, AvoidRadiusSq, Query);
+                        }
+                        SIM_LANE(GridAccumulateSplitCell)(Sim, Grid, &Result, BirdArray, GridX, GridY, CellId, BirdPosition,
+                                                          BirdVelocity, BirdHeading, CurrBirdId, CurrSpecies, ValidMask,
+                                                          BirdRadiusSq, AvoidRadiusSq, Query);
+                        RunStartId = CellEndId;
+                        RunEndId = CellEndId;
+                        CellId = MortonIncrementX(CellId);
+                        continue;
+                    }
+                    CellId = MortonIncrementX(CellId);
+                }
+
+                if (CellStartId == RunEndId)
+                {
+                    RunEndId = CellEndId;
+                    continue;
+                }
+
+                if (RunEndId > RunStartId)
+                {
+                    SIM_LANE(GridAccumulateIndexRange)(Sim, Grid, &Result, BirdArray, RunStartId, RunEndId, BirdPosition,
+                                                       BirdHeading, CurrBirdId, CurrSpecies, BirdRadiusSq, AvoidRadiusSq, Query);
+                }
+                
+                RunStartId = CellStartId;
+                RunEndId = CellEndId;
+            }
+
+            continue;
+        }
+        
+        if (Grid->Layout == GridLayout_Compact)
+        {
+            // NOTE: Cells in a row are contiguous so everything between the accepted runs is one linear scan, apart from split cells
+            u32 RowCellId = GridY * Grid->NumCellsX;
+            u32 GridX = Row.StartX;
+            for (u32 RunId = 0; RunId <= Row.NumAccepted; ++RunId)
+            {
+                u32 ScanOnePastEndX = RunId < Row.NumAccepted ? Row.AcceptStartX[RunId] : Row.EndX + 1;
+                if (GridX < ScanOnePastEndX)
+                {
+                    SIM_LANE(GridAccumulateRowCells)(Sim, Grid, &Result, BirdArray, GridY, GridX, ScanOnePastEndX, BirdPosition,
+                                                     BirdVelocity, BirdHeading, CurrBirdId, CurrSpecies, ValidMask,
+                                                     BirdRadiusSq, AvoidRadiusSq, Query);
+                }
+
+                if (RunId < Row.NumAccepted)
+                {
+                    SIM_LANE(GridAccumulateAccepted)(&Result, Grid, RowCellId + Row.AcceptStartX[RunId],
+                                                     RowCellId + Row.AcceptOnePastEndX[RunId], BirdPosition, BirdVelocity, CurrBirdId,
+                                                     Row.AcceptInsideAvoid[RunId]);
+                    GridX = Row.AcceptOnePastEndX[RunId];
+                }
+            }
+            
+            continue;
+        }
+        
+        for (u32 GridX = Row.StartX; GridX <= Row.EndX; ++GridX)
+        {
+            grid_cell* CurrCell = Grid->Cells + GridGetCellId(Grid, GridX, GridY);
+
+            // NOTE: Loop over all birds in the grid
+            u32 GlobalIndexId = 0;
+            for (block* CurrBlock = CurrCell->IndexArena.Next; CurrBlock; CurrBlock = CurrBlock->Next)
+            {
+                u32* BlockIndices = BlockGetData(CurrBlock, u32);
+                u32 NumIndicesInBlock = Min(CurrCell->NumIndices - GlobalIndexId, Grid->MaxNumIndicesPerBlock);
+                SIM_DISPATCH_RULES(Sim->ActiveRules, SIM_LANE(GridAccumulateNeighbours),
+                                   (&Result, BirdArray, BlockIndices, NumIndicesInBlock, BirdPosition, BirdHeading, CurrBirdId,
+                                    CurrSpecies, BirdRadiusSq, AvoidRadiusSq, LaneF32(SimGetFovCosSq(Sim))));
+                GlobalIndexId += NumIndicesInBlock;
+            }
+        }
+    }
+
+    return Result;
+}
+
+//
+// NOTE: Half Stencil
+//
+
+inline void SIM_LANE(AccumulatePairsDiagonal)(SIM_LANE(bird_average_data)* Result, lane_v2 BirdPosition, lane_v2 BirdVelocity,
+                                              lane_f32 BirdRadiusSq, lane_f32 AvoidRadiusSq)
+{
+    // NOTE: Pairs inside the packet are tested from both sides, rotation 0 would pair every bird with itself
+    lane_v2 NearbyBirdPos = BirdPosition;
+    lane_v2 NearbyBirdVel = BirdVelocity;
+    for (u32 RotationId = 1; RotationId < SIM_LANE_WIDTH; ++RotationId)
+    {
+        NearbyBirdPos = RotateLanes(NearbyBirdPos);
+        NearbyBirdVel = RotateLanes(NearbyBirdVel);
+
+        lane_v2 DistanceVec = NearbyBirdPos - BirdPosition;
+        lane_f32 DistanceSq = LengthSquared(DistanceVec);
+
+        lane_u32 BirdRadiusMask = LaneU32Cast(DistanceSq < BirdRadiusSq) & LaneU32(0x1);
+        lane_f32 BirdRadiusMaskFloat = LaneF32(BirdRadiusMask);
+        Result->NumBirdsInRadius += BirdRadiusMask;
+        Result->AvgFlockDir += BirdRadiusMaskFloat * NearbyBirdVel;
+        Result->AvgFlockPos += BirdRadiusMaskFloat * NearbyBirdPos;
+
+        lane_f32 AvoidRadiusMaskFloat = LaneF32(LaneU32Cast(DistanceSq < AvoidRadiusSq) & LaneU32(0x1));
+        Result->AvgFlockAvoidance += AvoidRadiusMaskFloat * (-DistanceVec);
+    }
+}
+
+inline void SIM_LANE(AddToAccumulators)(bird_accumulator_array* Accumulators, u32 FirstBirdId, SIM_LANE(bird_average_data)* Data,
+                                        u32 NumValid)
+{
+    lane_f32 NumBirdsInRadius = LaneF32(Data->NumBirdsInRadius);
+    if (NumValid == SIM_LANE_WIDTH)
+    {
+        f32* Dests[] =
+        {
+            Accumulators->NumBirdsInRadius, Accumulators->FlockDirX, Accumulators->FlockDirY, Accumulators->FlockPosX,
+            Accumulators->FlockPosY, Accumulators->AvoidanceX, Accumulators->AvoidanceY,
+        };
+        lane_f32 Values[] =
+        {
+            NumBirdsInRadius, Data->AvgFlockDir.x, Data->AvgFlockDir.y, Data->AvgFlockPos.x, Data->AvgFlockPos.y,
+            Data->AvgFlockAvoidance.x, Data->AvgFlockAvoidance.y,
+        };
+        for (u32 ValueId = 0; ValueId < ArrayCount(Values); ++ValueId)
+        {
+            f32* Dest = Dests[ValueId] + FirstBirdId;
+            StoreUnAligned(LaneF32LoadUnAligned(Dest) + Values[ValueId], Dest);
+        }
+        return;
+    }
+
+    // NOTE: Empty lanes of a packet can hold garbage from testing each other, so partial packets only add their valid lanes
+    for (u32 LaneId = 0; LaneId < NumValid; ++LaneId)
+    {
+        u32 BirdId = FirstBirdId + LaneId;
+        Accumulators->NumBirdsInRadius[BirdId] += NumBirdsInRadius.e[LaneId];
+        Accumulators->FlockDirX[BirdId] += Data->AvgFlockDir.x.e[LaneId];
+        Accumulators->FlockDirY[BirdId] += Data->AvgFlockDir.y.e[LaneId];
+        Accumulators->FlockPosX[BirdId] += Data->AvgFlockPos.x.e[LaneId];
+        Accumulators->FlockPosY[BirdId] += Data->AvgFlockPos.y.e[LaneId];
+        Accumulators->AvoidanceX[BirdId] += Data->AvgFlockAvoidance.x.e[LaneId];
+        Accumulators->AvoidanceY[BirdId] += Data->AvgFlockAvoidance.y.e[LaneId];
+    }
+}
+
+inline void SIM_LANE(MoveInvalidLanesAway)(lane_v2* Position, lane_v2* Velocity, u32 NumValid, f32 FarAway)
+{
+    lane_f32 LaneIndex = LaneF32(LaneU32Index());
+    lane_f32 ValidMask = LaneIndex < LaneF32(f32(NumValid));
+    lane_f32 InvalidMask = LaneIndex >= LaneF32(f32(NumValid));
+    Position->x = (Position->x & ValidMask) + (InvalidMask & LaneF32(FarAway));
+    Position->y = (Position->y & ValidMask) + (InvalidMask & LaneF32(FarAway));
+    Velocity->x = Velocity->x & ValidMask;
+    Velocity->y = Velocity->y & ValidMask;
+}
+
+inline void SIM_LANE(AccumulatePairsRange)(SIM_LANE(bird_average_data)* Result, bird_accumulator_array* Accumulators,
+                                           bird_array BirdArray, u32 StartBirdId, u32 EndBirdId, lane_v2 BirdPosition,
+                                           lane_v2 BirdVelocity, lane_f32 BirdRadiusSq, lane_f32 AvoidRadiusSq)
+{
+    // NOTE: Like the tiled kernel, except the neighbours carry their own sums through the rotations. After a full turn those
+    //       line up with the neighbours again and get added to their slots
+    for (u32 FirstBirdId = StartBirdId; FirstBirdId < EndBirdId; FirstBirdId += SIM_LANE_WIDTH)
+    {
+        lane_v2 NearbyBirdPos = LaneV2LoadUnAligned(BirdArray.PosX + FirstBirdId, BirdArray.PosY + FirstBirdId);
+        lane_v2 NearbyBirdVel = LaneV2LoadUnAligned(BirdArray.VelX + FirstBirdId, BirdArray.VelY + FirstBirdId);
+        u32 NumValid = Min(u32(SIM_LANE_WIDTH), EndBirdId - FirstBirdId);
+        if (NumValid < SIM_LANE_WIDTH)
+        {
+            SIM_LANE(MoveInvalidLanesAway)(&NearbyBirdPos, &NearbyBirdVel, NumValid, -SIM_HALF_STENCIL_FAR_AWAY);
+        }
+
+        SIM_LANE(bird_average_data) Nearby = {};
+        for (u32 RotationId = 0; RotationId < SIM_LANE_WIDTH; ++RotationId)
+        {
+            lane_v2 DistanceVec = NearbyBirdPos - BirdPosition;
+            lane_f32 DistanceSq = LengthSquared(DistanceVec);
+
+            lane_u32 BirdRadiusMask = LaneU32Cast(DistanceSq < BirdRadiusSq) & LaneU32(0x1);
+            lane_f32 BirdRadiusMaskFloat = LaneF32(BirdRadiusMask);
+            Result->NumBirdsInRadius += BirdRadiusMask;
+            Result->AvgFlockDir += BirdRadiusMaskFloat * NearbyBirdVel;
+            Result->AvgFlockPos += BirdRadiusMaskFloat * NearbyBirdPos;
+            Nearby.NumBirdsInRadius += BirdRadiusMask;
+            Nearby.AvgFlockDir += BirdRadiusMaskFloat * BirdVelocity;
+            Nearby.AvgFlockPos += BirdRadiusMaskFloat * BirdPosition;
+
+            lane_v2 AvoidanceVec = LaneF32(LaneU32Cast(DistanceSq < AvoidRadiusSq) & LaneU32(0x1)) * DistanceVec;
+            Result->AvgFlockAvoidance += -AvoidanceVec;
+            Nearby.AvgFlockAvoidance += AvoidanceVec;
+
+            NearbyBirdPos = RotateLanes(NearbyBirdPos);
+            NearbyBirdVel = RotateLanes(NearbyBirdVel);
+            Nearby.NumBirdsInRadius = RotateLanes(Nearby.NumBirdsInRadius);
+            Nearby.AvgFlockDir = RotateLanes(Nearby.AvgFlockDir);
+            Nearby.AvgFlockPos = RotateLanes(Nearby.AvgFlockPos);
+            Nearby.AvgFlockAvoidance = RotateLanes(Nearby.AvgFlockAvoidance);
+        }
+
+        // NOTE: Empty lanes are far from every bird so their sums are 0 and adding them is safe
+        SIM_LANE(AddToAccumulators)(Accumulators, FirstBirdId, &Nearby, SIM_LANE_WIDTH);
+    }
+}
+
+inline void SIM_LANE(SimAccumulatePairsRow)(void* Data, u32 ThreadId, u32 GridY)
+{
+    sim_half_stencil_job* Job = (sim_half_stencil_job*)Data;
+    sim_state* Sim = Job->Sim;
+    grid* Grid = &Sim->Grid;
+    bird_array BirdArray = Job->Birds;
+    bird_accumulator_array* Accumulators = Sim->ThreadAccumulators + ThreadId;
+    lane_f32 BirdRadiusSq = LaneF32(Sim->BirdRadiusSq);
+    lane_f32 AvoidRadiusSq = LaneF32(Sim->AvoidRadiusSq);
+
+    u32 RowCellId = GridY * Grid->NumCellsX;
+    u32 LastX = Grid->NumCellsX - 1;
+    u32 RowStartBirdId = Grid->CellStart[RowCellId];
+    u32 RowEndBirdId = Grid->CellStart[RowCellId + LastX] + Grid->CellCount[RowCellId + LastX];
+    u32 LastY = Min(GridY + Job->ReachY, Grid->NumCellsY - 1);
+
+    // NOTE: Packets stream through the row and may span cells, which only widens the range of neighbour cells
+    u32 StartX = 0;
+    u32 EndX = 0;
+    for (u32 FirstBirdId = RowStartBirdId; FirstBirdId < RowEndBirdId; FirstBirdId += SIM_LANE_WIDTH)
+    {
+        u32 NumValid = Min(u32(SIM_LANE_WIDTH), RowEndBirdId - FirstBirdId);
+        u32 LastBirdId = FirstBirdId + NumValid - 1;
+        while (Grid->CellStart[RowCellId + StartX] + Grid->CellCount[RowCellId + StartX] <= FirstBirdId)
+        {
+            StartX += 1;
+        }
+        EndX = Max(EndX, StartX);
+        while (Grid->CellStart[RowCellId + EndX] + Grid->CellCount[RowCellId + EndX] <= LastBirdId)
+        {
+            EndX += 1;
+        }
+        u32 NeighbourStartX = StartX - Min(StartX, Job->ReachX);
+        u32 NeighbourEndX = Min(EndX + Job->ReachX, LastX);
+
+        lane_v2 BirdPosition = LaneV2LoadUnAligned(BirdArray.PosX + FirstBirdId, BirdArray.PosY + FirstBirdId);
+        lane_v2 BirdVelocity = LaneV2LoadUnAligned(BirdArray.VelX + FirstBirdId, BirdArray.VelY + FirstBirdId);
+        if (NumValid < SIM_LANE_WIDTH)
+        {
+            SIM_LANE(MoveInvalidLanesAway)(&BirdPosition, &BirdVelocity, NumValid, SIM_HALF_STENCIL_FAR_AWAY);
+        }
+
+        SIM_LANE(bird_average_data) Result = {};
+        SIM_LANE(AccumulatePairsDiagonal)(&Result, BirdPosition, BirdVelocity, BirdRadiusSq, AvoidRadiusSq);
+
+        // NOTE: Birds after the packet in its own row
+        {
+            u32 EndCellId = RowCellId + NeighbourEndX;
+            u32 EndBirdId = Grid->CellStart[EndCellId] + Grid->CellCount[EndCellId];
+            if (FirstBirdId + SIM_LANE_WIDTH < EndBirdId)
+            {
+                SIM_LANE(AccumulatePairsRange)(&Result, Accumulators, BirdArray, FirstBirdId + SIM_LANE_WIDTH, EndBirdId, BirdPosition,
+                                               BirdVelocity, BirdRadiusSq, AvoidRadiusSq);
+            }
+        }
+
+        // NOTE: Rows below, each one is a single contiguous range of birds
+        for (u32 NeighbourY = GridY + 1; NeighbourY <= LastY; ++NeighbourY)
+        {
+            u32 StartCellId = NeighbourY * Grid->NumCellsX + NeighbourStartX;
+            u32 EndCellId = NeighbourY * Grid->NumCellsX + NeighbourEndX;
+            u32 StartBirdId = Grid->CellStart[StartCellId];
+            u32 EndBirdId = Grid->CellStart[EndCellId] + Grid->CellCount[EndCellId];
+            SIM_LANE(AccumulatePairsRange)(&Result, Accumulators, BirdArray, StartBirdId, EndBirdId, BirdPosition, BirdVelocity,
+                                           BirdRadiusSq, AvoidRadiusSq);
+        }
+
+        SIM_LANE(AddToAccumulators)(Accumulators, FirstBirdId, &Result, NumValid);
+    }
+}
+
+inline SIM_LANE(bird_average_data) SIM_LANE(LoadAccumulators)(sim_state* Sim, u32 FirstBirdId)
+{
+    SIM_LANE(bird_average_data) Result = {};
+    lane_f32 NumBirdsInRadius = LaneF32(0.0f);
+    for (u32 AccumulatorId = 0; AccumulatorId < Sim->JobSystem->NumThreads; ++AccumulatorId)
+    {
+        bird_accumulator_array* Accumulators = Sim->ThreadAccumulators + AccumulatorId;
+        NumBirdsInRadius += LaneF32LoadUnAligned(Accumulators->NumBirdsInRadius + FirstBirdId);
+        Result.AvgFlockDir += LaneV2LoadUnAligned(Accumulators->FlockDirX + FirstBirdId, Accumulators->FlockDirY + FirstBirdId);
+        Result.AvgFlockPos += LaneV2LoadUnAligned(Accumulators->FlockPosX + FirstBirdId, Accumulators->FlockPosY + FirstBirdId);
+        Result.AvgFlockAvoidance += LaneV2LoadUnAligned(Accumulators->AvoidanceX + FirstBirdId, Accumulators->AvoidanceY + FirstBirdId);
+    }
+
+    // NOTE: Counts stay exact in float up to 2^24 neighbours
+    Result.NumBirdsInRadius = LaneFloorU32(NumBirdsInRadius);
+    return Result;
+}
+
+//
+// NOTE: Neighbour Lists
+//
+
+inline b32 SIM_LANE(BuildNeighbourList)(sim_state* Sim, bird_array BirdArray, u32 FirstBirdId, f32 ListRadius, u32* Entries,
+                                        u32 MaxNumEntries, u32* NumEntries)
+{
+    // NOTE: Returns false if the list doesn't fit in MaxNumEntries
+    grid* Grid = &Sim->Grid;
+    u32 NumValid = Min(u32(SIM_LANE_WIDTH), Sim->NumBirds - FirstBirdId);
+    lane_u32 ValidMask = LaneU32Index() < LaneU32(NumValid);
+    lane_v2 BirdPosition = LaneV2LoadUnAligned(BirdArray.PosX + FirstBirdId, BirdArray.PosY + FirstBirdId);
+    lane_f32 ListRadiusSq = LaneF32(ListRadius * ListRadius);
+
+    u32 NumListed = 0;
+    grid_range Range = SIM_LANE(GridGetRange)(Grid, BirdPosition, LaneF32(ListRadius), ValidMask);
+    // NOTE: Counts from the start since hashed ranges can wrap
+    for (u32 OffsetY = 0; OffsetY <= Range.EndY - Range.StartY; ++OffsetY)
+    {
+        for (u32 OffsetX = 0; OffsetX <= Range.EndX - Range.StartX; ++OffsetX)
+        {
+            u32 CellId = GridGetCellId(Grid, Range.StartX + OffsetX, Range.StartY + OffsetY);
+            u32 StartIndexId = Grid->CellStart[CellId];
+            u32 EndIndexId = StartIndexId + Grid->CellCount[CellId];
+            for (u32 IndexId = StartIndexId; IndexId < EndIndexId; ++IndexId)
+            {
+                // NOTE: Birds are in cell order. The packet's own birds are listed too, the scan's self test skips them
+                lane_v2 DistanceVec = LaneV2(BirdArray.PosX[IndexId], BirdArray.PosY[IndexId]) - BirdPosition;
+                lane_u32 InListMask = ValidMask & LaneU32Cast(LengthSquared(DistanceVec) < ListRadiusSq);
+                if (MoveMask(InListMask))
+                {
+                    if (NumListed == MaxNumEntries)
+                    {
+                        return false;
+                    }
+                    Entries[NumListed++] = IndexId;
+                }
+            }
+        }
+    }
+
+    *NumEntries = NumListed;
+    return true;
+}
+
+inline void SIM_LANE(BuildNeighbourListsChunk)(void* Data, u32 ThreadId, u32 ChunkId)
+{
+    sim_neighbour_list_job* Job = (sim_neighbour_list_job*)Data;
+    sim_state* Sim = Job->Sim;
+    neighbour_lists* Lists = &Sim->NeighbourListData;
+
+    // NOTE: Every chunk fills its own share of the entries so chunks don't need to know each other's list lengths
+    u32 StartBirdId = ChunkId * SIM_NEIGHBOUR_LIST_CHUNK_SIZE;
+    u32 EndBirdId = Min(StartBirdId + SIM_NEIGHBOUR_LIST_CHUNK_SIZE, Sim->NumBirds);
+    u32 EntryId = StartBirdId * SIM_NEIGHBOUR_LIST_ENTRIES_PER_BIRD;
+    u32 OnePastLastEntryId = (StartBirdId + SIM_NEIGHBOUR_LIST_CHUNK_SIZE) * SIM_NEIGHBOUR_LIST_ENTRIES_PER_BIRD;
+    for (u32 FirstBirdId = StartBirdId; FirstBirdId < EndBirdId; FirstBirdId += SIM_LANE_WIDTH)
+    {
+        u32 PacketId = FirstBirdId / SIM_LANE_WIDTH;
+        u32 NumEntries = 0;
+        if (!SIM_LANE(BuildNeighbourList)(Sim, Job->Birds, FirstBirdId, Job->ListRadius, Lists->Entries + EntryId,
+                                          OnePastLastEntryId - EntryId, &NumEntries))
+        {
+            Job->ChunkOverflowed[ChunkId] = true;
+            return;
+        }
+        
+        Lists->PacketOffsets[PacketId] = EntryId;
+        Lists->PacketLengths[PacketId] = NumEntries;
+        EntryId += NumEntries;
+    }
+
+    u32 NumBirds = EndBirdId - StartBirdId;
+    memcpy(Lists->BuildPosX + StartBirdId, Job->Birds.PosX + StartBirdId, sizeof(f32) * NumBirds);
+    memcpy(Lists->BuildPosY + StartBirdId, Job->Birds.PosY + StartBirdId, sizeof(f32) * NumBirds);
+}
+
+inline SIM_LANE(bird_average_data) SIM_LANE(AccumulateNeighbourList)(sim_state* Sim, bird_array BirdArray, u32 FirstBirdId,
+                                                                     lane_v2 BirdPosition, lane_v2 BirdHeading,
+                                                                     lane_u32 CurrBirdId)
+{
+    // NOTE: Lists are built for the global radii, SimStep doesn't use them with species
+    SIM_LANE(bird_average_data) Result = {};
+    neighbour_lists* Lists = &Sim->NeighbourListData;
+    u32 PacketId = FirstBirdId / SIM_LANE_WIDTH;
+    SIM_DISPATCH_RULES(Sim->ActiveRules, SIM_LANE(GridAccumulateNeighbours),
+                       (&Result, BirdArray, Lists->Entries + Lists->PacketOffsets[PacketId], Lists->PacketLengths[PacketId],
+                        BirdPosition, BirdHeading, CurrBirdId, LaneU32(0), LaneF32(Sim->BirdRadiusSq),
+                        LaneF32(Sim->AvoidRadiusSq), LaneF32(SimGetFovCosSq(Sim))));
+    return Result;
+}
+
+//
+// NOTE: Steering Rules
+//
+
+/*
+
+  NOTE: Lane versions of SteerTowards from the acceleration model prototype. Zero targets steer with zero force like
+        NormalizeSafe, and the force is scaled down to MaxSteerSpeed instead of branching per lane.
+
+ */
+
+inline lane_f32 SIM_LANE(GetSteerScale)(lane_f32 MaxSpeed, lane_f32 TargetLengthSq)
+{
+    lane_f32 HasTargetMask = TargetLengthSq > LaneF32(0.0f);
+    lane_f32 Result = HasTargetMask & (MaxSpeed * ApproxInvSquareRoot(Max(TargetLengthSq, LaneF32(1e-30f))));
+    return Result;
+}
+
+inline lane_f32 SIM_LANE(GetSteerClamp)(sim_state* Sim, lane_f32 SteerLengthSq)
+{
+    // NOTE: Min(1, MaxSteerSpeed / Length) without the divide
+    f32 MaxSteerSpeed = Sim->MaxSteerSpeed;
+    lane_f32 Result = MaxSteerSpeed * ApproxInvSquareRoot(Max(SteerLengthSq, LaneF32(Max(MaxSteerSpeed * MaxSteerSpeed, 1e-30f))));
+    return Result;
+}
+
+inline lane_v2 SIM_LANE(SteerTowards)(sim_state* Sim, lane_f32 MaxSpeed, lane_v2 Velocity, lane_v2 Target)
+{
+    lane_v2 Result = SIM_LANE(GetSteerScale)(MaxSpeed, LengthSquared(Target)) * Target - Velocity;
+    Result = SIM_LANE(GetSteerClamp)(Sim, LengthSquared(Result)) * Result;
+    return Result;
+}
+
+inline lane_v3 SIM_LANE(SteerTowards)(sim_state* Sim, lane_f32 MaxSpeed, lane_v3 Velocity, lane_v3 Target)
+{
+    lane_v3 Result = SIM_LANE(GetSteerScale)(MaxSpeed, LengthSquared(Target)) * Target - Velocity;
+    Result = SIM_LANE(GetSteerClamp)(Sim, LengthSquared(Result)) * Result;
+    return Result;
+}
+
+//
+// NOTE: Predators and Attractors
+//
+
+inline lane_v2 SIM_LANE(GetInfluenceDir)(sim_state* Sim, lane_v2 BirdPosition, lane_u32 ValidMask)
+{
+    // NOTE: Sums the weighted directions to every attractor and away from every predator in range. The coarse grid is
+    //       compact and row major, so each row of the range is one contiguous run of indices
+    grid* Grid = &Sim->InfluencerGrid;
+    bird_array Influencers = Sim->Influencers;
+    lane_f32 MaxRadius = LaneF32(SimGetInfluenceRadius(Sim));
+    grid_range Range = SIM_LANE(GridGetRange)(Grid, BirdPosition, MaxRadius, ValidMask);
+
+    lane_v2 Result = {};
+    for (u32 GridY = Range.StartY; GridY <= Range.EndY; ++GridY)
+    {
+        u32 RowCellId = GridY * Grid->NumCellsX;
+        u32 StartSlotId = Grid->CellStart[RowCellId + Range.StartX];
+        u32 EndSlotId = Grid->CellStart[RowCellId + Range.EndX] + Grid->CellCount[RowCellId + Range.EndX];
+        for (u32 SlotId = StartSlotId; SlotId < EndSlotId; ++SlotId)
+        {
+            u32 InfluencerId = Grid->Indices[SlotId];
+            b32 IsPredator = InfluencerId < Sim->NumPredators;
+            f32 RadiusSq = IsPredator ? Sim->PredatorRadiusSq : Sim->AttractorRadiusSq;
+            f32 Weight = IsPredator ? -Sim->FleePredatorWeight : Sim->SeekAttractorWeight;
+
+            lane_v2 InfluencerPosition = LaneV2(LaneF32(Influencers.PosX[InfluencerId]), LaneF32(Influencers.PosY[InfluencerId]));
+            lane_v2 DistanceVec = InfluencerPosition - BirdPosition;
+            lane_f32 DistanceSq = LengthSquared(DistanceVec);
+            lane_f32 InRangeMask = DistanceSq < LaneF32(RadiusSq);
+            lane_f32 Scale = InRangeMask & (Weight * ApproxInvSquareRoot(Max(DistanceSq, LaneF32(1e-30f))));
+            Result += Scale * DistanceVec;
+        }
+    }
+
+    return Result;
+}
+
+//
+// NOTE: Obstacles
+//
+
+inline lane_f32 SIM_LANE(SdfLerp)(f32* Samples, lane_u32 Index00, lane_u32 Index01, lane_f32 tX, lane_f32 tY)
+{
+    // NOTE: Index01 is the sample above Index00, the samples to the right of both are one further
+    lane_u32 AllLanes = LaneU32(0xFFFFFFFF);
+    lane_f32 Sample00 = LaneF32Gather(Samples, Index00, AllLanes);
+    lane_f32 Sample10 = LaneF32Gather(Samples + 1, Index00, AllLanes);
+    lane_f32 Sample01 = LaneF32Gather(Samples, Index01, AllLanes);
+    lane_f32 Sample11 = LaneF32Gather(Samples + 1, Index01, AllLanes);
+    lane_f32 Bottom = Sample00 + tX * (Sample10 - Sample00);
+    lane_f32 Top = Sample01 + tX * (Sample11 - Sample01);
+    lane_f32 Result = Bottom + tY * (Top - Bottom);
+    return Result;
+}
+
+inline lane_v2 SIM_LANE(GetSdfAvoidDir)(sim_sdf* Sdf, lane_v2 Position, lane_f32 AvoidRadius)
+{
+    // NOTE: Blends the 4 samples around each bird, so the cost doesn't depend on the number of obstacles. Birds outside the
+    //       field use its border. Returns the gradient for birds closer than AvoidRadius to an obstacle and 0 for the rest,
+    //       like the wall tests it replaces
+    lane_f32 SampleX = Clamp((Position.x - LaneF32(Sdf->Min.x)) * LaneF32(Sdf->InvSampleDim.x), LaneF32(0.0f),
+                             LaneF32(f32(Sdf->Width - 1)));
+    lane_f32 SampleY = Clamp((Position.y - LaneF32(Sdf->Min.y)) * LaneF32(Sdf->InvSampleDim.y), LaneF32(0.0f),
+                             LaneF32(f32(Sdf->Height - 1)));
+    lane_u32 X0 = Min(LaneFloorU32(SampleX), LaneU32(Sdf->Width - 2));
+    lane_u32 Y0 = Min(LaneFloorU32(SampleY), LaneU32(Sdf->Height - 2));
+    lane_f32 tX = SampleX - LaneF32(X0);
+    lane_f32 tY = SampleY - LaneF32(Y0);
+
+    // NOTE: Done in float like the cell ids, exact for < 2^24 samples
+    lane_u32 Index00 = LaneFloorU32(LaneF32(Y0) * f32(Sdf->Width) + LaneF32(X0));
+    lane_u32 Index01 = Index00 + LaneU32(Sdf->Width);
+
+    lane_f32 Distance = SIM_LANE(SdfLerp)(Sdf->Distance, Index00, Index01, tX, tY);
+    lane_v2 Gradient = {};
+    Gradient.x = SIM_LANE(SdfLerp)(Sdf->GradientX, Index00, Index01, tX, tY);
+    Gradient.y = SIM_LANE(SdfLerp)(Sdf->GradientY, Index00, Index01, tX, tY);
+
+    lane_f32 CloseMask = Distance < AvoidRadius;
+    lane_v2 Result = {};
+    Result.x = Gradient.x & CloseMask;
+    Result.y = Gradient.y & CloseMask;
+    return Result;
+}
+
+//
+// NOTE: Bird Update
+//
+
+inline void SIM_LANE(StoreMasked)(lane_f32 Value, f32* Dest, u32 NumValid)
+{
+    // NOTE: Tail packets can't write past their cell since another thread may own the next one
+    for (u32 LaneId = 0; LaneId < NumValid; ++LaneId)
+    {
+        Dest[LaneId] = Value.e[LaneId];
+    }
+}
+
+inline void SIM_LANE(SimUpdateBirds)(sim_state* Sim, bird_array PrevBirdArray, bird_array CurrBirdArray, u32* Indices, u32 NumIndices,
+                                     u32 OutputIndexId, f32 FrameTime)
+{
+    // NOTE: A null Indices means the birds are already stored in cell order, starting at OutputIndexId
+    grid* Grid = &Sim->Grid;
+    lane_f32 TerrainAvoidRadius = LaneF32(Sim->TerrainAvoidRadius);
+    lane_f32 TerrainRadius = LaneF32(Sim->TerrainRadius);
+    // NOTE: Rules with a zero weight skip their averaging, steering and blending below. The mask is the same for the whole
+    //       step so the branches always go the same way
+    u32 Rules = Sim->ActiveRules;
+    b32 AvoidTerrain = Sim->AvoidTerrainWeight != 0.0f;
+
+    for (u32 IndexId = 0; IndexId < NumIndices; IndexId += SIM_LANE_WIDTH)
+    {
+        lane_u32 CurrBirdId = {};
+        if (Indices && IndexId + SIM_LANE_WIDTH <= NumIndices)
+        {
+            CurrBirdId = LaneU32LoadUnAligned(Indices + IndexId);
+        }
+        else if (Indices)
+        {
+            // NOTE: Block arena cells are only padded to 4 indices so wider lanes can't load past the end of a cell
+            for (u32 LaneId = 0; LaneId < NumIndices - IndexId; ++LaneId)
+            {
+                CurrBirdId.e[LaneId] = Indices[IndexId + LaneId];
+            }
+        }
+        else
+        {
+            CurrBirdId = LaneU32(OutputIndexId + IndexId) + LaneU32Index();
+        }
+        u32 FirstBirdId = CurrBirdId.e[0];
+
+        // TODO: Add scalar comparison ops
+        // NOTE: Check if we can do a load or if we have to gather
+        lane_u32 BirdValidMask = (LaneU32(IndexId) + LaneU32Index()) < LaneU32(NumIndices);
+        lane_u32 AlignedMask = {};
+        {
+            lane_u32 FirstBirdVec = LaneU32(FirstBirdId);
+            AlignedMask = (CurrBirdId - FirstBirdVec) == LaneU32Index();
+        }
+
+        // NOTE: Load bird data
+        lane_v2 NewBirdPosition = {};
+        lane_v2 NewBirdVelocity = {};
+        {
+            if (MoveMask(BirdValidMask) == SIM_LANE_MASK && MoveMask(AlignedMask) == SIM_LANE_MASK)
+            {
+                // NOTE: We can do aligned loads here
+                NewBirdPosition = LaneV2LoadUnAligned(PrevBirdArray.PosX + FirstBirdId, PrevBirdArray.PosY + FirstBirdId);
+                NewBirdVelocity = LaneV2LoadUnAligned(PrevBirdArray.VelX + FirstBirdId, PrevBirdArray.VelY + FirstBirdId);
+            }
+            else
+            {
+                // NOTE: We have to do a masked gather here
+                NewBirdPosition = LaneV2Gather(PrevBirdArray.PosX, PrevBirdArray.PosY, CurrBirdId, BirdValidMask);
+                NewBirdVelocity = LaneV2Gather(PrevBirdArray.VelX, PrevBirdArray.VelY, CurrBirdId, BirdValidMask);
+            }
+        }
+
+        // NOTE: Lanes past the end of the cell take the first lane's species so they don't make a packet of one species gather
+        u32 NumValid = Min(u32(SIM_LANE_WIDTH), NumIndices - IndexId);
+        lane_u32 BirdSpecies = {};
+        if (Sim->ActiveRules & SimRule_Species)
+        {
+            if (NumValid == SIM_LANE_WIDTH && MoveMask(AlignedMask) == SIM_LANE_MASK)
+            {
+                BirdSpecies = LaneU32LoadUnAligned(PrevBirdArray.Species + FirstBirdId);
+            }
+            else
+            {
+                for (u32 LaneId = 0; LaneId < SIM_LANE_WIDTH; ++LaneId)
+                {
+                    BirdSpecies.e[LaneId] = PrevBirdArray.Species[CurrBirdId.e[LaneId < NumValid ? LaneId : 0]];
+                }
+            }
+        }
+        SIM_LANE(bird_params) Params = SIM_LANE(GetBirdParams)(Sim, BirdSpecies);
+
+        // NOTE: Only the blind spot test needs the heading
+        lane_v2 BirdHeading = {};
+        if (Sim->ActiveRules & SimRule_FieldOfView)
+        {
+            BirdHeading = Normalize(NewBirdVelocity);
+        }
+
+        SIM_LANE(bird_average_data) AverageData = {};
+        if (Sim->UseNeighbourLists)
+        {
+            // NOTE: List updates run on chunks of whole packets so the packet is the one its list was built for
+            AverageData = SIM_LANE(AccumulateNeighbourList)(Sim, PrevBirdArray, FirstBirdId, NewBirdPosition, BirdHeading,
+                                                            CurrBirdId);
+        }
+        else if (Sim->UseHalfStencil)
+        {
+            // NOTE: Birds are in cell order so the packet's sums are contiguous
+            AverageData = SIM_LANE(LoadAccumulators)(Sim, FirstBirdId);
+        }
+        else
+        {
+            AverageData = SIM_LANE(GridGetAverageData)(Sim, Grid, PrevBirdArray, NewBirdPosition, NewBirdVelocity, BirdHeading,
+                                                       CurrBirdId, BirdValidMask, &Params);
+        }
+
+        lane_v2 InfluenceDir = {};
+        if (Sim->Influencers.PosX)
+        {
+            SIM_TIMED_BLOCK("Query Influencers");
+            InfluenceDir = SIM_LANE(GetInfluenceDir)(Sim, NewBirdPosition, BirdValidMask);
+        }
+
+        // NOTE: Apply rules
+        {
+            SIM_TIMED_BLOCK("Apply Rules");
+
+            // NOTE: Only the flock pos has to be averaged
+            if (Rules & (SimRule_MoveToFlock | SimRule_AlignFlock))
+            {
+                lane_f32 DivideFactor = LaneF32(Max(LaneU32(1), AverageData.NumBirdsInRadius));
+                AverageData.AvgFlockDir /= DivideFactor;
+                AverageData.AvgFlockPos /= DivideFactor;
+            }
+
+            // NOTE: Avoid Wall Vel
+            // IMPORTANT: DOnt add float type to the 1 and 0 or MSVC barfs
+            lane_v2 AvoidWallDir = {};
+            if (AvoidTerrain && Sim->Sdf.Distance)
+            {
+                AvoidWallDir = SIM_LANE(GetSdfAvoidDir)(&Sim->Sdf, NewBirdPosition, TerrainAvoidRadius);
+            }
+            else if (AvoidTerrain && !Sim->UnboundedWorld)
+            {
+                AvoidWallDir.x += (NewBirdPosition.x - TerrainAvoidRadius <= -TerrainRadius) & LaneF32(0x1);
+                AvoidWallDir.x -= (NewBirdPosition.x + TerrainAvoidRadius >= TerrainRadius) & LaneF32(0x1);
+                AvoidWallDir.y += (NewBirdPosition.y - TerrainAvoidRadius <= -TerrainRadius) & LaneF32(0x1);
+                AvoidWallDir.y -= (NewBirdPosition.y + TerrainAvoidRadius >= TerrainRadius) & LaneF32(0x1);
+            }
+
+            lane_f32 HasNeighboursMask = LaneF32(AverageData.NumBirdsInRadius > LaneU32(0)) & LaneF32(0x1);
+            if (Sim->RuleSet == SimRuleSet_Steering)
+            {
+                // NOTE: Rules without a target don't steer, the prototype branched on these
+                lane_v2 Acceleration = {};
+                if (Rules & SimRule_MoveToFlock)
+                {
+                    Acceleration += (HasNeighboursMask * Params.MoveToFlockWeight *
+                                     SIM_LANE(SteerTowards)(Sim, Params.MaxSpeed, NewBirdVelocity,
+                                                            AverageData.AvgFlockPos - NewBirdPosition));
+                }
+                if (Rules & SimRule_AlignFlock)
+                {
+                    Acceleration += (HasNeighboursMask * Params.AlignFlockWeight *
+                                     SIM_LANE(SteerTowards)(Sim, Params.MaxSpeed, NewBirdVelocity, AverageData.AvgFlockDir));
+                }
+                if (Rules & SimRule_AvoidBirds)
+                {
+                    lane_f32 HasAvoidanceMask = (LengthSquared(AverageData.AvgFlockAvoidance) > LaneF32(0.0f)) & LaneF32(0x1);
+                    Acceleration += (HasAvoidanceMask * Params.AvoidBirdWeight *
+                                     SIM_LANE(SteerTowards)(Sim, Params.MaxSpeed, NewBirdVelocity, AverageData.AvgFlockAvoidance));
+                }
+                if (AvoidTerrain)
+                {
+                    lane_f32 CloseToWallMask = (LengthSquared(AvoidWallDir) > LaneF32(0.0f)) & LaneF32(0x1);
+                    Acceleration += (CloseToWallMask * Sim->AvoidTerrainWeight *
+                                     SIM_LANE(SteerTowards)(Sim, Params.MaxSpeed, NewBirdVelocity, AvoidWallDir));
+                }
+                if (Sim->Influencers.PosX)
+                {
+                    // NOTE: The influence is already weighted, its length is the weight of the steer towards it
+                    Acceleration += (Length(InfluenceDir) *
+                                     SIM_LANE(SteerTowards)(Sim, Params.MaxSpeed, NewBirdVelocity, InfluenceDir));
+                }
+
+                // NOTE: Apply Acceleration, clamp velocity. The speed and the normalize share one inverse square root
+                NewBirdVelocity += Acceleration * FrameTime;
+                lane_f32 InvBirdSpeed = ApproxInvSquareRoot(Max(LengthSquared(NewBirdVelocity), LaneF32(1e-30f)));
+                lane_f32 BirdSpeed = Clamp(LengthSquared(NewBirdVelocity) * InvBirdSpeed, Params.MinSpeed, Params.MaxSpeed);
+                NewBirdVelocity = (BirdSpeed * InvBirdSpeed) * NewBirdVelocity;
+            }
+            else
+            {
+                // NOTE: Fly towards center
+                if (Rules & SimRule_MoveToFlock)
+                {
+                    NewBirdVelocity += HasNeighboursMask * Params.MoveToFlockWeight * (AverageData.AvgFlockPos - NewBirdPosition);
+                }
+
+                // NOTE: Avoid Others
+                if (Rules & SimRule_AvoidBirds)
+                {
+                    NewBirdVelocity += Params.AvoidBirdWeight * AverageData.AvgFlockAvoidance;
+                }
+
+                // NOTE: Align Velocities
+                if (Rules & SimRule_AlignFlock)
+                {
+                    NewBirdVelocity += HasNeighboursMask * Params.AlignFlockWeight * (AverageData.AvgFlockDir - NewBirdVelocity);
+                }
+
+                // NOTE: Flee Predators, Seek Attractors
+                NewBirdVelocity += InfluenceDir;
+
+                // NOTE: Clamp Velocity
+                lane_f32 BirdSpeed = Clamp(Length(NewBirdVelocity), Params.MinSpeed, Params.MaxSpeed);
+                NewBirdVelocity = BirdSpeed * Normalize(NewBirdVelocity);
+
+                // NOTE: Avoid Terrain
+                if (AvoidTerrain)
+                {
+                    NewBirdVelocity += Sim->AvoidTerrainWeight * AvoidWallDir;
+                }
+            }
+
+            NewBirdPosition += NewBirdVelocity * FrameTime;
+
+            // NOTE: Clamp to be in bounds (a bit hacky since sometimes they can escape)
+            if (!Sim->UnboundedWorld)
+            {
+                NewBirdPosition = Clamp(NewBirdPosition, LaneV2(-TerrainRadius + 0.01f), LaneV2(TerrainRadius - 0.01f));
+            }
+
+            // NOTE: Write into next bird array
+            u32 WriteIndex = OutputIndexId + IndexId;
+            if (Sim->WriteNextCellIds)
+            {
+                // NOTE: Lets the next step's incremental grid update find the birds that changed cells without reloading them
+                lane_u32 NextCellId = SIM_LANE(GridGetCellId)(Grid, NewBirdPosition);
+                for (u32 LaneId = 0; LaneId < NumValid; ++LaneId)
+                {
+                    Grid->NextCellIds[WriteIndex + LaneId] = NextCellId.e[LaneId];
+                }
+            }
+            if (NumValid == SIM_LANE_WIDTH)
+            {
+                StoreUnAligned(NewBirdVelocity.x, CurrBirdArray.VelX + WriteIndex);
+                StoreUnAligned(NewBirdVelocity.y, CurrBirdArray.VelY + WriteIndex);
+                StoreUnAligned(NewBirdPosition.x, CurrBirdArray.PosX + WriteIndex);
+                StoreUnAligned(NewBirdPosition.y, CurrBirdArray.PosY + WriteIndex);
+            }
+            else
+            {
+                SIM_LANE(StoreMasked)(NewBirdVelocity.x, CurrBirdArray.VelX + WriteIndex, NumValid);
+                SIM_LANE(StoreMasked)(NewBirdVelocity.y, CurrBirdArray.VelY + WriteIndex, NumValid);
+                SIM_LANE(StoreMasked)(NewBirdPosition.x, CurrBirdArray.PosX + WriteIndex, NumValid);
+                SIM_LANE(StoreMasked)(NewBirdPosition.y, CurrBirdArray.PosY + WriteIndex, NumValid);
+            }
+            if (Sim->ActiveRules & SimRule_Species)
+            {
+                // NOTE: The species moves to the other buffer with the bird, which also changes slots if birds aren't in cell order
+                for (u32 LaneId = 0; LaneId < NumValid; ++LaneId)
+                {
+                    CurrBirdArray.Species[WriteIndex + LaneId] = BirdSpecies.e[LaneId];
+                }
+            }
+        }
+    }
+}
+
+inline void SIM_LANE(SimUpdateCell)(sim_state* Sim, bird_array PrevBirdArray, bird_array CurrBirdArray, u32 CellId, u32 OutputIndexId,
+                                    f32 FrameTime)
+{
+    grid* Grid = &Sim->Grid;
+    if (Grid->Layout == GridLayout_Compact)
+    {
+        u32* Indices = Sim->BirdsInCellOrder ? 0 : Grid->Indices + Grid->CellStart[CellId];
+        SIM_LANE(SimUpdateBirds)(Sim, PrevBirdArray, CurrBirdArray, Indices, Grid->CellCount[CellId], OutputIndexId, FrameTime);
+        return;
+    }
+
+    grid_cell* CurrCell = Grid->Cells + CellId;
+    u32 BirdBlockIndexId = 0;
+    for (block* CurrBlock = CurrCell->IndexArena.Next; CurrBlock; CurrBlock = CurrBlock->Next)
+    {
+        u32* BlockIndices = BlockGetData(CurrBlock, u32);
+        u32 NumIndicesInBlock = Min(CurrCell->NumIndices - BirdBlockIndexId, Grid->MaxNumIndicesPerBlock);
+        SIM_LANE(SimUpdateBirds)(Sim, PrevBirdArray, CurrBirdArray, BlockIndices, NumIndicesInBlock, OutputIndexId + BirdBlockIndexId,
+                                 FrameTime);
+        BirdBlockIndexId += NumIndicesInBlock;
+    }
+}
+
+inline void SIM_LANE(SimUpdateBirdsTile)(void* Data, u32 ThreadId, u32 TileId)
+{
+    sim_update_birds_job* Job = (sim_update_birds_job*)Data;
+    grid* Grid = &Job->Sim->Grid;
+
+    // NOTE: Tiles are ranges of cell ids, a row band in row major order and a square block in Morton order
+    u32 StartCellId = TileId * Job->CellsPerTile;
+    u32 EndCellId = Min(StartCellId + Job->CellsPerTile, Grid->NumCellsX * Grid->NumCellsY);
+    if (Grid->NumNodeLevels)
+    {
+        // NOTE: Far field cells only hold a few birds each, so packets run across all the cells of the tile
+        u32 StartBirdId = Grid->CellStart[StartCellId];
+        u32 EndBirdId = Grid->CellStart[EndCellId - 1] + Grid->CellCount[EndCellId - 1];
+        SIM_LANE(SimUpdateBirds)(Job->Sim, Job->PrevBirdArray, Job->CurrBirdArray, 0, EndBirdId - StartBirdId, StartBirdId,
+                                 Job->FrameTime);
+        return;
+    }
+    
+    for (u32 CellId = StartCellId; CellId < EndCellId; ++CellId)
+    {
+        SIM_LANE(SimUpdateCell)(Job->Sim, Job->PrevBirdArray, Job->CurrBirdArray, CellId, Job->CellOffsets[CellId], Job->FrameTime);
+    }
+}
+
+inline void SIM_LANE(SimUpdateBirdsChunk)(void* Data, u32 ThreadId, u32 ChunkId)
+{
+    // NOTE: Neighbour lists keep birds in their slots, so we update contiguous chunks of slots instead of cells
+    sim_update_birds_job* Job = (sim_update_birds_job*)Data;
+    sim_state* Sim = Job->Sim;
+    neighbour_lists* Lists = &Sim->NeighbourListData;
+    u32 StartBirdId = ChunkId * SIM_NEIGHBOUR_LIST_CHUNK_SIZE;
+    u32 EndBirdId = Min(StartBirdId + SIM_NEIGHBOUR_LIST_CHUNK_SIZE, Sim->NumBirds);
+    SIM_LANE(SimUpdateBirds)(Sim, Job->PrevBirdArray, Job->CurrBirdArray, 0, EndBirdId - StartBirdId, StartBirdId, Job->FrameTime);
+
+    // NOTE: Track how far birds got from the last list build while the new positions are still in cache
+    lane_f32 MaxDisplacementSq = LaneF32(0.0f);
+    for (u32 FirstBirdId = StartBirdId; FirstBirdId < EndBirdId; FirstBirdId += SIM_LANE_WIDTH)
+    {
+        lane_v2 Position = LaneV2LoadUnAligned(Job->CurrBirdArray.PosX + FirstBirdId, Job->CurrBirdArray.PosY + FirstBirdId);
+        lane_v2 BuildPosition = LaneV2LoadUnAligned(Lists->BuildPosX + FirstBirdId, Lists->BuildPosY + FirstBirdId);
+        lane_f32 ValidMask = LaneF32(LaneU32Index()) < LaneF32(f32(EndBirdId - FirstBirdId));
+        MaxDisplacementSq = Max(MaxDisplacementSq, LengthSquared(Position - BuildPosition) & ValidMask);
+    }
+
+    f32 ChunkMaxDisplacementSq = 0.0f;
+    for (u32 LaneId = 0; LaneId < SIM_LANE_WIDTH; ++LaneId)
+    {
+        ChunkMaxDisplacementSq = Max(ChunkMaxDisplacementSq, MaxDisplacementSq.e[LaneId]);
+    }
+    Job->ChunkMaxDisplacementSq[ChunkId] = ChunkMaxDisplacementSq;
+}
+
+//
+// NOTE: 3D Flocking
+//
+
+/*
+
+  NOTE: Same rules as the 2D update with a Z axis. Birds are always in cell order on a row major 3D grid, so a packet is a
+        slice of one row of cells and every row of X cells in its neighbourhood is one contiguous range of birds.
+
+ */
+
+struct SIM_LANE(bird_average_data_3d)
+{
+    lane_u32 NumBirdsInRadius;
+    lane_v3 AvgFlockDir;
+    lane_v3 AvgFlockPos;
+    lane_v3 AvgFlockAvoidance;
+};
+
+inline lane_u32 SIM_LANE(GridGetCellCoord3d)(lane_f32 Pos, f32 WorldMin, f32 WorldDim, u32 NumCells)
+{
+    lane_f32 ReMappedPos = (Pos - LaneF32(WorldMin)) / LaneF32(WorldDim);
+    lane_u32 Result = LaneFloorU32(Clamp(ReMappedPos * f32(NumCells), LaneF32(0.0f), LaneF32(f32(NumCells - 1))));
+    return Result;
+}
+
+inline grid_range SIM_LANE(GridGetRange3d)(grid* Grid, lane_v3 Pos, lane_f32 Radius, lane_u32 ValidMask)
+{
+    v2 WorldMin = Grid->WorldBounds.Min;
+    v2 WorldDim = AabbGetDim(Grid->WorldBounds);
+    f32 WorldDimZ = Grid->WorldMaxZ - Grid->WorldMinZ;
+    lane_u32 StartX = SIM_LANE(GridGetCellCoord3d)(Pos.x - Radius, WorldMin.x, WorldDim.x, Grid->NumCellsX);
+    lane_u32 StartY = SIM_LANE(GridGetCellCoord3d)(Pos.y - Radius, WorldMin.y, WorldDim.y, Grid->NumCellsY);
+    lane_u32 StartZ = SIM_LANE(GridGetCellCoord3d)(Pos.z - Radius, Grid->WorldMinZ, WorldDimZ, Grid->NumCellsZ);
+    lane_u32 EndX = SIM_LANE(GridGetCellCoord3d)(Pos.x + Radius, WorldMin.x, WorldDim.x, Grid->NumCellsX);
+    lane_u32 EndY = SIM_LANE(GridGetCellCoord3d)(Pos.y + Radius, WorldMin.y, WorldDim.y, Grid->NumCellsY);
+    lane_u32 EndZ = SIM_LANE(GridGetCellCoord3d)(Pos.z + Radius, Grid->WorldMinZ, WorldDimZ, Grid->NumCellsZ);
+
+    // NOTE: Invalid lanes can't widen the range
+    grid_range Result = {};
+    Result.StartX = HorizontalMin(StartX | ~ValidMask);
+    Result.StartY = HorizontalMin(StartY | ~ValidMask);
+    Result.StartZ = HorizontalMin(StartZ | ~ValidMask);
+    Result.EndX = HorizontalMax(EndX & ValidMask);
+    Result.EndY = HorizontalMax(EndY & ValidMask);
+    Result.EndZ = HorizontalMax(EndZ & ValidMask);
+
+    return Result;
+}
+
+inline lane_u32 SIM_LANE(GetInViewMask)(lane_v3 DistanceVec, lane_f32 DistanceSq, lane_v3 BirdHeading, lane_f32 FovCosSq)
+{
+    lane_f32 Dot = DistanceVec.x * BirdHeading.x + DistanceVec.y * BirdHeading.y + DistanceVec.z * BirdHeading.z;
+    lane_u32 Result = LaneU32Cast(Dot * Max(Dot, -Dot) >= FovCosSq * DistanceSq);
+    return Result;
+}
+
+template <u32 Rules>
+inline void SIM_LANE(GridAccumulateNeighbours3d)(SIM_LANE(bird_average_data_3d)* Result, bird_array BirdArray, u32 StartBirdId,
+                                                 u32 NumBirds, lane_v3 BirdPosition, lane_v3 BirdHeading, lane_u32 CurrBirdId,
+                                                 lane_u32 CurrSpecies, lane_f32 BirdRadiusSq, lane_f32 AvoidRadiusSq,
+                                                 lane_f32 FovCosSq)
+{
+    f32* PosX = BirdArray.PosX + StartBirdId;
+    f32* PosY = BirdArray.PosY + StartBirdId;
+    f32* PosZ = BirdArray.PosZ + StartBirdId;
+    f32* VelX = BirdArray.VelX + StartBirdId;
+    f32* VelY = BirdArray.VelY + StartBirdId;
+    f32* VelZ = BirdArray.VelZ + StartBirdId;
+    u32* Species = BirdArray.Species + StartBirdId;
+    for (u32 IndexId = 0; IndexId < NumBirds; ++IndexId)
+    {
+        lane_u32 SameBirdMask = LaneU32(StartBirdId + IndexId) != CurrBirdId;
+
+        lane_v3 NearbyBirdPos = LaneV3(LaneF32(PosX[IndexId]), LaneF32(PosY[IndexId]), LaneF32(PosZ[IndexId]));
+        lane_v3 DistanceVec = NearbyBirdPos - BirdPosition;
+        lane_f32 DistanceSq = LengthSquared(DistanceVec);
+
+        if (Rules & SimRule_FieldOfView)
+        {
+            SameBirdMask = SameBirdMask & SIM_LANE(GetInViewMask)(DistanceVec, DistanceSq, BirdHeading, FovCosSq);
+        }
+
+        if (Rules & (SimRule_MoveToFlock | SimRule_AlignFlock))
+        {
+            lane_u32 BirdRadiusMask = SameBirdMask & LaneU32Cast(DistanceSq < BirdRadiusSq) & LaneU32(0x1);
+            if (Rules & SimRule_Species)
+            {
+                BirdRadiusMask = BirdRadiusMask & (LaneU32(Species[IndexId]) == CurrSpecies);
+            }
+            lane_f32 BirdRadiusMaskFloat = LaneF32(BirdRadiusMask);
+            Result->NumBirdsInRadius += BirdRadiusMask;
+            if (Rules & SimRule_AlignFlock)
+            {
+                lane_v3 NearbyBirdVel = LaneV3(LaneF32(VelX[IndexId]), LaneF32(VelY[IndexId]), LaneF32(VelZ[IndexId]));
+                Result->AvgFlockDir += BirdRadiusMaskFloat * NearbyBirdVel;
+            }
+            if (Rules & SimRule_MoveToFlock)
+            {
+                Result->AvgFlockPos += BirdRadiusMaskFloat * NearbyBirdPos;
+            }
+        }
+
+        if (Rules & SimRule_AvoidBirds)
+        {
+            lane_u32 AvoidRadiusMask = SameBirdMask & LaneU32Cast(DistanceSq < AvoidRadiusSq) & LaneU32(0x1);
+            lane_f32 AvoidRadiusMaskFloat = LaneF32(AvoidRadiusMask);
+            Result->AvgFlockAvoidance += AvoidRadiusMaskFloat * (-DistanceVec);
+        }
+    }
+}
+
+inline SIM_LANE(bird_average_data_3d) SIM_LANE(GridGetAverageData3d)(sim_state* Sim, grid* Grid, bird_array BirdArray,
+                                                                     lane_v3 BirdPosition, lane_v3 BirdHeading, lane_u32 CurrBirdId,
+                                                                     lane_u32 ValidMask, SIM_LANE(bird_params)* Params)
+{
+    SIM_LANE(bird_average_data_3d) Result = {};
+
+    lane_f32 BirdRadiusSq = Params->BirdRadiusSq;
+    lane_f32 AvoidRadiusSq = Params->AvoidRadiusSq;
+    lane_f32 FovCosSq = LaneF32(SimGetFovCosSq(Sim));
+    lane_f32 MaxRadius = LaneF32(SquareRoot(SimGetSearchRadiusSq(Sim)));
+    grid_range Range = SIM_LANE(GridGetRange3d)(Grid, BirdPosition, MaxRadius, ValidMask);
+
+    for (u32 GridZ = Range.StartZ; GridZ <= Range.EndZ; ++GridZ)
+    {
+        for (u32 GridY = Range.StartY; GridY <= Range.EndY; ++GridY)
+        {
+            u32 RowCellId = (GridZ * Grid->NumCellsY + GridY) * Grid->NumCellsX;
+            u32 StartBirdId = Grid->CellStart[RowCellId + Range.StartX];
+            u32 OnePastEndBirdId = Grid->CellStart[RowCellId + Range.EndX] + Grid->CellCount[RowCellId + Range.EndX];
+            SIM_DISPATCH_RULES(Sim->ActiveRules, SIM_LANE(GridAccumulateNeighbours3d),
+                               (&Result, BirdArray, StartBirdId, OnePastEndBirdId - StartBirdId, BirdPosition, BirdHeading,
+                                CurrBirdId, Params->Species, BirdRadiusSq, AvoidRadiusSq, FovCosSq));
+        }
+    }
+
+    return Result;
+}
+
+inline void SIM_LANE(SimUpdateBirds3d)(sim_state* Sim, bird_array PrevBirdArray, bird_array CurrBirdArray, u32 StartBirdId,
+                                       u32 NumBirds, f32 FrameTime)
+{
+    grid* Grid = &Sim->Grid;
+    lane_f32 TerrainAvoidRadius = LaneF32(Sim->TerrainAvoidRadius);
+    lane_f32 TerrainRadius = LaneF32(Sim->TerrainRadius);
+    lane_f32 MinPos = LaneF32(-Sim->TerrainRadius + 0.01f);
+    lane_f32 MaxPos = LaneF32(Sim->TerrainRadius - 0.01f);
+    // NOTE: Same as in 2D, zero weight rules skip their math
+    u32 Rules = Sim->ActiveRules;
+    b32 AvoidTerrain = Sim->AvoidTerrainWeight != 0.0f;
+
+    for (u32 IndexId = 0; IndexId < NumBirds; IndexId += SIM_LANE_WIDTH)
+    {
+        u32 FirstBirdId = StartBirdId + IndexId;
+        lane_u32 CurrBirdId = LaneU32(FirstBirdId) + LaneU32Index();
+        lane_u32 BirdValidMask = (LaneU32(IndexId) + LaneU32Index()) < LaneU32(NumBirds);
+
+        // NOTE: Bird arrays are padded so a cell's last packet can always be loaded, lanes past the cell are left out of the
+        //       range and never stored
+        lane_v3 NewBirdPosition = LaneV3(LaneF32LoadUnAligned(PrevBirdArray.PosX + FirstBirdId),
+                                         LaneF32LoadUnAligned(PrevBirdArray.PosY + FirstBirdId),
+                                         LaneF32LoadUnAligned(PrevBirdArray.PosZ + FirstBirdId));
+        lane_v3 NewBirdVelocity = LaneV3(LaneF32LoadUnAligned(PrevBirdArray.VelX + FirstBirdId),
+                                         LaneF32LoadUnAligned(PrevBirdArray.VelY + FirstBirdId),
+                                         LaneF32LoadUnAligned(PrevBirdArray.VelZ + FirstBirdId));
+
+        lane_v3 BirdHeading = {};
+        if (Sim->ActiveRules & SimRule_FieldOfView)
+        {
+            BirdHeading = Normalize(NewBirdVelocity);
+        }
+
+        // NOTE: Same as in 2D, lanes past the end of the row take the first lane's species
+        u32 NumValid = Min(u32(SIM_LANE_WIDTH), NumBirds - IndexId);
+        lane_u32 BirdSpecies = {};
+        if (Sim->ActiveRules & SimRule_Species)
+        {
+            BirdSpecies = LaneU32LoadUnAligned(PrevBirdArray.Species + FirstBirdId);
+            for (u32 LaneId = NumValid; LaneId < SIM_LANE_WIDTH; ++LaneId)
+            {
+                BirdSpecies.e[LaneId] = BirdSpecies.e[0];
+            }
+        }
+        SIM_LANE(bird_params) Params = SIM_LANE(GetBirdParams)(Sim, BirdSpecies);
+        
+        SIM_LANE(bird_average_data_3d) AverageData = SIM_LANE(GridGetAverageData3d)(Sim, Grid, PrevBirdArray, NewBirdPosition,
+                                                                                   BirdHeading, CurrBirdId, BirdValidMask,
+                                                                                   &Params);
+
+        // NOTE: Apply rules
+        {
+            SIM_TIMED_BLOCK("Apply Rules");
+
+            if (Rules & (SimRule_MoveToFlock | SimRule_AlignFlock))
+            {
+                lane_f32 DivideFactor = LaneF32(Max(LaneU32(1), AverageData.NumBirdsInRadius));
+                AverageData.AvgFlockDir /= DivideFactor;
+                AverageData.AvgFlockPos /= DivideFactor;
+            }
+
+            // NOTE: Avoid Wall Vel
+            lane_v3 AvoidWallDir = {};
+            if (AvoidTerrain)
+            {
+                AvoidWallDir.x += (NewBirdPosition.x - TerrainAvoidRadius <= -TerrainRadius) & LaneF32(0x1);
+                AvoidWallDir.x -= (NewBirdPosition.x + TerrainAvoidRadius >= TerrainRadius) & LaneF32(0x1);
+                AvoidWallDir.y += (NewBirdPosition.y - TerrainAvoidRadius <= -TerrainRadius) & LaneF32(0x1);
+                AvoidWallDir.y -= (NewBirdPosition.y + TerrainAvoidRadius >= TerrainRadius) & LaneF32(0x1);
+                AvoidWallDir.z += (NewBirdPosition.z - TerrainAvoidRadius <= -TerrainRadius) & LaneF32(0x1);
+                AvoidWallDir.z -= (NewBirdPosition.z + TerrainAvoidRadius >= TerrainRadius) & LaneF32(0x1);
+            }
+
+            lane_f32 HasNeighboursMask = LaneF32(AverageData.NumBirdsInRadius > LaneU32(0)) & LaneF32(0x1);
+            if (Sim->RuleSet == SimRuleSet_Steering)
+            {
+                lane_v3 Acceleration = {};
+                if (Rules & SimRule_MoveToFlock)
+                {
+                    Acceleration += (HasNeighboursMask * Params.MoveToFlockWeight *
+                                     SIM_LANE(SteerTowards)(Sim, Params.MaxSpeed, NewBirdVelocity,
+                                                            AverageData.AvgFlockPos - NewBirdPosition));
+                }
+                if (Rules & SimRule_AlignFlock)
+                {
+                    Acceleration += (HasNeighboursMask * Params.AlignFlockWeight *
+                                     SIM_LANE(SteerTowards)(Sim, Params.MaxSpeed, NewBirdVelocity, AverageData.AvgFlockDir));
+                }
+                if (Rules & SimRule_AvoidBirds)
+                {
+                    lane_f32 HasAvoidanceMask = (LengthSquared(AverageData.AvgFlockAvoidance) > LaneF32(0.0f)) & LaneF32(0x1);
+                    Acceleration += (HasAvoidanceMask * Params.AvoidBirdWeight *
+                                     SIM_LANE(SteerTowards)(Sim, Params.MaxSpeed, NewBirdVelocity, AverageData.AvgFlockAvoidance));
+                }
+                if (AvoidTerrain)
+                {
+                    lane_f32 CloseToWallMask = (LengthSquared(AvoidWallDir) > LaneF32(0.0f)) & LaneF32(0x1);
+                    Acceleration += (CloseToWallMask * Sim->AvoidTerrainWeight *
+                                     SIM_LANE(SteerTowards)(Sim, Params.MaxSpeed, NewBirdVelocity, AvoidWallDir));
+                }
+
+                NewBirdVelocity += Acceleration * FrameTime;
+                lane_f32 InvBirdSpeed = ApproxInvSquareRoot(Max(LengthSquared(NewBirdVelocity), LaneF32(1e-30f)));
+                lane_f32 BirdSpeed = Clamp(LengthSquared(NewBirdVelocity) * InvBirdSpeed, Params.MinSpeed, Params.MaxSpeed);
+                NewBirdVelocity = (BirdSpeed * InvBirdSpeed) * NewBirdVelocity;
+            }
+            else
+            {
+                // NOTE: Fly towards center
+                if (Rules & SimRule_MoveToFlock)
+                {
+                    NewBirdVelocity += HasNeighboursMask * Params.MoveToFlockWeight * (AverageData.AvgFlockPos - NewBirdPosition);
+                }
+
+                // NOTE: Avoid Others
+                if (Rules & SimRule_AvoidBirds)
+                {
+                    NewBirdVelocity += Params.AvoidBirdWeight * AverageData.AvgFlockAvoidance;
+                }
+
+                // NOTE: Align Velocities
+                if (Rules & SimRule_AlignFlock)
+                {
+                    NewBirdVelocity += HasNeighboursMask * Params.AlignFlockWeight * (AverageData.AvgFlockDir - NewBirdVelocity);
+                }
+
+                // NOTE: Clamp Velocity
+                lane_f32 BirdSpeed = Clamp(Length(NewBirdVelocity), Params.MinSpeed, Params.MaxSpeed);
+                NewBirdVelocity = BirdSpeed * Normalize(NewBirdVelocity);
+
+                // NOTE: Avoid Terrain
+                if (AvoidTerrain)
+                {
+                    NewBirdVelocity += Sim->AvoidTerrainWeight * AvoidWallDir;
+                }
+            }
+
+            NewBirdPosition += NewBirdVelocity * FrameTime;
+            NewBirdPosition.x = Clamp(NewBirdPosition.x, MinPos, MaxPos);
+            NewBirdPosition.y = Clamp(NewBirdPosition.y, MinPos, MaxPos);
+            NewBirdPosition.z = Clamp(NewBirdPosition.z, MinPos, MaxPos);
+
+            // NOTE: Write into next bird array
+            if (NumValid == SIM_LANE_WIDTH)
+            {
+                StoreUnAligned(NewBirdVelocity.x, CurrBirdArray.VelX + FirstBirdId);
+                StoreUnAligned(NewBirdVelocity.y, CurrBirdArray.VelY + FirstBirdId);
+                StoreUnAligned(NewBirdVelocity.z, CurrBirdArray.VelZ + FirstBirdId);
+                StoreUnAligned(NewBirdPosition.x, CurrBirdArray.PosX + FirstBirdId);
+                StoreUnAligned(NewBirdPosition.y, CurrBirdArray.PosY + FirstBirdId);
+                StoreUnAligned(NewBirdPosition.z, CurrBirdArray.PosZ + FirstBirdId);
+            }
+            else
+            {
+                SIM_LANE(StoreMasked)(NewBirdVelocity.x, CurrBirdArray.VelX + FirstBirdId, NumValid);
+                SIM_LANE(StoreMasked)(NewBirdVelocity.y, CurrBirdArray.VelY + FirstBirdId, NumValid);
+                SIM_LANE(StoreMasked)(NewBirdVelocity.z, CurrBirdArray.VelZ + FirstBirdId, NumValid);
+                SIM_LANE(StoreMasked)(NewBirdPosition.x, CurrBirdArray.PosX + FirstBirdId, NumValid);
+                SIM_LANE(StoreMasked)(NewBirdPosition.y, CurrBirdArray.PosY + FirstBirdId, NumValid);
+                SIM_LANE(StoreMasked)(NewBirdPosition.z, CurrBirdArray.PosZ + FirstBirdId, NumValid);
+            }
+            if (Sim->ActiveRules & SimRule_Species)
+            {
+                for (u32 LaneId = 0; LaneId < NumValid; ++LaneId)
+                {
+                    CurrBirdArray.Species[FirstBirdId + LaneId] = BirdSpecies.e[LaneId];
+                }
+            }
+        }
+    }
+}
+
+inline void SIM_LANE(SimUpdateBirdsTile3d)(void* Data, u32 ThreadId, u32 TileId)
+{
+    // NOTE: Tiles are rows of X cells. 3D cells only hold a bird or two, so packets run across the whole row, which costs a
+    //       slightly wider X range per packet but keeps the lanes full
+    sim_update_birds_job* Job = (sim_update_birds_job*)Data;
+    grid* Grid = &Job->Sim->Grid;
+    u32 StartCellId = TileId * Job->CellsPerTile;
+    u32 EndCellId = Min(StartCellId + Job->CellsPerTile, GridGetNumCells(Grid));
+    u32 StartBirdId = Grid->CellStart[StartCellId];
+    u32 EndBirdId = Grid->CellStart[EndCellId - 1] + Grid->CellCount[EndCellId - 1];
+    SIM_LANE(SimUpdateBirds3d)(Job->Sim, Job->PrevBirdArray, Job->CurrBirdArray, StartBirdId, EndBirdId - StartBirdId, Job->FrameTime);
+}
+
+#undef SIM_LANE
+#undef SIM_LANE_MASK
+#undef lane_f32
+#undef lane_u32
+#undef lane_v2
+#undef lane_v3
+#undef LaneF32
+#undef LaneU32
+#undef LaneV2
+#undef LaneV3
+#undef LaneU32Index
+#undef LaneU32Cast
+#undef LaneF32LoadUnAligned
+#undef LaneU32LoadUnAligned
+#undef LaneV2LoadUnAligned
+#undef LaneV2Gather
+#undef LaneF32Gather
+#undef LaneFloorU32
@@ -0,0 +1,494 @@
+#pragma once
+
+/*
+
+  NOTE: 8 and 16 wide versions of the math lib's SIMD types, only with the ops the flocking kernel needs, plus lane rotations
+        for every width since the math lib doesn't have them. They follow the same conventions as v1_x4/v1u_x4/v2_x4
+        (comparisons return all-ones masks per lane, e[] gives lane access) so that boids_sim_kernel.cpp can be compiled
+        once per width.
+
+        Everything here has to be compiled for AVX2/AVX-512 even though the rest of the sim targets SSE4. MSVC lets us use
+        the intrinsics without /arch, GCC/Clang need the functions tagged, which is what SIM_TARGET_BEGIN/END do. Code in
+        these regions must only run after SimGetMaxLaneWidth said the CPU supports it.
+
+        The 3D mode also needs v3_x8/v3_x16, the 4 wide v3_x4 comes from the math lib like v2_x4.
+
+ */
+
+#if defined(__clang__)
+#define SIM_TARGET_BEGIN_AVX2 _Pragma("clang attribute push (__attribute__((target(\"avx2\"))), apply_to = function)")
+#define SIM_TARGET_BEGIN_AVX512 _Pragma("clang attribute push (__attribute__((target(\"avx512f\"))), apply_to = function)")
+#define SIM_TARGET_END _Pragma("clang attribute pop")
+#elif defined(__GNUC__)
+#define SIM_TARGET_BEGIN_AVX2 _Pragma("GCC push_options") _Pragma("GCC target(\"avx2\")")
+#define SIM_TARGET_BEGIN_AVX512 _Pragma("GCC push_options") _Pragma("GCC target(\"avx512f\")")
+#define SIM_TARGET_END _Pragma("GCC pop_options")
+#else
+#define SIM_TARGET_BEGIN_AVX2
+#define SIM_TARGET_BEGIN_AVX512
+#define SIM_TARGET_END
+#endif
+
+#define SIM_MAX_LANE_WIDTH 16
+
+//
+// NOTE: 4 Wide (SSE)
+//
+
+// NOTE: Lane i gets lane i + 1, the last lane gets lane 0
+inline v1_x4 RotateLanes(v1_x4 A) { v1_x4 Result; Result.x = _mm_shuffle_ps(A.x, A.x, _MM_SHUFFLE(0, 3, 2, 1)); return Result; }
+inline v1u_x4 RotateLanes(v1u_x4 A) { v1u_x4 Result; Result.x = _mm_shuffle_epi32(A.x, _MM_SHUFFLE(0, 3, 2, 1)); return Result; }
+inline v2_x4 RotateLanes(v2_x4 A) { v2_x4 Result; Result.x = RotateLanes(A.x); Result.y = RotateLanes(A.y); return Result; }
+
+// NOTE: Pairs of 16 bit ints packed into each 32 bit lane, X in the low half and Y in the high half. SubI16Pairs wraps each half
+//       on its own and DotI16Pairs returns X0 * X1 + Y0 * Y1 as a signed 32 bit int
+inline v1u_x4 PackI16Pairs(v1u_x4 X, v1u_x4 Y)
+{
+    v1u_x4 Result;
+    Result.x = _mm_or_si128(_mm_and_si128(X.x, _mm_set1_epi32(0xFFFF)), _mm_slli_epi32(Y.x, 16));
+    return Result;
+}
+inline v1u_x4 SubI16Pairs(v1u_x4 A, v1u_x4 B) { v1u_x4 Result; Result.x = _mm_sub_epi16(A.x, B.x); return Result; }
+inline v1u_x4 DotI16Pairs(v1u_x4 A, v1u_x4 B) { v1u_x4 Result; Result.x = _mm_madd_epi16(A.x, B.x); return Result; }
+
+// NOTE: rsqrt estimate (12 bits) refined with one Newton step to about 22 bits, cheaper than a sqrt and a divide
+inline v1_x4 ApproxInvSquareRoot(v1_x4 A)
+{
+    v1_x4 Estimate;
+    Estimate.x = _mm_rsqrt_ps(A.x);
+    return Estimate * (V1X4(1.5f) - V1X4(0.5f) * A * Estimate * Estimate);
+}
+
+//
+// NOTE: 8 Wide (AVX2)
+//
+
+SIM_TARGET_BEGIN_AVX2
+
+union v1_x8
+{
+    __m256 x;
+    f32 e[8];
+};
+
+union v1u_x8
+{
+    __m256i x;
+    u32 e[8];
+};
+
+struct v2_x8
+{
+    v1_x8 x;
+    v1_x8 y;
+};
+
+inline v1_x8 V1X8(f32 A) { v1_x8 Result; Result.x = _mm256_set1_ps(A); return Result; }
+inline v1_x8 V1X8(i32 A) { v1_x8 Result; Result.x = _mm256_set1_ps(f32(A)); return Result; }
+inline v1_x8 V1X8(v1u_x8 A) { v1_x8 Result; Result.x = _mm256_cvtepi32_ps(A.x); return Result; }
+inline v1_x8 V1X8Cast(v1u_x8 A) { v1_x8 Result; Result.x = _mm256_castsi256_ps(A.x); return Result; }
+inline v1_x8 V1X8LoadUnAligned(f32* A) { v1_x8 Result; Result.x = _mm256_loadu_ps(A); return Result; }
+inline void StoreUnAligned(v1_x8 A, f32* Dest) { _mm256_storeu_ps(Dest, A.x); }
+
+inline v1u_x8 V1UX8(u32 A) { v1u_x8 Result; Result.x = _mm256_set1_epi32(A); return Result; }
+inline v1u_x8 V1UX8Cast(v1_x8 A) { v1u_x8 Result; Result.x = _mm256_castps_si256(A.x); return Result; }
+inline v1u_x8 V1UX8LoadUnAligned(u32* A) { v1u_x8 Result; Result.x = _mm256_loadu_si256((__m256i*)A); return Result; }
+inline v1u_x8 V1UX8LaneIndex() { v1u_x8 Result; Result.x = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7); return Result; }
+
+#define SIM_LANE_OP_F32_X8(Op, Intrin)                                  \
+    inline v1_x8 operator Op(v1_x8 A, v1_x8 B) { v1_x8 Result; Result.x = Intrin(A.x, B.x); return Result; } \
+    inline v1_x8 operator Op(v1_x8 A, f32 B) { return A Op V1X8(B); } \
+    inline v1_x8 operator Op(f32 A, v1_x8 B) { return V1X8(A) Op B; }
+SIM_LANE_OP_F32_X8(+, _mm256_add_ps)
+SIM_LANE_OP_F32_X8(-, _mm256_sub_ps)
+SIM_LANE_OP_F32_X8(*, _mm256_mul_ps)
+SIM_LANE_OP_F32_X8(/, _mm256_div_ps)
+SIM_LANE_OP_F32_X8(&, _mm256_and_ps)
+#undef SIM_LANE_OP_F32_X8
+
+#define SIM_LANE_CMP_F32_X8(Op, Pred)                                   \
+    inline v1_x8 operator Op(v1_x8 A, v1_x8 B) { v1_x8 Result; Result.x = _mm256_cmp_ps(A.x, B.x, Pred); return Result; } \
+    inline v1_x8 operator Op(v1_x8 A, f32 B) { return A Op V1X8(B); }
+SIM_LANE_CMP_F32_X8(<, _CMP_LT_OQ)
+SIM_LANE_CMP_F32_X8(<=, _CMP_LE_OQ)
+SIM_LANE_CMP_F32_X8(>, _CMP_GT_OQ)
+SIM_LANE_CMP_F32_X8(>=, _CMP_GE_OQ)
+#undef SIM_LANE_CMP_F32_X8
+
+inline v1_x8 operator-(v1_x8 A) { return V1X8(0.0f) - A; }
+inline v1_x8& operator+=(v1_x8& A, v1_x8 B) { A = A + B; return A; }
+inline v1_x8& operator-=(v1_x8& A, v1_x8 B) { A = A - B; return A; }
+inline v1_x8& operator/=(v1_x8& A, v1_x8 B) { A = A / B; return A; }
+inline v1_x8 Min(v1_x8 A, v1_x8 B) { v1_x8 Result; Result.x = _mm256_min_ps(A.x, B.x); return Result; }
+inline v1_x8 Max(v1_x8 A, v1_x8 B) { v1_x8 Result; Result.x = _mm256_max_ps(A.x, B.x); return Result; }
+inline v1_x8 Clamp(v1_x8 A, v1_x8 MinVal, v1_x8 MaxVal) { return Min(Max(A, MinVal), MaxVal); }
+inline v1_x8 SquareRoot(v1_x8 A) { v1_x8 Result; Result.x = _mm256_sqrt_ps(A.x); return Result; }
+inline v1u_x8 FloorV1UX8(v1_x8 A) { v1u_x8 Result; Result.x = _mm256_cvttps_epi32(_mm256_floor_ps(A.x)); return Result; }
+
+#define SIM_LANE_OP_U32_X8(Op, Intrin)                                  \
+    inline v1u_x8 operator Op(v1u_x8 A, v1u_x8 B) { v1u_x8 Result; Result.x = Intrin(A.x, B.x); return Result; }
+SIM_LANE_OP_U32_X8(+, _mm256_add_epi32)
+SIM_LANE_OP_U32_X8(-, _mm256_sub_epi32)
+SIM_LANE_OP_U32_X8(&, _mm256_and_si256)
+SIM_LANE_OP_U32_X8(|, _mm256_or_si256)
+SIM_LANE_OP_U32_X8(^, _mm256_xor_si256)
+SIM_LANE_OP_U32_X8(==, _mm256_cmpeq_epi32)
+#undef SIM_LANE_OP_U32_X8
+
+inline v1u_x8 operator~(v1u_x8 A) { return A ^ V1UX8(0xFFFFFFFF); }
+inline v1u_x8 operator!=(v1u_x8 A, v1u_x8 B) { return ~(A == B); }
+inline v1u_x8 operator>(v1u_x8 A, v1u_x8 B)
+{
+    // NOTE: AVX2 only has signed compares, flipping the sign bit turns it into an unsigned one
+    v1u_x8 SignBit = V1UX8(0x80000000);
+    v1u_x8 Result;
+    Result.x = _mm256_cmpgt_epi32((A ^ SignBit).x, (B ^ SignBit).x);
+    return Result;
+}
+inline v1u_x8 operator<(v1u_x8 A, v1u_x8 B) { return B > A; }
+inline v1u_x8& operator+=(v1u_x8& A, v1u_x8 B) { A = A + B; return A; }
+inline v1u_x8 Min(v1u_x8 A, v1u_x8 B) { v1u_x8 Result; Result.x = _mm256_min_epu32(A.x, B.x); return Result; }
+inline v1u_x8 Max(v1u_x8 A, v1u_x8 B) { v1u_x8 Result; Result.x = _mm256_max_epu32(A.x, B.x); return Result; }
+inline u32 MoveMask(v1u_x8 A) { return u32(_mm256_movemask_ps(_mm256_castsi256_ps(A.x))); }
+
+inline u32 HorizontalMin(v1u_x8 A)
+{
+    __m128i Half = _mm_min_epu32(_mm256_castsi256_si128(A.x), _mm256_extracti128_si256(A.x, 1));
+    Half = _mm_min_epu32(Half, _mm_shuffle_epi32(Half, _MM_SHUFFLE(1, 0, 3, 2)));
+    Half = _mm_min_epu32(Half, _mm_shuffle_epi32(Half, _MM_SHUFFLE(2, 3, 0, 1)));
+    return u32(_mm_cvtsi128_si32(Half));
+}
+
+inline u32 HorizontalMax(v1u_x8 A)
+{
+    __m128i Half = _mm_max_epu32(_mm256_castsi256_si128(A.x), _mm256_extracti128_si256(A.x, 1));
+    Half = _mm_max_epu32(Half, _mm_shuffle_epi32(Half, _MM_SHUFFLE(1, 0, 3, 2)));
+    Half = _mm_max_epu32(Half, _mm_shuffle_epi32(Half, _MM_SHUFFLE(2, 3, 0, 1)));
+    return u32(_mm_cvtsi128_si32(Half));
+}
+
+inline v1_x8 V1X8Gather(f32* Base, v1u_x8 Indices, v1u_x8 Mask)
+{
+    v1_x8 Result;
+    Result.x = _mm256_mask_i32gather_ps(_mm256_setzero_ps(), Base, Indices.x, _mm256_castsi256_ps(Mask.x), 4);
+    return Result;
+}
+
+inline v2_x8 V2X8(v1_x8 X, v1_x8 Y) { v2_x8 Result; Result.x = X; Result.y = Y; return Result; }
+inline v2_x8 V2X8(v1_x8 A) { return V2X8(A, A); }
+inline v2_x8 V2X8(f32 X, f32 Y) { return V2X8(V1X8(X), V1X8(Y)); }
+inline v2_x8 V2X8(f32 A) { return V2X8(V1X8(A), V1X8(A)); }
+inline v2_x8 V2X8LoadUnAligned(f32* X, f32* Y) { return V2X8(V1X8LoadUnAligned(X), V1X8LoadUnAligned(Y)); }
+inline v2_x8 V2X8Gather(f32* X, f32* Y, v1u_x8 Indices, v1u_x8 Mask) { return V2X8(V1X8Gather(X, Indices, Mask), V1X8Gather(Y, Indices, Mask)); }
+
+#define SIM_LANE_OP_V2_X8(Op)                                           \
+    inline v2_x8 operator Op(v2_x8 A, v2_x8 B) { return V2X8(A.x Op B.x, A.y Op B.y); } \
+    inline v2_x8 operator Op(v2_x8 A, v1_x8 B) { return V2X8(A.x Op B, A.y Op B); } \
+    inline v2_x8 operator Op(v1_x8 A, v2_x8 B) { return V2X8(A Op B.x, A Op B.y); } \
+    inline v2_x8 operator Op(v2_x8 A, f32 B) { return V2X8(A.x Op B, A.y Op B); } \
+    inline v2_x8 operator Op(f32 A, v2_x8 B) { return V2X8(A Op B.x, A Op B.y); } \
+    inline v2_x8 operator Op(v2_x8 A, v2 B) { return V2X8(A.x Op B.x, A.y Op B.y); }
+SIM_LANE_OP_V2_X8(+)
+SIM_LANE_OP_V2_X8(-)
+SIM_LANE_OP_V2_X8(*)
+SIM_LANE_OP_V2_X8(/)
+#undef SIM_LANE_OP_V2_X8
+
+inline v1_x8 RotateLanes(v1_x8 A)
+{
+    v1_x8 Result;
+    Result.x = _mm256_permutevar8x32_ps(A.x, _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0));
+    return Result;
+}
+
+inline v1u_x8 RotateLanes(v1u_x8 A)
+{
+    v1u_x8 Result;
+    Result.x = _mm256_permutevar8x32_epi32(A.x, _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0));
+    return Result;
+}
+
+inline v2_x8 RotateLanes(v2_x8 A) { return V2X8(RotateLanes(A.x), RotateLanes(A.y)); }
+
+inline v1u_x8 PackI16Pairs(v1u_x8 X, v1u_x8 Y)
+{
+    v1u_x8 Result;
+    Result.x = _mm256_or_si256(_mm256_and_si256(X.x, _mm256_set1_epi32(0xFFFF)), _mm256_slli_epi32(Y.x, 16));
+    return Result;
+}
+inline v1u_x8 SubI16Pairs(v1u_x8 A, v1u_x8 B) { v1u_x8 Result; Result.x = _mm256_sub_epi16(A.x, B.x); return Result; }
+inline v1u_x8 DotI16Pairs(v1u_x8 A, v1u_x8 B) { v1u_x8 Result; Result.x = _mm256_madd_epi16(A.x, B.x); return Result; }
+
+inline v1_x8 ApproxInvSquareRoot(v1_x8 A)
+{
+    v1_x8 Estimate;
+    Estimate.x = _mm256_rsqrt_ps(A.x);
+    return Estimate * (V1X8(1.5f) - V1X8(0.5f) * A * Estimate * Estimate);
+}
+
+inline v2_x8 operator-(v2_x8 A) { return V2X8(-A.x, -A.y); }
+inline v2_x8& operator+=(v2_x8& A, v2_x8 B) { A = A + B; return A; }
+inline v2_x8& operator/=(v2_x8& A, v1_x8 B) { A = A / B; return A; }
+inline v1_x8 LengthSquared(v2_x8 A) { return A.x * A.x + A.y * A.y; }
+inline v1_x8 Length(v2_x8 A) { return SquareRoot(LengthSquared(A)); }
+inline v2_x8 Normalize(v2_x8 A) { return A / Length(A); }
+inline v2_x8 Clamp(v2_x8 A, v2_x8 MinVal, v2_x8 MaxVal) { return V2X8(Clamp(A.x, MinVal.x, MaxVal.x), Clamp(A.y, MinVal.y, MaxVal.y)); }
+
+// NOTE: 3D flocking
+struct v3_x8
+{
+    v1_x8 x;
+    v1_x8 y;
+    v1_x8 z;
+};
+
+inline v3_x8 V3X8(v1_x8 X, v1_x8 Y, v1_x8 Z) { v3_x8 Result; Result.x = X; Result.y = Y; Result.z = Z; return Result; }
+inline v3_x8 V3X8(v1_x8 A) { return V3X8(A, A, A); }
+inline v3_x8 V3X8(f32 A) { return V3X8(V1X8(A), V1X8(A), V1X8(A)); }
+
+#define SIM_LANE_OP_V3_X8(Op)                                          \
+    inline v3_x8 operator Op(v3_x8 A, v3_x8 B) { return V3X8(A.x Op B.x, A.y Op B.y, A.z Op B.z); } \
+    inline v3_x8 operator Op(v3_x8 A, v1_x8 B) { return V3X8(A.x Op B, A.y Op B, A.z Op B); } \
+    inline v3_x8 operator Op(v1_x8 A, v3_x8 B) { return V3X8(A Op B.x, A Op B.y, A Op B.z); } \
+    inline v3_x8 operator Op(v3_x8 A, f32 B) { return V3X8(A.x Op B, A.y Op B, A.z Op B); } \
+    inline v3_x8 operator Op(f32 A, v3_x8 B) { return V3X8(A Op B.x, A Op B.y, A Op B.z); }
+SIM_LANE_OP_V3_X8(+)
+SIM_LANE_OP_V3_X8(-)
+SIM_LANE_OP_V3_X8(*)
+SIM_LANE_OP_V3_X8(/)
+#undef SIM_LANE_OP_V3_X8
+
+inline v3_x8 operator-(v3_x8 A) { return V3X8(-A.x, -A.y, -A.z); }
+inline v3_x8& operator+=(v3_x8& A, v3_x8 B) { A = A + B; return A; }
+inline v3_x8& operator/=(v3_x8& A, v1_x8 B) { A = A / B; return A; }
+inline v1_x8 LengthSquared(v3_x8 A) { return A.x * A.x + A.y * A.y + A.z * A.z; }
+inline v1_x8 Length(v3_x8 A) { return SquareRoot(LengthSquared(A)); }
+inline v3_x8 Normalize(v3_x8 A) { return A / Length(A); }
+
+SIM_TARGET_END
+
+//
+// NOTE: 16 Wide (AVX-512)
+//
+
+SIM_TARGET_BEGIN_AVX512
+
+union v1_x16
+{
+    __m512 x;
+    f32 e[16];
+};
+
+union v1u_x16
+{
+    __m512i x;
+    u32 e[16];
+};
+
+struct v2_x16
+{
+    v1_x16 x;
+    v1_x16 y;
+};
+
+// NOTE: AVX-512 compares return a k mask, we expand them back into all-ones lanes to keep the same mask conventions as SSE
+inline v1u_x16 V1UX16FromMask(__mmask16 Mask) { v1u_x16 Result; Result.x = _mm512_maskz_set1_epi32(Mask, -1); return Result; }
+inline __mmask16 V1UX16ToMask(v1u_x16 A) { return _mm512_test_epi32_mask(A.x, A.x); }
+
+inline v1_x16 V1X16(f32 A) { v1_x16 Result; Result.x = _mm512_set1_ps(A); return Result; }
+inline v1_x16 V1X16(i32 A) { v1_x16 Result; Result.x = _mm512_set1_ps(f32(A)); return Result; }
+inline v1_x16 V1X16(v1u_x16 A) { v1_x16 Result; Result.x = _mm512_cvtepi32_ps(A.x); return Result; }
+inline v1_x16 V1X16Cast(v1u_x16 A) { v1_x16 Result; Result.x = _mm512_castsi512_ps(A.x); return Result; }
+inline v1_x16 V1X16LoadUnAligned(f32* A) { v1_x16 Result; Result.x = _mm512_loadu_ps(A); return Result; }
+inline void StoreUnAligned(v1_x16 A, f32* Dest) { _mm512_storeu_ps(Dest, A.x); }
+
+inline v1u_x16 V1UX16(u32 A) { v1u_x16 Result; Result.x = _mm512_set1_epi32(A); return Result; }
+inline v1u_x16 V1UX16Cast(v1_x16 A) { v1u_x16 Result; Result.x = _mm512_castps_si512(A.x); return Result; }
+inline v1u_x16 V1UX16LoadUnAligned(u32* A) { v1u_x16 Result; Result.x = _mm512_loadu_si512(A); return Result; }
+inline v1u_x16 V1UX16LaneIndex()
+{
+    v1u_x16 Result;
+    Result.x = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    return Result;
+}
+
+#define SIM_LANE_OP_F32_X16(Op, Intrin)                                 \
+    inline v1_x16 operator Op(v1_x16 A, v1_x16 B) { v1_x16 Result; Result.x = Intrin(A.x, B.x); return Result; } \
+    inline v1_x16 operator Op(v1_x16 A, f32 B) { return A Op V1X16(B); } \
+    inline v1_x16 operator Op(f32 A, v1_x16 B) { return V1X16(A) Op B; }
+SIM_LANE_OP_F32_X16(+, _mm512_add_ps)
+SIM_LANE_OP_F32_X16(-, _mm512_sub_ps)
+SIM_LANE_OP_F32_X16(*, _mm512_mul_ps)
+SIM_LANE_OP_F32_X16(/, _mm512_div_ps)
+#undef SIM_LANE_OP_F32_X16
+
+// NOTE: _mm512_and_ps is AVX512DQ, the integer and is in AVX512F
+inline v1_x16 operator&(v1_x16 A, v1_x16 B)
+{
+    v1_x16 Result;
+    Result.x = _mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(A.x), _mm512_castps_si512(B.x)));
+    return Result;
+}
+
+#define SIM_LANE_CMP_F32_X16(Op, Pred)                                  \
+    inline v1_x16 operator Op(v1_x16 A, v1_x16 B) { return V1X16Cast(V1UX16FromMask(_mm512_cmp_ps_mask(A.x, B.x, Pred))); } \
+    inline v1_x16 operator Op(v1_x16 A, f32 B) { return A Op V1X16(B); }
+SIM_LANE_CMP_F32_X16(<, _CMP_LT_OQ)
+SIM_LANE_CMP_F32_X16(<=, _CMP_LE_OQ)
+SIM_LANE_CMP_F32_X16(>, _CMP_GT_OQ)
+SIM_LANE_CMP_F32_X16(>=, _CMP_GE_OQ)
+#undef SIM_LANE_CMP_F32_X16
+
+inline v1_x16 operator-(v1_x16 A) { return V1X16(0.0f) - A; }
+inline v1_x16& operator+=(v1_x16& A, v1_x16 B) { A = A + B; return A; }
+inline v1_x16& operator-=(v1_x16& A, v1_x16 B) { A = A - B; return A; }
+inline v1_x16& operator/=(v1_x16& A, v1_x16 B) { A = A / B; return A; }
+inline v1_x16 Min(v1_x16 A, v1_x16 B) { v1_x16 Result; Result.x = _mm512_min_ps(A.x, B.x); return Result; }
+inline v1_x16 Max(v1_x16 A, v1_x16 B) { v1_x16 Result; Result.x = _mm512_max_ps(A.x, B.x); return Result; }
+inline v1_x16 Clamp(v1_x16 A, v1_x16 MinVal, v1_x16 MaxVal) { return Min(Max(A, MinVal), MaxVal); }
+inline v1_x16 SquareRoot(v1_x16 A) { v1_x16 Result; Result.x = _mm512_sqrt_ps(A.x); return Result; }
+inline v1u_x16 FloorV1UX16(v1_x16 A)
+{
+    v1u_x16 Result;
+    Result.x = _mm512_cvttps_epi32(_mm512_roundscale_ps(A.x, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC));
+    return Result;
+}
+
+#define SIM_LANE_OP_U32_X16(Op, Intrin)                                 \
+    inline v1u_x16 operator Op(v1u_x16 A, v1u_x16 B) { v1u_x16 Result; Result.x = Intrin(A.x, B.x); return Result; }
+SIM_LANE_OP_U32_X16(+, _mm512_add_epi32)
+SIM_LANE_OP_U32_X16(-, _mm512_sub_epi32)
+SIM_LANE_OP_U32_X16(&, _mm512_and_si512)
+SIM_LANE_OP_U32_X16(|, _mm512_or_si512)
+SIM_LANE_OP_U32_X16(^, _mm512_xor_si512)
+#undef SIM_LANE_OP_U32_X16
+
+inline v1u_x16 operator~(v1u_x16 A) { return A ^ V1UX16(0xFFFFFFFF); }
+inline v1u_x16 operator==(v1u_x16 A, v1u_x16 B) { return V1UX16FromMask(_mm512_cmpeq_epu32_mask(A.x, B.x)); }
+inline v1u_x16 operator!=(v1u_x16 A, v1u_x16 B) { return V1UX16FromMask(_mm512_cmpneq_epu32_mask(A.x, B.x)); }
+inline v1u_x16 operator<(v1u_x16 A, v1u_x16 B) { return V1UX16FromMask(_mm512_cmplt_epu32_mask(A.x, B.x)); }
+inline v1u_x16 operator>(v1u_x16 A, v1u_x16 B) { return B < A; }
+inline v1u_x16& operator+=(v1u_x16& A, v1u_x16 B) { A = A + B; return A; }
+inline v1u_x16 Min(v1u_x16 A, v1u_x16 B) { v1u_x16 Result; Result.x = _mm512_min_epu32(A.x, B.x); return Result; }
+inline v1u_x16 Max(v1u_x16 A, v1u_x16 B) { v1u_x16 Result; Result.x = _mm512_max_epu32(A.x, B.x); return Result; }
+inline u32 MoveMask(v1u_x16 A) { return u32(_mm512_cmplt_epi32_mask(A.x, _mm512_setzero_si512())); }
+inline u32 HorizontalMin(v1u_x16 A) { return _mm512_reduce_min_epu32(A.x); }
+inline u32 HorizontalMax(v1u_x16 A) { return _mm512_reduce_max_epu32(A.x); }
+
+inline v1_x16 V1X16Gather(f32* Base, v1u_x16 Indices, v1u_x16 Mask)
+{
+    v1_x16 Result;
+    Result.x = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), V1UX16ToMask(Mask), Indices.x, Base, 4);
+    return Result;
+}
+
+inline v2_x16 V2X16(v1_x16 X, v1_x16 Y) { v2_x16 Result; Result.x = X; Result.y = Y; return Result; }
+inline v2_x16 V2X16(v1_x16 A) { return V2X16(A, A); }
+inline v2_x16 V2X16(f32 X, f32 Y) { return V2X16(V1X16(X), V1X16(Y)); }
+inline v2_x16 V2X16(f32 A) { return V2X16(V1X16(A), V1X16(A)); }
+inline v2_x16 V2X16LoadUnAligned(f32* X, f32* Y) { return V2X16(V1X16LoadUnAligned(X), V1X16LoadUnAligned(Y)); }
+inline v2_x16 V2X16Gather(f32* X, f32* Y, v1u_x16 Indices, v1u_x16 Mask) { return V2X16(V1X16Gather(X, Indices, Mask), V1X16Gather(Y, Indices, Mask)); }
+
+#define SIM_LANE_OP_V2_X16(Op)                                          \
+    inline v2_x16 operator Op(v2_x16 A, v2_x16 B) { return V2X16(A.x Op B.x, A.y Op B.y); } \
+    inline v2_x16 operator Op(v2_x16 A, v1_x16 B) { return V2X16(A.x Op B, A.y Op B); } \
+    inline v2_x16 operator Op(v1_x16 A, v2_x16 B) { return V2X16(A Op B.x, A Op B.y); } \
+    inline v2_x16 operator Op(v2_x16 A, f32 B) { return V2X16(A.x Op B, A.y Op B); } \
+    inline v2_x16 operator Op(f32 A, v2_x16 B) { return V2X16(A Op B.x, A Op B.y); } \
+    inline v2_x16 operator Op(v2_x16 A, v2 B) { return V2X16(A.x Op B.x, A.y Op B.y); }
+SIM_LANE_OP_V2_X16(+)
+SIM_LANE_OP_V2_X16(-)
+SIM_LANE_OP_V2_X16(*)
+SIM_LANE_OP_V2_X16(/)
+#undef SIM_LANE_OP_V2_X16
+
+inline v1_x16 RotateLanes(v1_x16 A)
+{
+    v1_x16 Result;
+    Result.x = _mm512_permutexvar_ps(_mm512_setr_epi32(1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 0), A.x);
+    return Result;
+}
+
+inline v1u_x16 RotateLanes(v1u_x16 A)
+{
+    v1u_x16 Result;
+    Result.x = _mm512_permutexvar_epi32(_mm512_setr_epi32(1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 0), A.x);
+    return Result;
+}
+
+inline v2_x16 RotateLanes(v2_x16 A) { return V2X16(RotateLanes(A.x), RotateLanes(A.y)); }
+
+inline v1u_x16 PackI16Pairs(v1u_x16 X, v1u_x16 Y)
+{
+    v1u_x16 Result;
+    Result.x = _mm512_or_si512(_mm512_and_si512(X.x, _mm512_set1_epi32(0xFFFF)), _mm512_slli_epi32(Y.x, 16));
+    return Result;
+}
+
+// NOTE: 16 bit subtracts and multiplies are AVX512BW, so we do each half with AVX2 instead
+inline v1u_x16 SubI16Pairs(v1u_x16 A, v1u_x16 B)
+{
+    __m256i Lo = _mm256_sub_epi16(_mm512_castsi512_si256(A.x), _mm512_castsi512_si256(B.x));
+    __m256i Hi = _mm256_sub_epi16(_mm512_extracti64x4_epi64(A.x, 1), _mm512_extracti64x4_epi64(B.x, 1));
+    v1u_x16 Result;
+    Result.x = _mm512_inserti64x4(_mm512_castsi256_si512(Lo), Hi, 1);
+    return Result;
+}
+
+inline v1u_x16 DotI16Pairs(v1u_x16 A, v1u_x16 B)
+{
+    __m256i Lo = _mm256_madd_epi16(_mm512_castsi512_si256(A.x), _mm512_castsi512_si256(B.x));
+    __m256i Hi = _mm256_madd_epi16(_mm512_extracti64x4_epi64(A.x, 1), _mm512_extracti64x4_epi64(B.x, 1));
+    v1u_x16 Result;
+    Result.x = _mm512_inserti64x4(_mm512_castsi256_si512(Lo), Hi, 1);
+    return Result;
+}
+
+// NOTE: AVX-512 has a 14 bit estimate, the Newton step takes it to full float precision
+inline v1_x16 ApproxInvSquareRoot(v1_x16 A)
+{
+    v1_x16 Estimate;
+    Estimate.x = _mm512_rsqrt14_ps(A.x);
+    return Estimate * (V1X16(1.5f) - V1X16(0.5f) * A * Estimate * Estimate);
+}
+
+inline v2_x16 operator-(v2_x16 A) { return V2X16(-A.x, -A.y); }
+inline v2_x16& operator+=(v2_x16& A, v2_x16 B) { A = A + B; return A; }
+inline v2_x16& operator/=(v2_x16& A, v1_x16 B) { A = A / B; return A; }
+inline v1_x16 LengthSquared(v2_x16 A) { return A.x * A.x + A.y * A.y; }
+inline v1_x16 Length(v2_x16 A) { return SquareRoot(LengthSquared(A)); }
+inline v2_x16 Normalize(v2_x16 A) { return A / Length(A); }
+inline v2_x16 Clamp(v2_x16 A, v2_x16 MinVal, v2_x16 MaxVal) { return V2X16(Clamp(A.x, MinVal.x, MaxVal.x), Clamp(A.y, MinVal.y, MaxVal.y)); }
+
+// NOTE: 3D flocking
+struct v3_x16
+{
+    v1_x16 x;
+    v1_x16 y;
+    v1_x16 z;
+};
+
+inline v3_x16 V3X16(v1_x16 X, v1_x16 Y, v1_x16 Z) { v3_x16 Result; Result.x = X; Result.y = Y; Result.z = Z; return Result; }
+inline v3_x16 V3X16(v1_x16 A) { return V3X16(A, A, A); }
+inline v3_x16 V3X16(f32 A) { return V3X16(V1X16(A), V1X16(A), V1X16(A)); }
+
+#define SIM_LANE_OP_V3_X16(Op)                                          \
+    inline v3_x16 operator Op(v3_x16 A, v3_x16 B) { return V3X16(A.x Op B.x, A.y Op B.y, A.z Op B.z); } \
+    inline v3_x16 operator Op(v3_x16 A, v1_x16 B) { return V3X16(A.x Op B, A.y Op B, A.z Op B); } \
+    inline v3_x16 operator Op(v1_x16 A, v3_x16 B) { return V3X16(A Op B.x, A Op B.y, A Op B.z); } \
+    inline v3_x16 operator Op(v3_x16 A, f32 B) { return V3X16(A.x Op B, A.y Op B, A.z Op B); } \
+    inline v3_x16 operator Op(f32 A, v3_x16 B) { return V3X16(A Op B.x, A Op B.y, A Op B.z); }
+SIM_LANE_OP_V3_X16(+)
+SIM_LANE_OP_V3_X16(-)
+SIM_LANE_OP_V3_X16(*)
+SIM_LANE_OP_V3_X16(/)
+#undef SIM_LANE_OP_V3_X16
+
+inline v3_x16 operator-(v3_x16 A) { return V3X16(-A.x, -A.y, -A.z); }
+inline v3_x16& operator+=(v3_x16& A, v3_x16 B) { A = A + B; return A; }
+inline v3_x16& operator/=(v3_x16& A, v1_x16 B) { A = A / B; return A; }
+inline v1_x16 LengthSquared(v3_x16 A) { return A.x * A.x + A.y * A.y + A.z * A.z; }
+inline v1_x16 Length(v3_x16 A) { return SquareRoot(LengthSquared(A)); }
+inline v3_x16 Normalize(v3_x16 A) { return A / Length(A); }
+
+SIM_TARGET_END
@@ -34,4 +34,7 @@ cl %CommonCompilerFlags% %CodeDir%\boids_demo.cpp -Fmboids_demo.map -LD /link %C
 del lock.tmp
 call cl %CommonCompilerFlags% -DDLL_NAME=boids_demo -Feboids_demo.exe %LibsDir%\framework_vulkan\win32_main.cpp -Fmboids_demo.map /link %CommonLinkerFlags%
 
+REM Headless benchmark
+call cl %CommonCompilerFlags% -Feboids_bench.exe %CodeDir%\boids_bench.cpp %CodeDir%\boids_sim.cpp -Fmboids_bench.map /link %CommonLinkerFlags%
+
 popd
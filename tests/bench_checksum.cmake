@@ -0,0 +1,50 @@
+# NOTE: Runs boids_bench with the same seed once with REFERENCE_ARGS and once with MODE_ARGS and fails if the checksums
+#       of the final states differ by more than MAX_DIFF. The checksum is printed with 6 decimals, so both get compared
+#       as integers in millionths since CMake has no float math.
+#
+#       cmake -DBENCH=path/to/boids_bench -DNAME=name -DREFERENCE_ARGS="..." -DMODE_ARGS="..." -DMAX_DIFF=0.02
+#             -DWORK_DIR=dir -P bench_checksum.cmake
+
+set(BENCH_ARGS -birds 20000 -warmup 0 -steps 20 -seed 1)
+
+function(to_millionths Value OutVar)
+    if (NOT Value MATCHES "^(-?)([0-9]*)\\.?([0-9]*)$")
+        message(FATAL_ERROR "Can't parse ${Value} as a number")
+    endif()
+    set(Sign ${CMAKE_MATCH_1})
+    set(Whole ${CMAKE_MATCH_2})
+    set(Fraction "${CMAKE_MATCH_3}000000")
+    string(SUBSTRING ${Fraction} 0 6 Fraction)
+    if (Whole STREQUAL "")
+        set(Whole 0)
+    endif()
+    # NOTE: The leading 1 keeps the zeros at the start of the fraction from making it an octal literal
+    math(EXPR Result "${Sign}(${Whole} * 1000000 + 1${Fraction} - 1000000)")
+    set(${OutVar} ${Result} PARENT_SCOPE)
+endfunction()
+
+function(run_bench Args OutVar)
+    separate_arguments(ArgList UNIX_COMMAND "${Args}")
+    execute_process(COMMAND ${BENCH} ${BENCH_ARGS} ${ArgList} -o ${WORK_DIR}/bench_checksum_${NAME}.csv
+                    RESULT_VARIABLE ExitCode ERROR_VARIABLE Summary OUTPUT_QUIET)
+    if (NOT ExitCode EQUAL 0 OR NOT Summary MATCHES "checksum (-?[0-9]+\\.[0-9]+)")
+        message(FATAL_ERROR "boids_bench ${Args} failed (${ExitCode}): ${Summary}")
+    endif()
+    set(${OutVar} ${CMAKE_MATCH_1} PARENT_SCOPE)
+endfunction()
+
+run_bench("${REFERENCE_ARGS}" ReferenceChecksum)
+run_bench("${MODE_ARGS}" ModeChecksum)
+
+to_millionths(${ReferenceChecksum} Reference)
+to_millionths(${ModeChecksum} Mode)
+to_millionths(${MAX_DIFF} MaxDiff)
+math(EXPR Diff "${Mode} - ${Reference}")
+if (Diff LESS 0)
+    math(EXPR Diff "-(${Diff})")
+endif()
+
+message(STATUS "[${REFERENCE_ARGS}] ${ReferenceChecksum} vs [${MODE_ARGS}] ${ModeChecksum}")
+if (Diff GREATER MaxDiff)
+    message(FATAL_ERROR "Checksums differ by more than ${MAX_DIFF}")
+endif()